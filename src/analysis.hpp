@@ -0,0 +1,118 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "packed.hpp"
+#include "search.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <span>
+
+/**
+ * @file Provides throughput-oriented batch analysis: many single-threaded searches at once, one
+ *       per core, sharing a transposition table.
+ *
+ * For a whole game or a large set of positions, this gets far more positions per second than
+ * running one parallel search after another, since single-threaded searches have no parallel
+ * search overhead. Positions are handed out one at a time in input order, so consecutive plies
+ * of a game are searched at about the same time and find each other's results in the table.
+ */
+namespace chess {
+	namespace analysis {
+		struct Options {
+			unsigned threads = 0;			/* 0 for the hardware concurrency */
+			size_t hashMegabytes = 64;
+		};
+
+		/**
+		 * Analyzes batches of positions. The transposition table is kept between batches.
+		 */
+		class Analyzer {
+			search::TranspositionTable m_table;
+			unsigned m_threads;
+
+			// FEN strings go through a packed position too, which caps the full-move number so that a
+			// large one cannot run past the history of the game
+			template <typename Position>
+			static inline void setup(Game& game, const Position& position) noexcept {
+				if constexpr (std::is_same_v<Position, packed::Position>) {
+					packed::unpack(position, game);
+				} else {
+					packed::unpack(packed::packFEN(position), game);
+				}
+			}
+
+		public:
+			inline explicit Analyzer(const Options& options = { }) :
+				m_table{ options.hashMegabytes },
+				m_threads{ options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency()) }
+			{ }
+
+			/**
+			 * \param positions Packed positions, or valid FEN strings.
+			 * \param limits The depth or node budget of each position.
+			 * \param callback Called as `callback(size_t index, const search::Result& result)` on the
+			 *        calling thread, in the order of the positions, as soon as the results are ready.
+			 */
+			template <typename Position, typename Callback>
+			inline void analyze(const std::span<const Position> positions, const search::Limits& limits, Callback&& callback) {
+				// The lookup tables must be initialized before the workers construct their games
+				lookup::init();
+				m_table.newSearch();
+
+				std::vector<search::Result> results(positions.size());
+				std::vector<uint8_t> done(positions.size());
+				std::atomic<size_t> next = 0;
+				std::mutex mutex;
+				std::condition_variable ready;
+				std::vector<std::thread> workers;
+
+				for (unsigned t = 0; t < std::min<size_t>(m_threads, positions.size()); ++t) {
+					workers.emplace_back([&]() {
+						Game game;
+						search::Searcher searcher(m_table);
+
+						for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < positions.size();) {
+							CHESS_METRIC_SCOPE(Request);
+							setup(game, positions[i]);
+							results[i] = searcher.search(game, limits);
+
+							{
+								const std::lock_guard lock(mutex);
+								done[i] = true;
+							}
+							ready.notify_one();
+						}
+					});
+				}
+
+				for (size_t i = 0; i < positions.size(); ++i) {
+					{
+						std::unique_lock lock(mutex);
+						ready.wait(lock, [&]() { return done[i] != 0; });
+					}
+
+					callback(i, std::as_const(results[i]));
+				}
+
+				for (std::thread& worker : workers)
+					worker.join();
+			}
+
+			/**
+			 * \returns The results, in the order of the positions.
+			 */
+			template <typename Position>
+			inline std::vector<search::Result> analyze(const std::span<const Position> positions, const search::Limits& limits) {
+				std::vector<search::Result> results(positions.size());
+				analyze(positions, limits, [&](const size_t index, const search::Result& result) {
+					results[index] = result;
+				});
+
+				return results;
+			}
+
+			inline search::TranspositionTable& table() noexcept { return m_table; }
+		};
+	}
+}
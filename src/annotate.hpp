@@ -0,0 +1,308 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "pgn.hpp"
+#include "search.hpp"
+#include <cmath>
+#include <cstdio>
+
+/**
+ * @file Provides post-game analysis: every move of a game is searched and judged, and the game is
+ *       written back as PGN with evaluations, the better moves and accuracy figures.
+ *
+ * The positions of a game are searched from the last one to the first. Each search then finds
+ * the positions a ply deeper already in the transposition table, from the search before it, which
+ * makes a game much cheaper than its positions analyzed independently. Annotators on several
+ * threads can share one table and annotate different games.
+ */
+namespace chess {
+	namespace annotate {
+		enum class Judgement : uint8_t {
+			Good,
+			Inaccuracy,		/* $6, the winning chances drop by at least 10% */
+			Mistake,		/* $2, by at least 20% */
+			Blunder			/* $4, by at least 30% */
+		};
+
+		struct PlyAnalysis {
+			Move played;
+			Move best;
+			int bestScore;			/* of the position before the move, from the mover's point of view */
+			int playedScore;		/* after the move, from the mover's point of view */
+			int centipawnLoss;
+			double accuracy;		/* 0 to 100 */
+			Judgement judgement;
+		};
+
+		struct SideSummary {
+			double accuracy = 0;				/* the mean accuracy of the moves, 0 to 100 */
+			double averageCentipawnLoss = 0;
+			int inaccuracies = 0, mistakes = 0, blunders = 0;
+		};
+
+		struct GameAnalysis {
+			std::vector<PlyAnalysis> plies;		/* the analyzed prefix of the game's moves */
+			SideSummary white, black;
+			Color firstTurn = Color::White;
+		};
+
+		namespace detail {
+			// Scores beyond this are treated as this, so mates do not dominate the averages
+			inline constexpr int ScoreClamp = 1000;
+
+			// The expected score in percent, from the lichess.org accuracy model
+			inline double winPercent(const int score) noexcept {
+				const int clamped = std::clamp(score, -ScoreClamp, ScoreClamp);
+				return 50 + 50 * (2 / (1 + std::exp(-0.00368208 * clamped)) - 1);
+			}
+
+			inline double moveAccuracy(const double winBefore, const double winAfter) noexcept {
+				return std::clamp(103.1668 * std::exp(-0.04354 * std::max(0.0, winBefore - winAfter)) - 3.1669, 0.0, 100.0);
+			}
+
+			// An evaluation comment, from White's point of view, in pawns or as a distance to mate
+			inline void appendEval(std::string& out, const int whiteScore) {
+				char text[16];
+				if (std::abs(whiteScore) >= search::MateScore - search::MaxPly) {
+					const int moves = (search::MateScore - std::abs(whiteScore) + 1) / 2;
+					std::snprintf(text, sizeof(text), "#%s%d", whiteScore < 0 ? "-" : "", moves);
+				} else {
+					std::snprintf(text, sizeof(text), "%.2f", whiteScore / 100.0);
+				}
+
+				out += "[%eval ";
+				out += text;
+				out += ']';
+			}
+		}
+
+		/**
+		 * Analyzes and annotates games one at a time. One per thread; any number can share a
+		 * transposition table.
+		 *
+		 * The annotator does not start table generations. The caller calls `newSearch` on the
+		 * table once per batch of games, before the annotators of all threads start on it, so
+		 * that the entries of the batch in progress age together.
+		 */
+		class Annotator {
+			Game m_game;
+			search::TranspositionTable& m_table;
+			search::Searcher m_searcher;
+			search::Limits m_limits;
+			std::vector<Move> m_moves;
+			std::vector<UndoInfo> m_undoInfos;
+			std::vector<search::Result> m_results;
+
+			inline search::Result searchCurrent() noexcept {
+				CHESS_METRIC_SCOPE(Request);
+				return m_searcher.search(m_game, m_limits);
+			}
+
+		public:
+			inline Annotator(search::TranspositionTable& table, const search::Limits& limits) :
+				m_table{ table }, m_searcher{ table }, m_limits{ limits }
+			{
+				lookup::init();
+			}
+
+			/**
+			 * \param record A game. Its FEN tag, if any, must be a valid and complete FEN.
+			 * \returns Whether the whole game was analyzed. If not, the analysis covers the moves
+			 *          before the first illegal one, or before the game gets too long to search. A
+			 *          malformed FEN tag, or one too far into the game, leaves it empty.
+			 */
+			inline bool analyze(const pgn::GameRecord& record, GameAnalysis& analysis) {
+				const std::string_view fen = record.tag("FEN");
+				const std::string_view startFEN = fen.empty() ? std::string_view(QuickFEN::start) : fen;
+
+				analysis = { };
+
+				// The game history must have room for the searches, and `init` already writes at the starting ply
+				const int startPly = Game::fenPly(startFEN);
+				if (startPly < 0 || startPly > 511 - search::MaxPly)
+					return startPly >= 0 && record.moves.empty();
+
+				m_game.init(startFEN);
+				analysis.firstTurn = m_game.turn();
+
+				// Play the game to its end, leaving that room
+				const size_t maxPlies = size_t(511 - search::MaxPly - m_game.ply());
+
+				m_moves.clear();
+				m_undoInfos.clear();
+				for (const std::string& san : record.moves) {
+					if (m_moves.size() == maxPlies)
+						break;
+
+					const Move move = CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+						return pgn::convertSANToMove<Color>(m_game, san);
+					});
+					if (move.isNull())
+						break;
+
+					m_undoInfos.push_back(CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+						return m_game.make<Color>(move);
+					}));
+					m_moves.push_back(move);
+				}
+
+				// Search from the last position back to the first
+				const size_t plies = m_moves.size();
+				m_results.resize(plies + 1);
+				m_results[plies] = searchCurrent();
+
+				for (size_t i = plies; i-- > 0;) {
+					CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+						m_game.unmake<~Color>(m_moves[i], m_undoInfos[i]);
+					});
+					m_results[i] = searchCurrent();
+				}
+
+				// Judge every move against the best one
+				double lossSums[2] = { }, accuracySums[2] = { };
+				int counts[2] = { };
+
+				for (size_t i = 0; i < plies; ++i) {
+					PlyAnalysis ply;
+					ply.played = m_moves[i];
+					ply.best = m_results[i].bestMove();
+					ply.bestScore = m_results[i].score;
+					ply.playedScore = ply.played == ply.best ? ply.bestScore : -m_results[i + 1].score;
+
+					const int clampedBest = std::clamp(ply.bestScore, -detail::ScoreClamp, detail::ScoreClamp);
+					const int clampedPlayed = std::clamp(ply.playedScore, -detail::ScoreClamp, detail::ScoreClamp);
+					ply.centipawnLoss = std::max(0, clampedBest - clampedPlayed);
+
+					const double winBefore = detail::winPercent(ply.bestScore), winAfter = detail::winPercent(ply.playedScore);
+					ply.accuracy = detail::moveAccuracy(winBefore, winAfter);
+
+					const double drop = winBefore - winAfter;
+					ply.judgement = drop >= 30 ? Judgement::Blunder : drop >= 20 ? Judgement::Mistake : drop >= 10 ? Judgement::Inaccuracy : Judgement::Good;
+
+					const size_t side = (size_t(analysis.firstTurn) + i) & 1;
+					SideSummary& summary = side == size_t(Color::White) ? analysis.white : analysis.black;
+
+					summary.inaccuracies += ply.judgement == Judgement::Inaccuracy;
+					summary.mistakes += ply.judgement == Judgement::Mistake;
+					summary.blunders += ply.judgement == Judgement::Blunder;
+					lossSums[side] += ply.centipawnLoss;
+					accuracySums[side] += ply.accuracy;
+					++counts[side];
+
+					analysis.plies.push_back(ply);
+				}
+
+				for (const Color color : { Color::White, Color::Black }) {
+					SideSummary& summary = color == Color::White ? analysis.white : analysis.black;
+					if (const int count = counts[size_t(color)]) {
+						summary.averageCentipawnLoss = lossSums[size_t(color)] / count;
+						summary.accuracy = accuracySums[size_t(color)] / count;
+					} else {
+						summary.accuracy = 100;
+					}
+				}
+
+				return plies == record.moves.size();
+			}
+
+			/**
+			 * Appends the game as PGN, with accuracy tags, and an evaluation comment and judgement
+			 * for every analyzed move. Moves past the analyzed prefix are written as they were.
+			 */
+			inline void write(const pgn::GameRecord& record, const GameAnalysis& analysis, std::string& out) {
+				char number[32];
+
+				for (const pgn::Tag& tag : record.tags) {
+					out += '[';
+					out += tag.name;
+					out += " \"";
+					out += tag.value;
+					out += "\"]\n";
+				}
+
+				for (const Color color : { Color::White, Color::Black }) {
+					const SideSummary& summary = color == Color::White ? analysis.white : analysis.black;
+					const char* name = color == Color::White ? "White" : "Black";
+
+					std::snprintf(number, sizeof(number), "%.1f", summary.accuracy);
+					out += std::string("[") + name + "Accuracy \"" + number + "\"]\n";
+					std::snprintf(number, sizeof(number), "%.0f", summary.averageCentipawnLoss);
+					out += std::string("[") + name + "ACPL \"" + number + "\"]\n";
+				}
+				out += '\n';
+
+				// Replay the game for the move numbers and the SAN of the best moves, wrapping lines at 80 columns
+				const std::string_view fen = record.tag("FEN");
+				const std::string_view startFEN = fen.empty() ? std::string_view(QuickFEN::start) : fen;
+
+				// Numbering stops at a move that cannot be played, and there is none without a starting
+				// position that fits in the game history
+				const int startPly = Game::fenPly(startFEN);
+				bool playing = startPly >= 0 && startPly <= 511;
+				if (playing)
+					m_game.init(startFEN);
+
+				size_t lineStart = out.size();
+				const auto token = [&](const std::string_view text) {
+					if (out.size() > lineStart && out.size() - lineStart + 1 + text.size() > 79) {
+						out += '\n';
+						lineStart = out.size();
+					} else if (out.size() > lineStart) {
+						out += ' ';
+					}
+
+					out += text;
+				};
+
+				for (size_t i = 0; i < record.moves.size(); ++i) {
+					const bool white = m_game.turn() == Color::White;
+					if (playing && (white || i == 0)) {
+						std::snprintf(number, sizeof(number), white ? "%d." : "%d...", m_game.fullMoveCount());
+						token(number);
+					}
+
+					if (i >= analysis.plies.size()) {
+						token(record.moves[i]);
+						playing = playing && m_game.ply() < 511 && !pgn::playSAN(m_game, record.moves[i]).isNull();
+						continue;
+					}
+
+					const PlyAnalysis& ply = analysis.plies[i];
+					token(pgn::moveToSAN(m_game, ply.played));
+
+					constexpr const char* Nags[] = { nullptr, "$6", "$2", "$4" };
+					if (const char* nag = Nags[size_t(ply.judgement)])
+						token(nag);
+
+					std::string comment = "{ ";
+					detail::appendEval(comment, white ? ply.playedScore : -ply.playedScore);
+					if (ply.judgement != Judgement::Good && !ply.best.isNull()) {
+						comment += " Best: ";
+						comment += pgn::moveToSAN(m_game, ply.best);
+					}
+					comment += " }";
+					token(comment);
+
+					CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, { m_game.make<Color>(ply.played); });
+				}
+
+				token(record.result);
+				out += "\n\n";
+			}
+
+			/**
+			 * Analyzes a game and appends it, annotated, as PGN.
+			 *
+			 * \returns Whether the whole game was analyzed.
+			 */
+			inline bool annotate(const pgn::GameRecord& record, std::string& out) {
+				GameAnalysis analysis;
+				const bool complete = analyze(record, analysis);
+				write(record, analysis, out);
+
+				return complete;
+			}
+		};
+	}
+}
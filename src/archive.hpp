@@ -0,0 +1,545 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "pgn.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+/**
+ * @file Provides a compact, seekable game archive format.
+ *
+ * Every move is stored as its index into the deterministic `legalMoves` order of the
+ * position it is played in. Since there are never more than 218 legal moves, this is
+ * one byte per move; positions with more than 256 legal moves (impossible in regular
+ * chess, but the format does not rely on that) take two bytes. Decoding simply replays
+ * the moves with `Game::make`.
+ *
+ * \cond The archive layout, with all integers stored little-endian:
+ *
+ *       Header            (see archive::Header)
+ *       Moves section     each game is a varint ply count followed by the move indices
+ *       Game index        uint64_t[gameCount + 1], offsets into the moves section
+ *       Tag directory     uint64_t[tagCount], offsets of each tag column
+ *       Tag columns       uint32_t name length, name, uint64_t[gameCount + 1] offsets, values
+ */
+namespace chess {
+	namespace archive {
+		inline constexpr char magic[4] = { 'C', 'H', 'S', 'A' };
+		inline constexpr uint32_t version = 1;
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint64_t gameCount;
+			uint64_t tagCount;
+			uint64_t movesOffset;
+			uint64_t indexOffset;
+			uint64_t tagsOffset;
+		};
+		static_assert(sizeof(Header) == 48);
+
+		namespace detail {
+			// Integers are stored little-endian, so big-endian hosts swap them on the way in and out
+			template <typename T>
+			inline constexpr T littleEndian(const T value) noexcept {
+				if constexpr (std::endian::native == std::endian::big) {
+					std::array<uint8_t, sizeof(T)> bytes = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+					std::reverse(bytes.begin(), bytes.end());
+					return std::bit_cast<T>(bytes);
+				} else {
+					return value;
+				}
+			}
+
+			inline constexpr Header littleEndian(Header header) noexcept {
+				header.version = littleEndian(header.version);
+				header.gameCount = littleEndian(header.gameCount);
+				header.tagCount = littleEndian(header.tagCount);
+				header.movesOffset = littleEndian(header.movesOffset);
+				header.indexOffset = littleEndian(header.indexOffset);
+				header.tagsOffset = littleEndian(header.tagsOffset);
+				return header;
+			}
+
+			inline void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+				while (value >= 0x80) {
+					out.push_back(uint8_t(value) | 0x80);
+					value >>= 7;
+				}
+				out.push_back(uint8_t(value));
+			}
+
+			// Reads 0 if the varint does not end before `end`
+			inline uint64_t readVarint(const uint8_t*& cur, const uint8_t* end) noexcept {
+				uint64_t value = 0;
+				for (int shift = 0; cur < end && shift < 64; shift += 7) {
+					const uint8_t byte = *cur++;
+					value |= uint64_t(byte & 0x7F) << shift;
+					if ((byte & 0x80) == 0)
+						return value;
+				}
+
+				cur = end;
+				return 0;
+			}
+
+			template <typename T>
+			inline void writeRaw(std::vector<uint8_t>& out, const T& value) {
+				const size_t size = out.size();
+				const T stored = littleEndian(value);
+				out.resize(size + sizeof(T));
+				std::memcpy(out.data() + size, &stored, sizeof(T));
+			}
+
+			template <typename T>
+			inline T readRaw(const uint8_t* ptr) noexcept {
+				T value;
+				std::memcpy(&value, ptr, sizeof(T));
+				return littleEndian(value);
+			}
+
+			// Encodes the index of a move out of `count` legal moves.
+			inline void writeMoveIndex(std::vector<uint8_t>& out, const size_t index, const size_t count) {
+				out.push_back(uint8_t(index));
+				if (count > 256)
+					out.push_back(uint8_t(index >> 8));
+			}
+		}
+
+		/**
+		 * \param game The game to play the moves in. It is reinitialized to the starting position of the record.
+		 * \param record The PGN game record.
+		 * \param out The buffer to append the encoded game to.
+		 * \returns True on success, false if a move could not be converted or the game is too long.
+		 *
+		 * Encodes the moves of a single game. On failure, `out` is left as it was.
+		 */
+		inline bool encodeGame(Game& game, const pgn::GameRecord& record, std::vector<uint8_t>& out) {
+			const std::string_view fen = record.tag("FEN");
+
+			// Game holds up to 512 positions of history, and `init` already writes at the starting ply
+			const int ply = Game::fenPly(fen.empty() ? QuickFEN::start : fen);
+			if (ply < 0 || record.moves.size() + ply >= 511)
+				return false;
+
+			game.init(fen.empty() ? QuickFEN::start : fen);
+
+			const size_t initialSize = out.size();
+			detail::writeVarint(out, record.moves.size());
+
+			for (const std::string& san : record.moves) {
+				const bool ok = dispatchRuntimeColor(game, []<Color Color>(Game& game, const std::string& san, std::vector<uint8_t>& out) {
+					const Move move = pgn::convertSANToMove<Color>(game, san);
+					if (move.isNull())
+						return false;
+
+					size_t index = 0, count = 0;
+					movegen::legalMoves<Color>(game, [&](const Move candidate) {
+						if (candidate == move)
+							index = count;
+						++count;
+					});
+
+					detail::writeMoveIndex(out, index, count);
+					game.make<Color>(move);
+					return true;
+				}, san, out);
+
+				if (!ok) {
+					out.resize(initialSize);
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		/**
+		 * Builds an archive out of PGN game records.
+		 */
+		class Builder {
+			struct Column {
+				std::string name;
+				std::vector<uint32_t> games;
+				std::vector<std::string> values;
+			};
+
+			std::vector<uint8_t> m_moves;
+			std::vector<uint64_t> m_index{ 0 };
+			std::vector<Column> m_columns;
+			size_t m_skipped = 0;
+
+			inline void addTags(const pgn::GameRecord& record) {
+				const uint32_t game = uint32_t(m_index.size() - 2);
+
+				for (const pgn::Tag& tag : record.tags) {
+					Column* column = nullptr;
+					for (Column& candidate : m_columns)
+						if (candidate.name == tag.name)
+							column = &candidate;
+
+					if (column == nullptr)
+						column = &m_columns.emplace_back(Column{ tag.name, { }, { } });
+
+					column->games.push_back(game);
+					column->values.push_back(tag.value);
+				}
+			}
+
+		public:
+			/**
+			 * Encodes and appends a single game. Games that cannot be replayed are skipped.
+			 */
+			inline bool add(Game& game, const pgn::GameRecord& record) {
+				if (!encodeGame(game, record, m_moves)) {
+					++m_skipped;
+					return false;
+				}
+
+				m_index.push_back(m_moves.size());
+				addTags(record);
+				return true;
+			}
+
+			/**
+			 * \param records The game records, in the order they should appear in the archive.
+			 * \param threads The number of threads to encode with, 0 for the hardware concurrency.
+			 *
+			 * Encodes and appends many games in parallel. The resulting archive is identical to one
+			 * built by calling `add` on each record in order.
+			 */
+			inline void addParallel(const std::vector<pgn::GameRecord>& records, unsigned threads = 0) {
+				if (threads == 0)
+					threads = std::max(1u, std::thread::hardware_concurrency());
+
+				// The lookup tables must be initialized before the workers construct their games
+				lookup::init();
+
+				const size_t chunk = (records.size() + threads - 1) / threads;
+				std::vector<std::vector<uint8_t>> encoded(records.size());
+				std::vector<uint8_t> ok(records.size());
+				std::vector<std::thread> workers;
+
+				for (unsigned t = 0; t < threads && t * chunk < records.size(); ++t) {
+					workers.emplace_back([&, t]() {
+						Game game;
+						const size_t end = std::min(records.size(), (t + 1) * chunk);
+
+						for (size_t i = t * chunk; i < end; ++i)
+							ok[i] = encodeGame(game, records[i], encoded[i]);
+					});
+				}
+
+				for (std::thread& worker : workers)
+					worker.join();
+
+				for (size_t i = 0; i < records.size(); ++i) {
+					if (!ok[i]) {
+						++m_skipped;
+						continue;
+					}
+
+					m_moves.insert(m_moves.end(), encoded[i].begin(), encoded[i].end());
+					m_index.push_back(m_moves.size());
+					addTags(records[i]);
+				}
+			}
+
+			inline size_t size() const noexcept { return m_index.size() - 1; }
+			inline size_t skipped() const noexcept { return m_skipped; }
+
+			/**
+			 * Serializes the archive into a byte buffer.
+			 */
+			inline std::vector<uint8_t> finish() const {
+				const uint64_t gameCount = size();
+				std::vector<uint8_t> out(sizeof(Header));
+
+				Header header{ };
+				std::memcpy(header.magic, magic, sizeof(magic));
+				header.version = version;
+				header.gameCount = gameCount;
+				header.tagCount = m_columns.size();
+
+				header.movesOffset = out.size();
+				out.insert(out.end(), m_moves.begin(), m_moves.end());
+
+				header.indexOffset = out.size();
+				for (const uint64_t offset : m_index)
+					detail::writeRaw(out, offset);
+
+				header.tagsOffset = out.size();
+				const size_t directory = out.size();
+				out.resize(out.size() + m_columns.size() * sizeof(uint64_t));
+
+				for (size_t c = 0; c < m_columns.size(); ++c) {
+					const Column& column = m_columns[c];
+					const uint64_t columnOffset = detail::littleEndian(uint64_t(out.size()));
+					std::memcpy(out.data() + directory + c * sizeof(uint64_t), &columnOffset, sizeof(uint64_t));
+
+					detail::writeRaw(out, uint32_t(column.name.size()));
+					out.insert(out.end(), column.name.begin(), column.name.end());
+
+					// Expand the sparse column into a dense one, missing tags become empty strings
+					std::vector<uint64_t> offsets(gameCount + 1, 0);
+					std::string values;
+					for (size_t game = 0, i = 0; game < gameCount; ++game) {
+						offsets[game] = values.size();
+
+						// Only the first occurrence of a duplicated tag is kept
+						while (i < column.games.size() && column.games[i] < game)
+							++i;
+						if (i < column.games.size() && column.games[i] == game)
+							values += column.values[i++];
+					}
+					offsets[gameCount] = values.size();
+
+					for (const uint64_t offset : offsets)
+						detail::writeRaw(out, offset);
+					out.insert(out.end(), values.begin(), values.end());
+				}
+
+				header = detail::littleEndian(header);
+				std::memcpy(out.data(), &header, sizeof(Header));
+				return out;
+			}
+
+			inline bool save(const std::string& path) const {
+				const std::vector<uint8_t> bytes = finish();
+				std::ofstream file(path, std::ios::binary);
+				file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+				return bool(file);
+			}
+		};
+
+		/**
+		 * Streams the moves of a single archived game, replaying them with `Game::make`.
+		 */
+		class GameDecoder {
+			const uint8_t* m_cur;
+			const uint8_t* m_end;
+			size_t m_remaining;
+			bool m_corrupt = false;
+
+		public:
+			GameDecoder(const uint8_t* begin, const uint8_t* end) noexcept :
+				m_cur{begin}, m_end{end}, m_remaining{detail::readVarint(m_cur, end)}
+			{ }
+
+			inline constexpr size_t remaining() const noexcept { return m_remaining; }
+
+			/**
+			 * \returns True if decoding stopped at a move index that is out of range or cut off, or
+			 *          at a game longer than the history of `Game`, which only a corrupt or truncated
+			 *          archive has.
+			 */
+			inline constexpr bool corrupt() const noexcept { return m_corrupt; }
+
+			/**
+			 * \returns The next move, which has already been made in `game`, or the null move at the
+			 *          end of the game or at a corrupt move index.
+			 */
+			inline Move next(Game& game) noexcept {
+				if (m_remaining == 0)
+					return Move::null();
+
+				// Game holds up to 512 positions of history
+				if (game.ply() >= 511) {
+					m_corrupt = true;
+					m_remaining = 0;
+					return Move::null();
+				}
+
+				--m_remaining;
+
+				const Move move = dispatchRuntimeColor(game, []<Color Color>(Game& game, const uint8_t*& cur, const uint8_t* end) {
+					MoveList moveList;
+					movegen::legalMoves<Color>(game, moveList);
+
+					const size_t bytes = moveList.size() > 256 ? 2 : 1;
+					if (size_t(end - cur) < bytes)
+						return Move::null();
+
+					size_t index = *cur++;
+					if (bytes == 2)
+						index |= size_t(*cur++) << 8;
+
+					if (index >= moveList.size())
+						return Move::null();
+
+					const Move move = moveList[index];
+					game.make<Color>(move);
+					return move;
+				}, m_cur, m_end);
+
+				if (move.isNull()) {
+					m_corrupt = true;
+					m_remaining = 0;
+				}
+
+				return move;
+			}
+		};
+
+		/**
+		 * A read-only view over a serialized archive, giving O(1) access to any game and tag.
+		 * The bytes are not copied, so they must outlive the view. They can come from a
+		 * memory-mapped file.
+		 */
+		class ArchiveView {
+			const uint8_t* m_data = nullptr;
+			size_t m_size = 0;
+			Header m_header{ };
+
+			inline uint64_t indexAt(const size_t game) const noexcept {
+				return detail::readRaw<uint64_t>(m_data + m_header.indexOffset + game * sizeof(uint64_t));
+			}
+
+			inline bool fail() noexcept {
+				*this = { };
+				return false;
+			}
+
+		public:
+			ArchiveView() = default;
+
+			/**
+			 * \returns True if the bytes hold a valid archive, false if not. The header, the game
+			 *          index and the tag columns are checked, which reads them once, and so is that
+			 *          every game starts from a well-formed FEN tag and fits in the history of `Game`;
+			 *          the move indices are checked by GameDecoder as it goes.
+			 */
+			inline bool open(const uint8_t* data, const size_t size) noexcept {
+				if (size < sizeof(Header))
+					return fail();
+
+				std::memcpy(&m_header, data, sizeof(Header));
+				m_header = detail::littleEndian(m_header);
+				if (std::memcmp(m_header.magic, magic, sizeof(magic)) != 0 || m_header.version != version)
+					return fail();
+
+				// The sections must be in order and in bounds; the counts are bounded by the size first,
+				// so that the products below cannot overflow
+				const uint64_t words = size / sizeof(uint64_t);
+				if (m_header.gameCount >= words || m_header.tagCount > words ||
+				    m_header.movesOffset < sizeof(Header) || m_header.indexOffset < m_header.movesOffset ||
+				    m_header.indexOffset > size || (size - m_header.indexOffset) / sizeof(uint64_t) < m_header.gameCount + 1 ||
+				    m_header.tagsOffset < m_header.indexOffset + (m_header.gameCount + 1) * sizeof(uint64_t) ||
+				    m_header.tagsOffset > size || (size - m_header.tagsOffset) / sizeof(uint64_t) < m_header.tagCount)
+					return fail();
+
+				m_data = data;
+				m_size = size;
+
+				// Every game's moves must lie in the moves section
+				const uint64_t movesSize = m_header.indexOffset - m_header.movesOffset;
+				for (size_t game = 0; game < m_header.gameCount; ++game)
+					if (indexAt(game) > indexAt(game + 1) || indexAt(game + 1) > movesSize)
+						return fail();
+
+				// Every tag column must fit, with its values
+				for (size_t column = 0; column < m_header.tagCount; ++column) {
+					const uint64_t offset = detail::readRaw<uint64_t>(m_data + m_header.tagsOffset + column * sizeof(uint64_t));
+					if (offset > size || size - offset < sizeof(uint32_t))
+						return fail();
+
+					const uint64_t length = detail::readRaw<uint32_t>(m_data + offset);
+					const uint64_t offsets = offset + sizeof(uint32_t) + length;
+					if (offsets > size || (size - offsets) / sizeof(uint64_t) < m_header.gameCount + 1)
+						return fail();
+
+					const uint64_t values = offsets + (m_header.gameCount + 1) * sizeof(uint64_t);
+					uint64_t previous = 0;
+					for (size_t game = 0; game <= m_header.gameCount; ++game) {
+						const uint64_t end = detail::readRaw<uint64_t>(m_data + offsets + game * sizeof(uint64_t));
+						if (end < previous || end > size - values)
+							return fail();
+						previous = end;
+					}
+				}
+
+				// Every game must start from a position `init` can read, and its moves must fit in
+				// the 512 positions of history from there
+				size_t fenColumn = m_header.tagCount;
+				for (size_t column = m_header.tagCount; column-- > 0;)
+					if (tagName(column) == "FEN")
+						fenColumn = column;
+
+				const uint8_t* moves = m_data + m_header.movesOffset;
+				for (size_t game = 0; game < m_header.gameCount; ++game) {
+					const std::string_view fen = fenColumn < m_header.tagCount ? tag(fenColumn, game) : std::string_view{ };
+					const int ply = Game::fenPly(fen.empty() ? QuickFEN::start : fen);
+
+					const uint8_t* cur = moves + indexAt(game);
+					const uint64_t count = detail::readVarint(cur, moves + indexAt(game + 1));
+					if (ply < 0 || ply >= 511 || count >= uint64_t(511 - ply))
+						return fail();
+				}
+
+				return true;
+			}
+
+			inline size_t size() const noexcept { return m_header.gameCount; }
+			inline size_t tagCount() const noexcept { return m_header.tagCount; }
+
+			/**
+			 * \returns A decoder for the moves of the given game.
+			 */
+			inline GameDecoder moves(const size_t game) const noexcept {
+				CHESS_ASSERT(game < size());
+
+				const uint8_t* moves = m_data + m_header.movesOffset;
+				return GameDecoder{ moves + indexAt(game), moves + indexAt(game + 1) };
+			}
+
+			inline std::string_view tagName(const size_t column) const noexcept {
+				const uint64_t offset = detail::readRaw<uint64_t>(m_data + m_header.tagsOffset + column * sizeof(uint64_t));
+				const uint32_t length = detail::readRaw<uint32_t>(m_data + offset);
+				return { reinterpret_cast<const char*>(m_data + offset + sizeof(uint32_t)), length };
+			}
+
+			/**
+			 * \returns The value of a tag column for the given game, empty if the game does not have the tag.
+			 */
+			inline std::string_view tag(const size_t column, const size_t game) const noexcept {
+				CHESS_ASSERT(game < size());
+
+				const uint64_t offset = detail::readRaw<uint64_t>(m_data + m_header.tagsOffset + column * sizeof(uint64_t));
+				const uint32_t length = detail::readRaw<uint32_t>(m_data + offset);
+				const uint8_t* offsets = m_data + offset + sizeof(uint32_t) + length;
+				const char* values = reinterpret_cast<const char*>(offsets + (size() + 1) * sizeof(uint64_t));
+
+				const uint64_t begin = detail::readRaw<uint64_t>(offsets + game * sizeof(uint64_t));
+				const uint64_t end = detail::readRaw<uint64_t>(offsets + (game + 1) * sizeof(uint64_t));
+				return { values + begin, size_t(end - begin) };
+			}
+
+			/**
+			 * \returns The value of the named tag for the given game, empty if not present.
+			 */
+			inline std::string_view tag(const std::string_view name, const size_t game) const noexcept {
+				for (size_t column = 0; column < tagCount(); ++column)
+					if (tagName(column) == name)
+						return tag(column, game);
+
+				return { };
+			}
+
+			/**
+			 * Initializes the given game to the starting position of an archived game, and
+			 * returns a decoder to replay its moves.
+			 */
+			inline GameDecoder replay(Game& game, const size_t index) const {
+				const std::string_view fen = tag("FEN", index);
+				game.init(fen.empty() ? QuickFEN::start : fen);
+
+				return moves(index);
+			}
+		};
+	}
+}
@@ -2,7 +2,7 @@
  * A fast chess library for C++
  */
 #pragma once
-#include "defs.hpp"
+#include "move.hpp"
 
 namespace chess {
 	class Board {
@@ -190,6 +190,59 @@ namespace chess {
 			mailbox[to] = piece;
 			mailbox[from] = Piece::None;
 		}
+
+		/**
+		 * @param piece The piece on the square.
+		 * @param square The square to remove the piece from.
+		 * 
+		 * Same as `removePiece(square)`, for when the piece is already known, without reading the mailbox.
+		 */
+		CHESS_ALWAYS_INLINE inline constexpr void removePiece(Piece piece, int square) noexcept {
+			CHESS_ASSERT_SQUARE(square);
+			CHESS_ASSERT(mailbox[square] == piece);
+
+			const Bitboard mask = 1ull << square;
+
+			bitboards[static_cast<size_t>(piece)] ^= mask;
+			m_occupied ^= mask;
+			m_colorOccupancy[static_cast<size_t>(getPieceColor(piece))] ^= mask;
+			
+			mailbox[square] = Piece::None;
+		}
+
+		/**
+		 * @param piece The piece on the "from" square.
+		 * @param from The square to move from.
+		 * @param to The square to move to.
+		 * 
+		 * Same as `movePiece(from, to)`, for when the piece is already known, without reading the mailbox.
+		 */
+		CHESS_ALWAYS_INLINE inline constexpr void movePiece(Piece piece, int from, int to) noexcept {
+			CHESS_ASSERT_SQUARE(from);
+			CHESS_ASSERT_SQUARE(to);
+			CHESS_ASSERT(mailbox[from] == piece);
+			CHESS_ASSERT(mailbox[to] == Piece::None);
+
+			const Bitboard mask = (1ull << from) | (1ull << to);
+
+			bitboards[static_cast<size_t>(piece)] ^= mask;
+			m_occupied ^= mask;
+			m_colorOccupancy[static_cast<size_t>(getPieceColor(piece))] ^= mask;
+			
+			mailbox[to] = piece;
+			mailbox[from] = Piece::None;
+		}
+
+		/**
+		 * @tparam Color The color of the moving piece.
+		 * @param move A pseudo-legal move in this position.
+		 * 
+		 * Looks up the moving and captured pieces of a move, such as one from a transposition table.
+		 */
+		template <Color Color>
+		inline constexpr WideMove widen(const Move move) const noexcept {
+			return { move, mailbox[move.getFrom()], move.capturedPiece<Color>(mailbox[move.getTo()]) };
+		}
 	};
 	
 	inline std::ostream& operator<<(std::ostream& os, const Board& board) {
@@ -0,0 +1,297 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "pgn.hpp"
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+/**
+ * @file Provides a columnar exporter of positions, for analytics over game databases.
+ *
+ * Every position of every game becomes one row. Each field is written to its own file
+ * as a contiguous array of a fixed-width type, so queries can scan (and vectorize over)
+ * just the columns they need instead of parsing FEN or PGN.
+ *
+ * \cond Files written into the output directory, one row per position:
+ *
+ *       wp wn wb wr wq wk bp bn bb br bq bk   uint64_t   piece bitboards
+ *       side                                  uint8_t    0 for White, 1 for Black
+ *       castling                              uint8_t    CastlingFlags
+ *       eval                                  int16_t    centipawns from White's perspective
+ *       ply                                   uint16_t   ply of the position
+ *       game                                  uint32_t   index of the game
+ *       result                                int8_t     see columnar::Result
+ *
+ *       Next to each `<name>.bin` is a `<name>.stats` file holding, for each chunk of
+ *       `ChunkRows` rows, a uint64_t row count followed by the minimum and maximum
+ *       value of the chunk (in the column's type). Scans can skip whole chunks with it.
+ */
+namespace chess {
+	namespace columnar {
+		inline constexpr size_t ChunkRows = 65536;
+
+		namespace Result {
+			enum __Result : int8_t {
+				BlackWins = -1,
+				Draw = 0,
+				WhiteWins = 1,
+				Unknown = 2
+			};
+		}
+
+		inline constexpr int8_t parseResult(const std::string_view result) noexcept {
+			if (result == "1-0") return Result::WhiteWins;
+			if (result == "0-1") return Result::BlackWins;
+			if (result == "1/2-1/2") return Result::Draw;
+			return Result::Unknown;
+		}
+
+		/**
+		 * The default evaluation: material balance in centipawns, from White's perspective.
+		 */
+		struct MaterialEvaluator {
+			inline int16_t operator()(const Game& game) const noexcept {
+				const Board& board = game.board();
+				const auto material = [&]<Color Color>() {
+					return 100 * popcount(board.pawns<Color>()) + 300 * popcount(board.knights<Color>()) +
+					       300 * popcount(board.bishops<Color>()) + 500 * popcount(board.rooks<Color>()) +
+					       900 * popcount(board.queens<Color>());
+				};
+
+				return int16_t(material.template operator()<Color::White>() - material.template operator()<Color::Black>());
+			}
+		};
+
+		namespace detail {
+			/**
+			 * One output column, with its running chunk statistics.
+			 */
+			template <typename T>
+			class Column {
+				std::ofstream m_file;
+				std::ofstream m_stats;
+				T m_min = std::numeric_limits<T>::max();
+				T m_max = std::numeric_limits<T>::lowest();
+				uint64_t m_chunkRows = 0;
+
+				inline void flushChunk() {
+					if (m_chunkRows == 0)
+						return;
+
+					m_stats.write(reinterpret_cast<const char*>(&m_chunkRows), sizeof(m_chunkRows));
+					m_stats.write(reinterpret_cast<const char*>(&m_min), sizeof(T));
+					m_stats.write(reinterpret_cast<const char*>(&m_max), sizeof(T));
+
+					m_min = std::numeric_limits<T>::max();
+					m_max = std::numeric_limits<T>::lowest();
+					m_chunkRows = 0;
+				}
+
+			public:
+				inline bool open(const std::filesystem::path& directory, const std::string_view name) {
+					m_file.open(directory / (std::string(name) + ".bin"), std::ios::binary | std::ios::trunc);
+					m_stats.open(directory / (std::string(name) + ".stats"), std::ios::binary | std::ios::trunc);
+					return m_file && m_stats;
+				}
+
+				inline void append(const std::vector<T>& values) {
+					m_file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+
+					for (const T value : values) {
+						m_min = std::min(m_min, value);
+						m_max = std::max(m_max, value);
+
+						if (++m_chunkRows == ChunkRows)
+							flushChunk();
+					}
+				}
+
+				inline bool close() {
+					flushChunk();
+					m_file.close();
+					m_stats.close();
+					return m_file && m_stats;
+				}
+			};
+
+			/**
+			 * Rows produced by a single worker, in column form.
+			 */
+			struct Rows {
+				std::vector<Bitboard> pieces[12];
+				std::vector<uint8_t> side, castling;
+				std::vector<int16_t> eval;
+				std::vector<uint16_t> ply;
+				std::vector<uint32_t> game;
+				std::vector<int8_t> result;
+
+				inline void clear() noexcept {
+					for (std::vector<Bitboard>& column : pieces)
+						column.clear();
+					side.clear(), castling.clear(), eval.clear(), ply.clear(), game.clear(), result.clear();
+				}
+			};
+		}
+
+		/**
+		 * Writes positions of replayed games into column files.
+		 *
+		 * \tparam Evaluator Called as `int16_t(const Game&)` on every position for the eval column.
+		 */
+		template <typename Evaluator = MaterialEvaluator>
+		class Exporter {
+			static constexpr std::string_view PieceNames[12] = {
+				"wp", "wn", "wb", "wr", "wq", "wk", "bp", "bn", "bb", "br", "bq", "bk"
+			};
+			static constexpr Piece Pieces[12] = {
+				Piece::WhitePawn, Piece::WhiteKnight, Piece::WhiteBishop, Piece::WhiteRook, Piece::WhiteQueen, Piece::WhiteKing,
+				Piece::BlackPawn, Piece::BlackKnight, Piece::BlackBishop, Piece::BlackRook, Piece::BlackQueen, Piece::BlackKing
+			};
+
+			Evaluator m_evaluator;
+
+			detail::Column<Bitboard> m_pieces[12];
+			detail::Column<uint8_t> m_side, m_castling;
+			detail::Column<int16_t> m_eval;
+			detail::Column<uint16_t> m_ply;
+			detail::Column<uint32_t> m_game;
+			detail::Column<int8_t> m_result;
+
+			uint32_t m_games = 0;
+			uint64_t m_rows = 0;
+			bool m_ok = true;
+
+			inline void addRow(detail::Rows& rows, const Game& game, const uint32_t gameId, const int8_t result) const {
+				const Board& board = game.board();
+				for (size_t i = 0; i < 12; ++i)
+					rows.pieces[i].push_back(board.pieceBitboard(Pieces[i]));
+
+				rows.side.push_back(uint8_t(game.turn()));
+				rows.castling.push_back(uint8_t(game.castlingRights()));
+				rows.eval.push_back(m_evaluator(game));
+				rows.ply.push_back(uint16_t(game.ply()));
+				rows.game.push_back(gameId);
+				rows.result.push_back(result);
+			}
+
+			// Replays a game, adding one row per position. Stops at the first illegal move. Games
+			// starting from a malformed FEN tag, or one with no room left in the history, add no rows.
+			inline void replay(Game& game, detail::Rows& rows, const pgn::GameRecord& record, const uint32_t gameId) const {
+				const std::string_view fen = record.tag("FEN");
+
+				// Game holds up to 512 positions of history, and `init` already writes at the starting ply
+				const int ply = Game::fenPly(fen.empty() ? QuickFEN::start : fen);
+				if (ply < 0 || ply >= 511)
+					return;
+
+				game.init(fen.empty() ? QuickFEN::start : fen);
+
+				const int8_t result = parseResult(record.result);
+				addRow(rows, game, gameId, result);
+
+				const size_t plies = std::min(record.moves.size(), size_t(511 - game.ply()));
+				for (size_t i = 0; i < plies; ++i) {
+					if (pgn::playSAN(game, record.moves[i]).isNull())
+						break;
+
+					addRow(rows, game, gameId, result);
+				}
+			}
+
+			inline void write(const detail::Rows& rows) {
+				for (size_t i = 0; i < 12; ++i)
+					m_pieces[i].append(rows.pieces[i]);
+
+				m_side.append(rows.side);
+				m_castling.append(rows.castling);
+				m_eval.append(rows.eval);
+				m_ply.append(rows.ply);
+				m_game.append(rows.game);
+				m_result.append(rows.result);
+				m_rows += rows.side.size();
+			}
+
+		public:
+			/**
+			 * \param directory The output directory. It is created if it does not exist, and existing columns are overwritten.
+			 */
+			explicit Exporter(const std::filesystem::path& directory, Evaluator evaluator = { }) : m_evaluator{std::move(evaluator)} {
+				std::error_code error;
+				std::filesystem::create_directories(directory, error);
+
+				for (size_t i = 0; i < 12; ++i)
+					m_ok &= m_pieces[i].open(directory, PieceNames[i]);
+
+				m_ok &= m_side.open(directory, "side");
+				m_ok &= m_castling.open(directory, "castling");
+				m_ok &= m_eval.open(directory, "eval");
+				m_ok &= m_ply.open(directory, "ply");
+				m_ok &= m_game.open(directory, "game");
+				m_ok &= m_result.open(directory, "result");
+			}
+
+			/**
+			 * \returns False if any column file could not be opened or written.
+			 */
+			inline bool ok() const noexcept { return m_ok; }
+			inline uint32_t games() const noexcept { return m_games; }
+			inline uint64_t rows() const noexcept { return m_rows; }
+
+			/**
+			 * \param records The games to export. Game ids continue from previous calls.
+			 * \param threads The number of worker threads, 0 for the hardware concurrency.
+			 *
+			 * Replays and exports a batch of games. Workers replay contiguous ranges of games, and
+			 * their rows are written in game order, so the output does not depend on the thread count.
+			 */
+			inline void add(const std::vector<pgn::GameRecord>& records, unsigned threads = 0) {
+				if (threads == 0)
+					threads = std::max(1u, std::thread::hardware_concurrency());
+
+				// The lookup tables must be initialized before the workers construct their games
+				lookup::init();
+
+				const size_t chunk = (records.size() + threads - 1) / std::max(1u, threads);
+				std::vector<detail::Rows> rows(threads);
+				std::vector<std::thread> workers;
+
+				for (unsigned t = 0; t < threads && t * chunk < records.size(); ++t) {
+					workers.emplace_back([&, t]() {
+						Game game;
+						const size_t end = std::min(records.size(), (t + 1) * chunk);
+
+						for (size_t i = t * chunk; i < end; ++i)
+							replay(game, rows[t], records[i], uint32_t(m_games + i));
+					});
+				}
+
+				for (std::thread& worker : workers)
+					worker.join();
+
+				for (const detail::Rows& workerRows : rows)
+					write(workerRows);
+
+				m_games += uint32_t(records.size());
+			}
+
+			/**
+			 * Writes the statistics of the last chunk and closes all files.
+			 */
+			inline bool finish() {
+				for (detail::Column<Bitboard>& column : m_pieces)
+					m_ok &= column.close();
+
+				m_ok &= m_side.close();
+				m_ok &= m_castling.close();
+				m_ok &= m_eval.close();
+				m_ok &= m_ply.close();
+				m_ok &= m_game.close();
+				m_ok &= m_result.close();
+				return m_ok;
+			}
+		};
+	}
+}
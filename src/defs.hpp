@@ -10,6 +10,27 @@
 #	define CHESS_PROFILE
 #endif
 
+// With CHESS_METRICS, hot entry points record their latency into the chess::metrics histograms
+#ifdef CHESS_METRICS
+#	include "metrics.hpp"
+#	define CHESS_METRIC_SCOPE(operation) const ::chess::metrics::ScopedTimer chessMetricTimer{ ::chess::metrics::Operation::operation }
+#	define CHESS_METRIC_RECORD(operation, latency) ::chess::metrics::record(::chess::metrics::Operation::operation, latency)
+#else
+#	define CHESS_METRIC_SCOPE(operation)
+#	define CHESS_METRIC_RECORD(operation, latency)
+#endif
+
+// With CHESS_TRACE, calls into the library are passed to the thread's trace sink, see trace.hpp
+#ifdef CHESS_TRACE
+#	define CHESS_TRACE_EVENT(event, game, data)                                                                      \
+		do {                                                                                                         \
+			if (!std::is_constant_evaluated() && ::chess::trace::detail::sink)                                       \
+				::chess::trace::detail::sink->record(::chess::trace::Event::event, game, uint16_t(data));            \
+		} while (false)
+#else
+#	define CHESS_TRACE_EVENT(event, game, data)
+#endif
+
 #if defined(__GNUC__) || defined(__clang__)
 #	define CHESS_ALWAYS_INLINE __attribute__((always_inline))
 #else
@@ -310,4 +331,34 @@ namespace chess {
 		inline constexpr const char* complex = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1";
 		inline constexpr const char* buggy = "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8";
 	}
+
+	class Game;
+
+	namespace trace {
+		/**
+		 * The library calls that are traced.
+		 */
+		enum class Event : uint8_t {
+			Position,		/* the game was set up */
+			LegalMoves,		/* data: 1 when only counting */
+			Make,			/* data: the move */
+			Unmake,			/* data: the move */
+			Hash
+		};
+
+		/**
+		 * Receives the library calls made on a thread, with CHESS_TRACE defined.
+		 */
+		class Sink {
+		public:
+			virtual void record(Event event, const Game& game, uint16_t data) = 0;
+
+		protected:
+			~Sink() = default;
+		};
+
+		namespace detail {
+			inline thread_local Sink* sink = nullptr;
+		}
+	}
 }
\ No newline at end of file
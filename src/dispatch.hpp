@@ -0,0 +1,173 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "movegen.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/**
+ * @file Provides the hot kernels (bulk move counting and perft) compiled for several x86-64
+ *       ISA levels, with the best one selected once at startup from CPUID.
+ *
+ * Define `CHESS_MULTIVERSION` and compile for baseline x86-64 (no `-mbmi2`, no `-march=native`)
+ * to get one binary that runs everywhere:
+ *
+ *     generic      any x86-64                              magic slider index
+ *     x86-64-v2    POPCNT and SSE4.2 (pre-Haswell Xeons)   magic slider index
+ *     avx2         AVX2 and BMI1, without a fast PEXT      magic slider index
+ *     bmi2         AVX2 and a fast PEXT                    PEXT slider index
+ *     avx512       AVX-512 and a fast PEXT                 PEXT slider index
+ *
+ * AMD CPUs before Zen 3 implement PEXT in microcode, so they get the magic index even though
+ * they support BMI2. Setting the `CHESS_KERNELS` environment variable to one of the names
+ * above forces that variant, if the CPU supports it.
+ *
+ * Without `CHESS_MULTIVERSION`, there is a single "native" variant, compiled for whatever the
+ * build targets.
+ *
+ * Each variant is instantiated with its slider index, which reaches every slider lookup of move
+ * generation, so no lookup tests the CPU. The inference kernels of inference.hpp are not
+ * dispatched; they follow the compile-time target.
+ */
+namespace chess {
+	namespace dispatch {
+		/**
+		 * A table of kernel entry points. Callers fetch it once, outside their loops.
+		 */
+		struct Kernels {
+			const char* name;
+			const char* sliderIndex;		/* "pext" or "magic" */
+			uint64_t (*perft)(Game& game, int depth);
+			uint64_t (*legalMoveCount)(const Game& game);
+		};
+
+		namespace detail {
+			template <typename Index>
+			struct SliderAttacks {
+				CHESS_ALWAYS_INLINE inline Bitboard bishop(const int from, const Bitboard occupied) const noexcept {
+					return Index::bishop(from, occupied);
+				}
+
+				CHESS_ALWAYS_INLINE inline Bitboard rook(const int from, const Bitboard occupied) const noexcept {
+					return Index::rook(from, occupied);
+				}
+			};
+		}
+
+		/**
+		 * Defines the kernels of one variant in their own namespace. Move generation is flattened into
+		 * the kernels, so that all of it is compiled for the variant's target.
+		 */
+#define CHESS_DEFINE_KERNELS(Namespace, Name, Target, Index, IndexName)                                            \
+		namespace Namespace {                                                                               \
+			template <Color Color>                                                                          \
+			Target __attribute__((flatten)) inline uint64_t legalMoveCount(const Game& game) noexcept {     \
+				movegen::detail::MoveCounter counter;                                                       \
+				movegen::legalMoves<Color>(game, counter, detail::SliderAttacks<Index>{ });                 \
+				return counter.count;                                                                       \
+			}                                                                                               \
+                                                                                                            \
+			template <Color Color>                                                                          \
+			Target __attribute__((flatten)) inline void legalMoves(const Game& game, MoveList& moves) noexcept { \
+				movegen::legalMoves<Color>(game, moves, detail::SliderAttacks<Index>{ });                   \
+			}                                                                                               \
+                                                                                                            \
+			template <Color Color>                                                                          \
+			Target inline uint64_t perft(Game& game, const int depth) noexcept {                            \
+				if (depth <= 1)                                                                             \
+					return depth == 1 ? legalMoveCount<Color>(game) : 1;                                    \
+                                                                                                            \
+				MoveList moves;                                                                             \
+				legalMoves<Color>(game, moves);                                                             \
+                                                                                                            \
+				uint64_t nodes = 0;                                                                         \
+				for (const Move move : moves) {                                                             \
+					const UndoInfo undoInfo = game.make<Color>(move);                                       \
+					nodes += perft<~Color>(game, depth - 1);                                                \
+					game.unmake<Color>(move, undoInfo);                                                     \
+				}                                                                                           \
+                                                                                                            \
+				return nodes;                                                                               \
+			}                                                                                               \
+                                                                                                            \
+			inline constexpr Kernels kernels = {                                                            \
+				Name,                                                                                       \
+				IndexName,                                                                                  \
+				[](Game& game, const int depth) {                                                           \
+					return game.turn() == Color::White ? perft<Color::White>(game, depth) : perft<Color::Black>(game, depth); \
+				},                                                                                          \
+				[](const Game& game) {                                                                      \
+					return game.turn() == Color::White ? legalMoveCount<Color::White>(game) : legalMoveCount<Color::Black>(game); \
+				}                                                                                           \
+			};                                                                                              \
+		}
+
+#ifdef CHESS_MULTIVERSION
+		CHESS_DEFINE_KERNELS(generic, "generic", , lookup::MagicIndex, "magic")
+		CHESS_DEFINE_KERNELS(x86_64_v2, "x86-64-v2", __attribute__((target("popcnt,sse4.2"))), lookup::MagicIndex, "magic")
+		CHESS_DEFINE_KERNELS(avx2, "avx2", __attribute__((target("avx2,bmi,popcnt,lzcnt"))), lookup::MagicIndex, "magic")
+		CHESS_DEFINE_KERNELS(bmi2, "bmi2", __attribute__((target("avx2,bmi,bmi2,popcnt,lzcnt"))), lookup::PextIndex, "pext")
+		CHESS_DEFINE_KERNELS(avx512, "avx512", __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx2,bmi,bmi2,popcnt,lzcnt"))), lookup::PextIndex, "pext")
+
+		namespace detail {
+			inline const Kernels& select() noexcept {
+				lookup::init();
+				__builtin_cpu_init();
+
+				const bool v2 = __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("sse4.2");
+				const bool v3 = v2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi");
+				const bool avx512 = v3 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+				                    __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq");
+
+				// From best to worst. The PEXT variants need the tables `lookup::init` only builds for a fast PEXT.
+				const struct {
+					const Kernels& kernels;
+					bool supported;
+				} variants[] = {
+					{ avx512::kernels, avx512 && lookup::usePext },
+					{ bmi2::kernels, v3 && lookup::usePext },
+					{ avx2::kernels, v3 },
+					{ x86_64_v2::kernels, v2 },
+					{ generic::kernels, true }
+				};
+
+				const char* forced = std::getenv("CHESS_KERNELS");
+				for (const auto& variant : variants)
+					if (variant.supported && (forced == nullptr || std::strcmp(forced, variant.kernels.name) == 0))
+						return variant.kernels;
+
+				return generic::kernels;
+			}
+		}
+#else
+		CHESS_DEFINE_KERNELS(native, "native", , lookup::PextIndex, "pext")
+
+		namespace detail {
+			inline const Kernels& select() noexcept {
+				lookup::init();
+				return native::kernels;
+			}
+		}
+#endif
+
+#undef CHESS_DEFINE_KERNELS
+
+		/**
+		 * \returns The kernels for this CPU. They are selected on the first call, which also
+		 *          initializes the lookup tables.
+		 */
+		inline const Kernels& kernels() noexcept {
+			static const Kernels& selected = detail::select();
+			return selected;
+		}
+
+		/**
+		 * \returns A description of the active path, for logs.
+		 */
+		inline std::string describe() {
+			return std::string("kernels: ") + kernels().name + ", slider index: " + kernels().sliderIndex;
+		}
+	}
+}
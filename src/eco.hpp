@@ -0,0 +1,168 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "helper.hpp"
+#include "pgn.hpp"
+#include <algorithm>
+
+/**
+ * @file Provides opening (ECO) classification through a hash-indexed table.
+ *
+ * Openings are keyed by the Zobrist hash of the position they reach, rather than by
+ * their move prefix, so transpositions into a known opening are classified correctly.
+ * The en-passant file only counts when an en-passant capture is legal (see `positionKey`),
+ * so lines ending in a double pawn push match their transpositions too.
+ */
+namespace chess {
+	namespace eco {
+		/**
+		 * \returns The Zobrist hash of the position, without the en-passant file unless an
+		 *          en-passant capture is legal. Positions that only differ by a double pawn push
+		 *          that cannot be captured en passant get the same key.
+		 */
+		inline zobrist::Key positionKey(const Game& game) noexcept {
+			const int square = game.enPassantSquare();
+			if (square == Square::None)
+				return game.zobristHash();
+
+			const bool capturable = dispatchRuntimeColor(game, []<Color Color>(const Game& game) {
+				bool found = false;
+				movegen::legalMoves<Color>(game, [&](const Move move) { found |= move.isEnPassant(); });
+				return found;
+			});
+
+			return capturable ? game.zobristHash() : game.zobristHash() ^ zobrist::enPassantTable[fileOf(square)];
+		}
+
+		struct Opening {
+			std::string code;	/* ECO code, for instance, C65 */
+			std::string name;	/* opening name, for instance, Ruy Lopez: Berlin Defense */
+			int ply;			/* the number of ply of the defining line */
+		};
+
+		/**
+		 * An immutable table mapping positions to openings. Entries are added with `add`,
+		 * after which `compile` must be called before probing.
+		 */
+		class Table {
+			struct Entry {
+				zobrist::Key key;
+				uint32_t opening;
+			};
+
+			std::vector<Opening> m_openings;
+			std::vector<Entry> m_entries;
+			int m_maxPly = 0;
+
+		public:
+			/**
+			 * \param game A scratch game used to replay the line.
+			 * \param code The ECO code.
+			 * \param name The opening name.
+			 * \param movetext The defining line in SAN, for instance, "1. e4 e5 2. Nf3 Nc6 3. Bb5 Nf6".
+			 * \returns True if the line was added, false if a move could not be converted.
+			 */
+			inline bool add(Game& game, const std::string_view code, const std::string_view name, const std::string_view movetext) {
+				pgn::Reader reader(movetext);
+				pgn::GameRecord record;
+				reader.next(record);
+
+				game.init();
+				for (const std::string& san : record.moves)
+					if (pgn::playSAN(game, san).isNull())
+						return false;
+
+				const int ply = int(record.moves.size());
+				m_entries.push_back({ positionKey(game), uint32_t(m_openings.size()) });
+				m_openings.push_back({ std::string(code), std::string(name), ply });
+				m_maxPly = std::max(m_maxPly, ply);
+				return true;
+			}
+
+			/**
+			 * Sorts the table by key. If several lines reach the same position, the first one added wins.
+			 */
+			inline void compile() {
+				std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry& lhs, const Entry& rhs) {
+					return lhs.key < rhs.key;
+				});
+
+				m_entries.erase(std::unique(m_entries.begin(), m_entries.end(), [](const Entry& lhs, const Entry& rhs) {
+					return lhs.key == rhs.key;
+				}), m_entries.end());
+			}
+
+			/**
+			 * \param key The `positionKey` of the position.
+			 * \returns The opening reaching the given position, nullptr if none.
+			 */
+			inline const Opening* probe(const zobrist::Key key) const noexcept {
+				const auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, [](const Entry& entry, const zobrist::Key key) {
+					return entry.key < key;
+				});
+
+				return it != m_entries.end() && it->key == key ? &m_openings[it->opening] : nullptr;
+			}
+
+			// The length of the longest line, in ply. No position past this can be in the table.
+			inline int maxPly() const noexcept { return m_maxPly; }
+			inline size_t size() const noexcept { return m_entries.size(); }
+		};
+
+		/**
+		 * Classifies a game while it is being replayed. Call `start` with the starting position,
+		 * then `update` once after every move; it probes the table at most once per ply, and
+		 * stops probing entirely once the game is longer than any line in the table.
+		 */
+		class Classifier {
+			const Table& m_table;
+			const Opening* m_opening = nullptr;
+			int m_plies = 0;
+
+		public:
+			explicit Classifier(const Table& table) noexcept : m_table{table} { }
+
+			inline void start(const Game& game) noexcept {
+				m_plies = 0;
+				m_opening = m_table.probe(positionKey(game));
+			}
+
+			inline void update(const Game& game) noexcept {
+				if (++m_plies > m_table.maxPly())
+					return;
+
+				if (const Opening* opening = m_table.probe(positionKey(game)))
+					m_opening = opening;
+			}
+
+			/**
+			 * \returns The most recently reached opening, nullptr if none was reached.
+			 */
+			inline const Opening* opening() const noexcept { return m_opening; }
+		};
+
+		/**
+		 * \returns The opening of a PGN game, nullptr if unknown. `game` is used as scratch space.
+		 */
+		inline const Opening* classify(const Table& table, Game& game, const pgn::GameRecord& record) {
+			// Games from a custom starting position are not classified
+			if (!record.tag("FEN").empty())
+				return nullptr;
+
+			game.init();
+			Classifier classifier(table);
+			classifier.start(game);
+
+			const size_t plies = std::min(record.moves.size(), size_t(table.maxPly()));
+			for (size_t i = 0; i < plies; ++i) {
+				if (pgn::playSAN(game, record.moves[i]).isNull())
+					break;
+
+				classifier.update(game);
+			}
+
+			return classifier.opening();
+		}
+	}
+}
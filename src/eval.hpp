@@ -0,0 +1,157 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "game.hpp"
+#include <array>
+
+/**
+ * @file Provides a small static evaluation: material and piece-square tables, with the king
+ *       table tapered between the middlegame and the endgame.
+ *
+ * The tables are the well-known "simplified evaluation function". This is not meant to play
+ * strong chess, but to give searches and dataset labeling a sensible and cheap score.
+ */
+namespace chess {
+	namespace eval {
+		inline constexpr int PieceValues[6] = { 100, 320, 330, 500, 900, 0 };
+
+		inline constexpr int pieceValue(const PieceType pieceType) noexcept {
+			return PieceValues[(size_t)pieceType];
+		}
+
+		namespace detail {
+			// From White's point of view, with a8 first, as the tables are usually written
+			inline constexpr int8_t PieceSquareTables[6][64] = {
+				{
+					  0,   0,   0,   0,   0,   0,   0,   0,
+					 50,  50,  50,  50,  50,  50,  50,  50,
+					 10,  10,  20,  30,  30,  20,  10,  10,
+					  5,   5,  10,  25,  25,  10,   5,   5,
+					  0,   0,   0,  20,  20,   0,   0,   0,
+					  5,  -5, -10,   0,   0, -10,  -5,   5,
+					  5,  10,  10, -20, -20,  10,  10,   5,
+					  0,   0,   0,   0,   0,   0,   0,   0
+				},
+				{
+					-50, -40, -30, -30, -30, -30, -40, -50,
+					-40, -20,   0,   0,   0,   0, -20, -40,
+					-30,   0,  10,  15,  15,  10,   0, -30,
+					-30,   5,  15,  20,  20,  15,   5, -30,
+					-30,   0,  15,  20,  20,  15,   0, -30,
+					-30,   5,  10,  15,  15,  10,   5, -30,
+					-40, -20,   0,   5,   5,   0, -20, -40,
+					-50, -40, -30, -30, -30, -30, -40, -50
+				},
+				{
+					-20, -10, -10, -10, -10, -10, -10, -20,
+					-10,   0,   0,   0,   0,   0,   0, -10,
+					-10,   0,   5,  10,  10,   5,   0, -10,
+					-10,   5,   5,  10,  10,   5,   5, -10,
+					-10,   0,  10,  10,  10,  10,   0, -10,
+					-10,  10,  10,  10,  10,  10,  10, -10,
+					-10,   5,   0,   0,   0,   0,   5, -10,
+					-20, -10, -10, -10, -10, -10, -10, -20
+				},
+				{
+					  0,   0,   0,   0,   0,   0,   0,   0,
+					  5,  10,  10,  10,  10,  10,  10,   5,
+					 -5,   0,   0,   0,   0,   0,   0,  -5,
+					 -5,   0,   0,   0,   0,   0,   0,  -5,
+					 -5,   0,   0,   0,   0,   0,   0,  -5,
+					 -5,   0,   0,   0,   0,   0,   0,  -5,
+					 -5,   0,   0,   0,   0,   0,   0,  -5,
+					  0,   0,   0,   5,   5,   0,   0,   0
+				},
+				{
+					-20, -10, -10,  -5,  -5, -10, -10, -20,
+					-10,   0,   0,   0,   0,   0,   0, -10,
+					-10,   0,   5,   5,   5,   5,   0, -10,
+					 -5,   0,   5,   5,   5,   5,   0,  -5,
+					  0,   0,   5,   5,   5,   5,   0,  -5,
+					-10,   5,   5,   5,   5,   5,   0, -10,
+					-10,   0,   5,   0,   0,   0,   0, -10,
+					-20, -10, -10,  -5,  -5, -10, -10, -20
+				},
+				{
+					-30, -40, -40, -50, -50, -40, -40, -30,
+					-30, -40, -40, -50, -50, -40, -40, -30,
+					-30, -40, -40, -50, -50, -40, -40, -30,
+					-30, -40, -40, -50, -50, -40, -40, -30,
+					-20, -30, -30, -40, -40, -30, -30, -20,
+					-10, -20, -20, -20, -20, -20, -20, -10,
+					 20,  20,   0,   0,   0,   0,  20,  20,
+					 20,  30,  10,   0,   0,  10,  30,  20
+				}
+			};
+
+			inline constexpr int8_t KingEndgameTable[64] = {
+				-50, -40, -30, -20, -20, -30, -40, -50,
+				-30, -20, -10,   0,   0, -10, -20, -30,
+				-30, -10,  20,  30,  30,  20, -10, -30,
+				-30, -10,  30,  40,  40,  30, -10, -30,
+				-30, -10,  30,  40,  40,  30, -10, -30,
+				-30, -10,  20,  30,  30,  20, -10, -30,
+				-30, -30,   0,   0,   0,   0, -30, -30,
+				-50, -30, -30, -30, -30, -30, -30, -50
+			};
+
+			// Material plus placement, indexed by Piece and square, from White's point of view
+			inline constexpr auto pieceSquare = []() constexpr {
+				std::array<std::array<int16_t, 64>, 16> table{ };
+
+				for (size_t pieceType = 0; pieceType < 6; ++pieceType) {
+					for (int square = 0; square < 64; ++square) {
+						table[pieceType][square] = int16_t(PieceValues[pieceType] + PieceSquareTables[pieceType][square ^ 56]);
+						table[pieceType | 8][square] = int16_t(-PieceValues[pieceType] - PieceSquareTables[pieceType][square]);
+					}
+				}
+
+				return table;
+			}();
+
+			inline constexpr int MaxPhase = 24;
+
+			// 24 with all pieces on the board, 0 with only kings and pawns
+			inline constexpr int phase(const Board& board) noexcept {
+				const int phase =
+					popcount(board.knights<Color::White>() | board.knights<Color::Black>() | board.bishops<Color::White>() | board.bishops<Color::Black>()) +
+					popcount(board.rooks<Color::White>() | board.rooks<Color::Black>()) * 2 +
+					popcount(board.queens<Color::White>() | board.queens<Color::Black>()) * 4;
+
+				return std::min(phase, MaxPhase);
+			}
+		}
+
+		/**
+		 * \returns The static evaluation in centipawns, from White's point of view.
+		 */
+		inline constexpr int evaluateWhite(const Board& board) noexcept {
+			int score = 0;
+
+			for (Bitboard b = board.occupied() & ~(board.kings<Color::White>() | board.kings<Color::Black>()); b;) {
+				const int square = popLSB(b);
+				score += detail::pieceSquare[(size_t)board.pieceAt(square)][square];
+			}
+
+			// Kings move from shelter to the center as the pieces come off
+			const int whiteKing = toSquare(board.kings<Color::White>());
+			const int blackKing = toSquare(board.kings<Color::Black>());
+			const int middlegame = detail::pieceSquare[(size_t)Piece::WhiteKing][whiteKing] + detail::pieceSquare[(size_t)Piece::BlackKing][blackKing];
+			const int endgame = detail::KingEndgameTable[whiteKing ^ 56] - detail::KingEndgameTable[blackKing];
+			const int phase = detail::phase(board);
+
+			return score + (middlegame * phase + endgame * (detail::MaxPhase - phase)) / detail::MaxPhase;
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \returns The static evaluation in centipawns, from the side to move's point of view.
+		 */
+		template <Color Color>
+		inline constexpr int evaluate(const Game& game) noexcept {
+			const int score = evaluateWhite(game.board());
+			return Color == Color::White ? score : -score;
+		}
+	}
+}
@@ -0,0 +1,218 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "planes.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/**
+ * @file Provides an asynchronous, batching evaluation queue for neural network guided search.
+ *
+ * Search threads submit positions and wait for their request, while a single worker
+ * collects requests into batches and runs them through the inference backend. Dense
+ * layers are far better utilized on a batch than on single positions.
+ *
+ * Waiting threads park on a completion counter owned by the broker, not on the request:
+ * a request may be destroyed as soon as it is ready, so the worker never touches it after
+ * marking it ready.
+ */
+namespace chess {
+	namespace nn {
+		/**
+		 * An inference backend evaluates a batch of input planes at once. The output type
+		 * is up to the backend (for instance, a value and a policy vector).
+		 */
+		template <typename Backend>
+		concept isInferenceBackend = requires(Backend& backend, std::span<const InputPlanes> inputs,
+		                                      std::span<typename Backend::Output> outputs) {
+			backend.evaluate(inputs, outputs);
+		};
+
+		template <typename Backend>
+			requires isInferenceBackend<Backend>
+		class EvalBroker {
+		public:
+			using Output = typename Backend::Output;
+
+			/**
+			 * A pending evaluation. It is owned by the submitting thread (usually on its stack),
+			 * so submitting does not allocate. It must stay alive until it is ready.
+			 */
+			class Request {
+				friend EvalBroker;
+
+				InputPlanes m_input;
+				Output m_output;
+				std::atomic<bool> m_ready{ false };
+				EvalBroker* m_broker = nullptr;
+				std::chrono::steady_clock::time_point m_submitted;
+
+			public:
+				inline bool ready() const noexcept {
+					return m_ready.load(std::memory_order_acquire);
+				}
+
+				/**
+				 * Waits until the evaluation is done. This spins briefly before parking the thread.
+				 */
+				inline void wait() const noexcept {
+					for (int spin = 0; spin < 1024; ++spin)
+						if (ready())
+							return;
+
+					m_broker->awaitCompletion(*this);
+				}
+
+				inline const Output& get() const noexcept {
+					wait();
+					return m_output;
+				}
+			};
+
+		private:
+			Backend& m_backend;
+			const size_t m_batchSize;
+			const std::chrono::microseconds m_maxLatency;
+
+			std::mutex m_mutex;
+			std::condition_variable m_cv;
+			std::vector<Request*> m_queue;
+			bool m_stop = false;
+
+			// Bumped after every batch; waiting threads park on it
+			std::atomic<uint32_t> m_completions{ 0 };
+			std::atomic<unsigned> m_parked{ 0 };
+
+			std::atomic<uint64_t> m_batches{ 0 };
+			std::atomic<uint64_t> m_evaluations{ 0 };
+
+			std::thread m_worker;
+
+			inline void awaitCompletion(const Request& request) noexcept {
+				m_parked.fetch_add(1, std::memory_order_seq_cst);
+
+				// The counter is read before the request, so a batch completing in between changes it
+				for (uint32_t seen = m_completions.load(std::memory_order_seq_cst); !request.ready(); seen = m_completions.load(std::memory_order_seq_cst))
+					m_completions.wait(seen, std::memory_order_seq_cst);
+
+				m_parked.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			inline void work() {
+				std::vector<Request*> batch;
+				std::vector<InputPlanes> inputs;
+				std::vector<Output> outputs;
+
+				std::unique_lock lock(m_mutex);
+				while (true) {
+					m_cv.wait(lock, [&]() { return m_stop || !m_queue.empty(); });
+					if (m_queue.empty())
+						return;
+
+					// Wait for a full batch, but no longer than the latency budget of the oldest request
+					m_cv.wait_until(lock, m_queue.front()->m_submitted + m_maxLatency, [&]() {
+						return m_stop || m_queue.size() >= m_batchSize;
+					});
+
+					const size_t count = std::min(m_queue.size(), m_batchSize);
+					batch.assign(m_queue.begin(), m_queue.begin() + count);
+					m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+					lock.unlock();
+
+					inputs.resize(count);
+					outputs.resize(count);
+					for (size_t i = 0; i < count; ++i)
+						inputs[i] = batch[i]->m_input;
+
+					m_backend.evaluate(std::span<const InputPlanes>(inputs), std::span<Output>(outputs));
+
+					// A ready request can be gone at once, so it is not touched after its store
+					for (size_t i = 0; i < count; ++i) {
+						batch[i]->m_output = std::move(outputs[i]);
+						batch[i]->m_ready.store(true, std::memory_order_release);
+					}
+
+					m_completions.fetch_add(1, std::memory_order_seq_cst);
+					if (m_parked.load(std::memory_order_seq_cst))
+						m_completions.notify_all();
+
+					m_batches.fetch_add(1, std::memory_order_relaxed);
+					m_evaluations.fetch_add(count, std::memory_order_relaxed);
+
+					lock.lock();
+				}
+			}
+
+		public:
+			/**
+			 * \param backend The inference backend. It is only ever called from the worker thread.
+			 * \param batchSize The number of requests to collect before running a batch.
+			 * \param maxLatency The longest time a request may wait for its batch to fill up.
+			 */
+			EvalBroker(Backend& backend, const size_t batchSize = 32,
+			           const std::chrono::microseconds maxLatency = std::chrono::microseconds(500)) :
+				m_backend{backend}, m_batchSize{std::max<size_t>(batchSize, 1)}, m_maxLatency{maxLatency}
+			{
+				m_queue.reserve(m_batchSize * 4);
+				m_worker = std::thread([this]() { work(); });
+			}
+
+			EvalBroker(const EvalBroker&) = delete;
+			EvalBroker& operator=(const EvalBroker&) = delete;
+
+			/**
+			 * Stops the worker after all pending requests are evaluated.
+			 */
+			~EvalBroker() {
+				{
+					std::lock_guard lock(m_mutex);
+					m_stop = true;
+				}
+				m_cv.notify_one();
+				m_worker.join();
+			}
+
+			/**
+			 * Queues a request for evaluation. Call `request.wait()` or `request.get()` to park on it.
+			 */
+			inline void submit(Request& request, const InputPlanes& input) {
+				request.m_input = input;
+				request.m_ready.store(false, std::memory_order_relaxed);
+				request.m_broker = this;
+
+				bool notify;
+				{
+					std::lock_guard lock(m_mutex);
+					request.m_submitted = std::chrono::steady_clock::now();
+					m_queue.push_back(&request);
+
+					// Wake the worker to start the latency timer, or because the batch is full
+					notify = m_queue.size() == 1 || m_queue.size() == m_batchSize;
+				}
+
+				if (notify)
+					m_cv.notify_one();
+			}
+
+			/**
+			 * Evaluates the current position of a game, blocking until the result is ready.
+			 */
+			template <Color Color>
+			inline Output evaluate(const Game& game) {
+				Request request;
+				submit(request, makeInputPlanes<Color>(game));
+				request.wait();
+				return std::move(request.m_output);
+			}
+
+			inline uint64_t batches() const noexcept { return m_batches.load(std::memory_order_relaxed); }
+			inline uint64_t evaluations() const noexcept { return m_evaluations.load(std::memory_order_relaxed); }
+		};
+	}
+}
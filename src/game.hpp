@@ -6,6 +6,10 @@
 #include "move.hpp"
 #include "lookup.hpp"
 #include "zobrist.hpp"
+#include <algorithm>
+#ifdef CHESS_REPETITION_TABLE
+#	include "repetition.hpp"
+#endif
 
 namespace chess {
 	struct UndoInfo {
@@ -32,6 +36,11 @@ namespace chess {
 		int m_enPassantSquare;				/* en-passant square, -1 if none */
 		int m_halfMoveCounter;				/* half-move counter */
 		int m_ply;							/* number of ply */
+		int m_startPly;						/* ply of the position the game was set up from */
+
+#ifdef CHESS_REPETITION_TABLE
+		RepetitionTable m_repetitions;		/* occurrences of the positions in the history */
+#endif
 
 	private:
 		/**
@@ -56,7 +65,14 @@ namespace chess {
 			
 			m_hash ^= zobrist::castlingTable[(size_t)m_castlingRights];
 
+			// The history starts here; the plies before it were never played in this game
+			m_startPly = m_ply;
 			m_history[m_ply] = m_hash;
+
+#ifdef CHESS_REPETITION_TABLE
+			m_repetitions.clear();
+			m_repetitions.add(m_hash);
+#endif
 		}
 	
 	public:
@@ -69,11 +85,34 @@ namespace chess {
 		// FEN must be valid.
 		explicit constexpr Game(const std::string_view fen) {
 			lookup::init();
-			zobrist::init();
 
 			init(fen);
 		}
 
+		/**
+		 * Sets this game to the position of another, with the part of the history that repetitions
+		 * can still refer to. Games are not copyable, since a whole copy moves the 512-entry history.
+		 */
+		inline constexpr void copyFrom(const Game& other) noexcept {
+			m_board = other.m_board;
+			m_turn = other.m_turn;
+			m_hash = other.m_hash;
+			m_castlingRights = other.m_castlingRights;
+			m_enPassantSquare = other.m_enPassantSquare;
+			m_halfMoveCounter = other.m_halfMoveCounter;
+			m_ply = other.m_ply;
+			m_startPly = other.m_startPly;
+
+			const int first = std::max(m_startPly, m_ply - m_halfMoveCounter);
+			std::copy(other.m_history + first, other.m_history + m_ply + 1, m_history + first);
+
+#ifdef CHESS_REPETITION_TABLE
+			m_repetitions = other.m_repetitions;
+#endif
+
+			CHESS_TRACE_EVENT(Position, *this, 0);
+		}
+
 		// Initialize the Game with a given FEN. By default, this is the default position.
 		inline constexpr void init(const std::string_view fen = QuickFEN::start) {
 			// Initialize default
@@ -163,6 +202,98 @@ namespace chess {
 
 			// Set up incremental state
 			setupIncrementalState();
+			CHESS_TRACE_EVENT(Position, *this, 0);
+		}
+
+		// Initialize the Game with a given board and state. They must make up a valid position.
+		inline constexpr void init(const Board& board, const Color turn, const CastlingFlags castlingRights, const int enPassantSquare,
+		                           const int halfMoveCounter = 0, const int fullMoveCount = 1) noexcept {
+			m_board = board;
+			m_turn = turn;
+			m_castlingRights = castlingRights;
+			m_enPassantSquare = enPassantSquare;
+			m_halfMoveCounter = halfMoveCounter;
+			m_ply = fullMoveCount * 2 + static_cast<int>(turn);
+
+			setupIncrementalState();
+			CHESS_TRACE_EVENT(Position, *this, 0);
+		}
+
+		/**
+		 * Reads the ply that `init` would set from a FEN string, without setting anything up.
+		 * `init` writes the history at that ply, so FEN strings from input are checked with this
+		 * against the 512-position history first.
+		 *
+		 * \returns The ply, or -1 if the string is not laid out the way `init` reads it: eight ranks
+		 *          of eight squares with one king of each color, the side to move, the castling
+		 *          rights, "-" or an en-passant square, and both clocks. The position itself is not
+		 *          checked for legality.
+		 */
+		static inline constexpr int fenPly(const std::string_view fen) noexcept {
+			size_t i = 0;
+			int whiteKings = 0, blackKings = 0;
+
+			// 1. Piece placement
+			for (int row = 7, col = 0;; ++i) {
+				if (i == fen.size())
+					return -1;
+
+				const char chr = fen[i];
+				if (chr == ' ') {
+					if (row != 0 || col != 8)
+						return -1;
+					break;
+				}
+
+				if (chr == '/') {
+					if (row == 0 || col != 8)
+						return -1;
+					col = 0;
+					--row;
+				} else if (chr >= '1' && chr <= '8') {
+					col += chr - '0';
+					if (col > 8)
+						return -1;
+				} else {
+					if (col == 8 || std::string_view("PNBRQKpnbrqk").find(chr) == std::string_view::npos)
+						return -1;
+					whiteKings += chr == 'K';
+					blackKings += chr == 'k';
+					++col;
+				}
+			}
+
+			if (whiteKings != 1 || blackKings != 1)
+				return -1;
+
+			// The other five fields, each followed by exactly one space but the last
+			std::string_view fields[5];
+			for (std::string_view& field : fields) {
+				if (i == fen.size())
+					return -1;
+
+				const size_t start = ++i;
+				i = std::min(fen.find(' ', start), fen.size());
+				if (i == start)
+					return -1;
+				field = fen.substr(start, i - start);
+			}
+
+			const auto isNumber = [](const std::string_view field) {
+				return field.size() <= 9 && field.find_first_not_of("0123456789") == std::string_view::npos;
+			};
+
+			// 2. to 6.
+			if ((fields[0] != "w" && fields[0] != "b") ||
+			    (fields[2] != "-" && (fields[2].size() != 2 || fields[2][0] < 'a' || fields[2][0] > 'h' || fields[2][1] < '1' || fields[2][1] > '8')) ||
+			    !isNumber(fields[3]) || !isNumber(fields[4]))
+				return -1;
+
+			int fullMoveCount = 0;
+			for (const char chr : fields[4])
+				fullMoveCount = fullMoveCount * 10 + (chr - '0');
+
+			return fullMoveCount * 2 + (fields[0] == "b");
 		}
 
 		inline constexpr Color turn() const noexcept { return m_turn; }
@@ -172,7 +303,10 @@ namespace chess {
 		inline constexpr int halfMoveCounter() const noexcept { return m_halfMoveCounter; }
 		inline constexpr int fullMoveCount() const noexcept { return m_ply >> 1; }
 		inline constexpr int ply() const noexcept { return m_ply; }
-		inline constexpr zobrist::Key zobristHash() const noexcept { return m_history[ply()]; }
+		inline constexpr zobrist::Key zobristHash() const noexcept {
+			CHESS_TRACE_EVENT(Hash, *this, 0);
+			return m_history[ply()];
+		}
 
 		/**
 		 * Has the game ended in 50-move rule?
@@ -183,23 +317,43 @@ namespace chess {
 			return halfMoveCounter() > 99;
 		}
 
+		/**
+		 * \returns How many times the current position occurred before in the game.
+		 *
+		 * With CHESS_REPETITION_TABLE defined, this is a constant-time table lookup. Otherwise, the
+		 * history is scanned back to the last capture or pawn move, or to the position the game was
+		 * set up from.
+		 */
+		inline constexpr int repetitions() const noexcept {
+#ifdef CHESS_REPETITION_TABLE
+			// Positions from before a capture or pawn move cannot recur, so the table needs no clearing on those
+			return m_repetitions.count(m_hash) - 1;
+#else
+			// The half-move clock of a FEN counts moves from before the history starts
+			const int lastCandidate = std::max(m_startPly, m_ply - halfMoveCounter());
+
+			int times = 0;
+			for (int i = m_ply - 4; i >= lastCandidate; i -= 2)
+				times += m_history[i] == m_hash;
+
+			return times;
+#endif
+		}
+
+		/**
+		 * Has the current position occurred before? Searches usually score this as a draw.
+		 */
+		inline constexpr bool isRepetition() const noexcept {
+			return repetitions() > 0;
+		}
+
 		/**
 		 * Has the game just ended in threefold repetition?
 		 * 
 		 * \warning This must be called right after the threefold repetition move was played!
 		 */
 		inline constexpr bool drawThreefoldRepetition() const noexcept {
-			if (m_ply < 8)
-				return false;
-			
-			const auto lastHash = zobristHash();
-			const int lastCandidate = m_ply - halfMoveCounter();
-
-			int times = 0;
-			for (int i = m_ply; i >= lastCandidate; i -= 2)
-				times += m_history[i] == lastHash;
-
-			return times >= 3;
+			return repetitions() >= 2;
 		}
 
 		/**
@@ -207,18 +361,30 @@ namespace chess {
 		 */
 		template <Color Color>
 		inline constexpr UndoInfo make(const Move move) noexcept {
+			return make<Color>(m_board.widen<Color>(move));
+		}
+
+		/**
+		 * Makes a move without checking for anything. The moving and captured pieces come from the
+		 * move instead of the mailbox.
+		 */
+		template <Color Color>
+		inline constexpr UndoInfo make(const WideMove wideMove) noexcept {
 			CHESS_PROFILE;
+			CHESS_METRIC_SCOPE(Make);
+			CHESS_TRACE_EVENT(Make, *this, wideMove.move().data());
 			
 			CHESS_ASSERT(m_turn == Color);
 
+			const Move move = wideMove.move();
 			const int from = move.getFrom();
 			const int to = move.getTo();
-			const Piece pieceFrom = m_board.pieceAt(from);
-			const Piece pieceTo = m_board.pieceAt(to);
+			const Piece pieceFrom = wideMove.movedPiece();
+			const Piece captured = wideMove.capturedPiece();
 
 			const UndoInfo undoInfo = {
 				m_halfMoveCounter,
-				move.capturedPiece<Color>(pieceTo),
+				captured,
 				m_castlingRights,
 				static_cast<uint8_t>(m_enPassantSquare)
 			};
@@ -265,7 +431,7 @@ namespace chess {
 				else if (from == queensideCastleRookFromSquare<Color>()) m_castlingRights &= ~queensideCastleFlag<Color>();
 			}
 
-			if (pieceTo == makePiece(PieceType::Rook, ~Color)) { // for en-passant, pieceTo will just be Piece::None, no worries :)
+			if (captured == makePiece(PieceType::Rook, ~Color)) { // for en-passant, this is a pawn, no worries :)
 				if (to == kingsideCastleRookFromSquare<~Color>()) m_castlingRights &= ~kingsideCastleFlag<~Color>();
 				else if (to == queensideCastleRookFromSquare<~Color>()) m_castlingRights &= ~queensideCastleFlag<~Color>();
 			}
@@ -275,8 +441,8 @@ namespace chess {
 			// Capture
 			if (move.isCapture()) {
 				const int captureDestSquare = move.captureDestinationSquare<Color>();
-				m_hash ^= zobrist::pieceSquareTable[(size_t)m_board.pieceAt(captureDestSquare)][captureDestSquare];
-				m_board.removePiece(captureDestSquare);
+				m_hash ^= zobrist::pieceSquareTable[(size_t)captured][captureDestSquare];
+				m_board.removePiece(captured, captureDestSquare);
 			}
 			
 			// Move the piece from the "from" to "to" square, promoted-to piece if promotion
@@ -286,13 +452,13 @@ namespace chess {
 				m_hash ^= zobrist::pieceSquareTable[(size_t)pieceFrom][from];
 				m_hash ^= zobrist::pieceSquareTable[(size_t)promoPiece][to];
 
-				m_board.removePiece(from);
+				m_board.removePiece(pieceFrom, from);
 				m_board.putPiece(promoPiece, to);
 			} else {
 				m_hash ^= zobrist::pieceSquareTable[(size_t)pieceFrom][from];
 				m_hash ^= zobrist::pieceSquareTable[(size_t)pieceFrom][to];
 
-				m_board.movePiece(from, to);
+				m_board.movePiece(pieceFrom, from, to);
 			}
 
 			// Castling
@@ -304,7 +470,7 @@ namespace chess {
 				m_hash ^= zobrist::pieceSquareTable[(size_t)rook][rookFromSquare];
 				m_hash ^= zobrist::pieceSquareTable[(size_t)rook][rookToSquare];
 
-				m_board.movePiece(rookFromSquare, rookToSquare);
+				m_board.movePiece(rook, rookFromSquare, rookToSquare);
 			} else if (move.isQueensideCastle()) {
 				constexpr int rookFromSquare = queensideCastleRookFromSquare<Color>();
 				constexpr int rookToSquare = queensideCastleRookToSquare<Color>();
@@ -313,11 +479,14 @@ namespace chess {
 				m_hash ^= zobrist::pieceSquareTable[(size_t)rook][rookFromSquare];
 				m_hash ^= zobrist::pieceSquareTable[(size_t)rook][rookToSquare];
 
-				m_board.movePiece(rookFromSquare, rookToSquare);
+				m_board.movePiece(rook, rookFromSquare, rookToSquare);
 			}
 			
 			// Store hash in threefold repetition table
 			m_history[m_ply] = m_hash;
+#ifdef CHESS_REPETITION_TABLE
+			m_repetitions.add(m_hash);
+#endif
 
 			return undoInfo;
 		}
@@ -329,7 +498,20 @@ namespace chess {
 		 */
 		template <Color Color>
 		inline constexpr void unmake(const Move move, const UndoInfo undoInfo) noexcept {
+			const Piece piece = move.isPromotion() ? makePiece(PieceType::Pawn, Color) : m_board.pieceAt(move.getTo());
+			unmake<Color>(WideMove{ move, piece, undoInfo.capturedPiece }, undoInfo);
+		}
+
+		/**
+		 * Unmakes a move without checking for anything. The moving and captured pieces come from the
+		 * move instead of the mailbox.
+		 * 
+		 * The color template parameter should be the COLOR OPPOSITE CURRENT TURN.
+		 */
+		template <Color Color>
+		inline constexpr void unmake(const WideMove wideMove, const UndoInfo undoInfo) noexcept {
 			CHESS_PROFILE;
+			CHESS_TRACE_EVENT(Unmake, *this, wideMove.move().data());
 
 			CHESS_ASSERT(m_turn != Color);
 
@@ -338,18 +520,25 @@ namespace chess {
 			m_enPassantSquare = static_cast<int>(undoInfo.enPassantSquare);
 			m_turn = Color;
 
+#ifdef CHESS_REPETITION_TABLE
+			m_repetitions.remove(m_hash);
+#endif
 			--m_ply;
-			
+
+			// The previous hash is still in the history table
+			m_hash = m_history[m_ply];
+
+			const Move move = wideMove.move();
 			const int from = move.getFrom(), to = move.getTo();
-			const Piece piece = m_board.pieceAt(to), captured = undoInfo.capturedPiece;
+			const Piece piece = wideMove.movedPiece(), captured = wideMove.capturedPiece();
 			
 			// Micro-operation: Remove piece from "to" square and place it on "from" square
 			//                  (if promotion, then just place pawn on "from" square)
 			if (move.isPromotion()) {
-				m_board.removePiece(move.getTo());
-				m_board.putPiece(makePiece(PieceType::Pawn, Color), move.getFrom());
+				m_board.removePiece(move.promotionPiece<Color>(), to);
+				m_board.putPiece(piece, from);
 			} else {
-				m_board.movePiece(move.getTo(), move.getFrom());
+				m_board.movePiece(piece, to, from);
 			}
 
 			// Micro-operation: Put captured piece on "to" square if capture
@@ -358,9 +547,9 @@ namespace chess {
 
 			// Operation: Put rook back where it was if castle
 			else if (move.isKingsideCastle())
-				m_board.movePiece(kingsideCastleRookToSquare<Color>(), kingsideCastleRookFromSquare<Color>());
+				m_board.movePiece(makePiece(PieceType::Rook, Color), kingsideCastleRookToSquare<Color>(), kingsideCastleRookFromSquare<Color>());
 			else if (move.isQueensideCastle())
-				m_board.movePiece(queensideCastleRookToSquare<Color>(), queensideCastleRookFromSquare<Color>());
+				m_board.movePiece(makePiece(PieceType::Rook, Color), queensideCastleRookToSquare<Color>(), queensideCastleRookFromSquare<Color>());
 		}
 
 		/**
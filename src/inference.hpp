@@ -0,0 +1,544 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "planes.hpp"
+#include "movegen.hpp"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @file Provides a self-contained, quantized CPU inference engine for small AlphaZero-style
+ * residual convnets over 8x8 input planes.
+ *
+ * \cond Quantization scheme:
+ *
+ *       Activations are unsigned 7-bit integers (0 to 127) after each ReLU, stored
+ *       channels-last as uint8_t[64][channels]. Convolution weights are signed 8-bit
+ *       integers with a float scale per output channel. Products are accumulated in
+ *       32-bit integers, then dequantized, biased, and requantized to the scale of the
+ *       next layer. Keeping activations at 7 bits means the AVX2 `maddubs` pair sums
+ *       (2 * 127 * 127) never saturate. The value head's fully connected layer uses
+ *       int16 weights, since it is small and sensitive to precision.
+ *
+ *       The kernels are chosen at compile time: AVX-512 VNNI (with VL), then AVX2, then
+ *       a portable scalar fallback. The runtime dispatch of `CHESS_MULTIVERSION` does not
+ *       cover them, so a baseline x86-64 build runs the scalar kernels.
+ *
+ *       A batch is evaluated `BatchLanes` positions at a time: the convolutions load each
+ *       weight vector once and multiply it with the activations of all of those positions,
+ *       so the weights, which outweigh one position's activations, are streamed from the
+ *       cache a quarter as often.
+ *
+ * \cond Network:
+ *
+ *       input       3x3 conv, inputPlanes -> channels, ReLU
+ *       tower       `blocks` residual blocks of two 3x3 convs, channels -> channels
+ *       policy      1x1 conv, channels -> 64; logit of (from, to) is channel `to` at square `from`
+ *       value       1x1 conv, channels -> 1, ReLU, dense 64 -> hidden (int16), ReLU, dense hidden -> 1, tanh
+ *
+ * \cond Weights file, all little-endian:
+ *
+ *       char[4] "CHNN", uint32_t version, uint32_t inputPlanes, uint32_t channels,
+ *       uint32_t blocks, uint32_t valueHidden, then the layers in the order above.
+ *       Each conv is a float output scale, followed by, per output channel, a float
+ *       weight scale, a float bias and int8_t[taps][inputs] weights. The dense layers
+ *       are a float weight scale, int16_t[hidden][64] weights and float[hidden] biases,
+ *       then float[hidden] weights and a float bias.
+ */
+namespace chess {
+	namespace nn {
+		namespace detail {
+			// Channels are padded to a multiple of this, which is one AVX2 register of int8
+			inline constexpr size_t ChannelAlignment = 32;
+
+			inline constexpr size_t padChannels(const size_t channels) noexcept {
+				return (channels + ChannelAlignment - 1) / ChannelAlignment * ChannelAlignment;
+			}
+
+			inline constexpr uint8_t quantizeActivation(const float value, const float scale) noexcept {
+				const float q = value / scale + 0.5f;
+				return q <= 0.0f ? 0 : q >= 127.0f ? 127 : uint8_t(q);
+			}
+
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+			inline constexpr const char* kernelName = "avx512-vnni";
+#elif defined(__AVX2__)
+			inline constexpr const char* kernelName = "avx2";
+#else
+			inline constexpr const char* kernelName = "scalar";
+#endif
+
+#if defined(__AVX2__)
+			inline int32_t horizontalSum(const __m256i vector) noexcept {
+				__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(vector), _mm256_extracti128_si256(vector, 1));
+				sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+				sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+				return _mm_cvtsi128_si32(sum);
+			}
+#endif
+
+			/**
+			 * Accumulates the dot products of the unsigned 7-bit activations of `Lanes` positions
+			 * with the same signed 8-bit weights, loading each weight vector once for all of them.
+			 * `count` must be a multiple of `ChannelAlignment`.
+			 */
+			template <size_t Lanes>
+			struct DotAccumulator {
+#if defined(__AVX2__)
+				__m256i sums[Lanes];
+
+				CHESS_ALWAYS_INLINE inline DotAccumulator() noexcept {
+					for (size_t lane = 0; lane < Lanes; ++lane)
+						sums[lane] = _mm256_setzero_si256();
+				}
+
+				/**
+				 * \param activations The activations of each lane, read from `offset` on.
+				 */
+				CHESS_ALWAYS_INLINE inline void add(const uint8_t* const* activations, const size_t offset, const int8_t* weights,
+				                                    const size_t count) noexcept {
+					for (size_t i = 0; i < count; i += ChannelAlignment) {
+						const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+
+						for (size_t lane = 0; lane < Lanes; ++lane) {
+							const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(activations[lane] + offset + i));
+#	if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+							sums[lane] = _mm256_dpbusd_epi32(sums[lane], a, w);
+#	else
+							sums[lane] = _mm256_add_epi32(sums[lane], _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), _mm256_set1_epi16(1)));
+#	endif
+						}
+					}
+				}
+
+				CHESS_ALWAYS_INLINE inline int32_t result(const size_t lane) const noexcept {
+					return horizontalSum(sums[lane]);
+				}
+#else
+				int32_t sums[Lanes] = { };
+
+				CHESS_ALWAYS_INLINE inline void add(const uint8_t* const* activations, const size_t offset, const int8_t* weights,
+				                                    const size_t count) noexcept {
+					// One lane at a time, which the compiler vectorizes
+					for (size_t lane = 0; lane < Lanes; ++lane)
+						for (size_t i = 0; i < count; ++i)
+							sums[lane] += int32_t(activations[lane][offset + i]) * int32_t(weights[i]);
+				}
+
+				CHESS_ALWAYS_INLINE inline int32_t result(const size_t lane) const noexcept {
+					return sums[lane];
+				}
+#endif
+			};
+
+			/**
+			 * \returns The dot product of 64 int16 inputs and 64 int16 weights.
+			 */
+			inline int32_t dot64(const int16_t* inputs, const int16_t* weights) noexcept {
+#if defined(__AVX2__)
+				__m256i sum = _mm256_setzero_si256();
+				for (size_t i = 0; i < 64; i += 16) {
+					const __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(inputs + i));
+					const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+					sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, w));
+				}
+				return horizontalSum(sum);
+#else
+				int32_t sum = 0;
+				for (size_t i = 0; i < 64; ++i)
+					sum += int32_t(inputs[i]) * int32_t(weights[i]);
+				return sum;
+#endif
+			}
+
+			/**
+			 * A minimal aligned buffer. std::vector does not guarantee the alignment the kernels need.
+			 */
+			template <typename T>
+			class AlignedBuffer {
+				T* m_data = nullptr;
+				size_t m_size = 0;
+
+			public:
+				AlignedBuffer() = default;
+				explicit AlignedBuffer(const size_t size) :
+					m_data{static_cast<T*>(::operator new[](size * sizeof(T), std::align_val_t(64)))}, m_size{size}
+				{
+					std::memset(m_data, 0, size * sizeof(T));
+				}
+
+				AlignedBuffer(AlignedBuffer&& other) noexcept : m_data{other.m_data}, m_size{other.m_size} {
+					other.m_data = nullptr;
+					other.m_size = 0;
+				}
+
+				AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+					std::swap(m_data, other.m_data);
+					std::swap(m_size, other.m_size);
+					return *this;
+				}
+
+				~AlignedBuffer() {
+					if (m_data)
+						::operator delete[](m_data, std::align_val_t(64));
+				}
+
+				inline T* data() noexcept { return m_data; }
+				inline const T* data() const noexcept { return m_data; }
+				inline size_t size() const noexcept { return m_size; }
+				inline T& operator[](const size_t index) noexcept { return m_data[index]; }
+				inline const T& operator[](const size_t index) const noexcept { return m_data[index]; }
+			};
+
+			class Loader {
+				std::ifstream m_file;
+
+			public:
+				explicit Loader(const std::string& path) : m_file(path, std::ios::binary) { }
+
+				template <typename T>
+				inline bool read(T* out, const size_t count = 1) {
+					m_file.read(reinterpret_cast<char*>(out), count * sizeof(T));
+					return bool(m_file);
+				}
+			};
+		}
+
+		/**
+		 * A quantized convolution over the 8x8 board, with either a 3x3 or a 1x1 kernel.
+		 */
+		class ConvLayer {
+			size_t m_inputs = 0, m_inputsPadded = 0, m_outputs = 0, m_taps = 0;
+			detail::AlignedBuffer<int8_t> m_weights;	/* [outputs][taps][inputsPadded] */
+			std::vector<float> m_scales;				/* weight scale times input scale */
+			std::vector<float> m_biases;
+			float m_outputScale = 1.0f;
+
+		public:
+			inline size_t outputs() const noexcept { return m_outputs; }
+			inline float outputScale() const noexcept { return m_outputScale; }
+
+			inline bool load(detail::Loader& loader, const size_t inputs, const size_t outputs, const size_t taps, const float inputScale) {
+				m_inputs = inputs;
+				m_inputsPadded = detail::padChannels(inputs);
+				m_outputs = outputs;
+				m_taps = taps;
+				m_weights = detail::AlignedBuffer<int8_t>(outputs * taps * m_inputsPadded);
+				m_scales.resize(outputs);
+				m_biases.resize(outputs);
+
+				if (!loader.read(&m_outputScale))
+					return false;
+
+				for (size_t o = 0; o < outputs; ++o) {
+					if (!loader.read(&m_scales[o]) || !loader.read(&m_biases[o]))
+						return false;
+
+					m_scales[o] *= inputScale;
+
+					for (size_t tap = 0; tap < taps; ++tap)
+						if (!loader.read(m_weights.data() + (o * taps + tap) * m_inputsPadded, inputs))
+							return false;
+				}
+
+				return true;
+			}
+
+			/**
+			 * \param inputs The activations of `Lanes` positions, uint8_t[64][inputsPadded] each.
+			 * \param outputs Their dequantized pre-activation outputs, float[64][outputs] each.
+			 */
+			template <size_t Lanes>
+			inline void forward(const uint8_t* const* inputs, float* const* outputs) const noexcept {
+				for (int square = 0; square < 64; ++square) {
+					const int rank = rankOf(square), file = fileOf(square);
+
+					for (size_t o = 0; o < m_outputs; ++o) {
+						const int8_t* weights = m_weights.data() + o * m_taps * m_inputsPadded;
+						detail::DotAccumulator<Lanes> accumulator;
+
+						if (m_taps == 1) {
+							accumulator.add(inputs, square * m_inputsPadded, weights, m_inputsPadded);
+						} else {
+							for (int dr = -1; dr <= 1; ++dr) {
+								for (int df = -1; df <= 1; ++df, weights += m_inputsPadded) {
+									// Zero padding outside the board
+									if (rank + dr < 0 || rank + dr > 7 || file + df < 0 || file + df > 7)
+										continue;
+
+									accumulator.add(inputs, (square + dr * 8 + df) * m_inputsPadded, weights, m_inputsPadded);
+								}
+							}
+						}
+
+						for (size_t lane = 0; lane < Lanes; ++lane)
+							outputs[lane][square * m_outputs + o] = float(accumulator.result(lane)) * m_scales[o] + m_biases[o];
+					}
+				}
+			}
+		};
+
+		/**
+		 * A quantized policy/value residual network. This works as an `EvalBroker` backend.
+		 */
+		class Network {
+		public:
+			static constexpr uint32_t Version = 1;
+
+			// The positions of a batch evaluated together
+			static constexpr size_t BatchLanes = 4;
+
+			struct Output {
+				float value;								/* from the side to move's perspective, in [-1, 1] */
+				std::array<float, PolicySize> policy;		/* logits, see `policyIndex` */
+			};
+
+		private:
+			size_t m_inputPlanes = 0, m_channels = 0, m_blocks = 0, m_valueHidden = 0;
+
+			ConvLayer m_input;
+			std::vector<ConvLayer> m_tower;				/* two per block */
+			ConvLayer m_policy;
+			ConvLayer m_value;
+
+			detail::AlignedBuffer<int16_t> m_valueWeights;	/* [valueHidden][64] */
+			float m_valueScale = 1.0f;
+			std::vector<float> m_valueBiases;
+			std::vector<float> m_valueOutputWeights;
+			float m_valueOutputBias = 0.0f;
+
+		public:
+			/**
+			 * \returns True if the weights file was loaded, false if it is missing or malformed.
+			 */
+			inline bool load(const std::string& path) {
+				detail::Loader loader(path);
+
+				char magic[4];
+				uint32_t version, inputPlanes, channels, blocks, valueHidden;
+				if (!loader.read(magic, 4) || std::memcmp(magic, "CHNN", 4) != 0 ||
+				    !loader.read(&version) || version != Version ||
+				    !loader.read(&inputPlanes) || !loader.read(&channels) || !loader.read(&blocks) || !loader.read(&valueHidden) ||
+				    inputPlanes != InputPlanes::Count || channels == 0)
+					return false;
+
+				m_inputPlanes = inputPlanes;
+				m_channels = channels;
+				m_blocks = blocks;
+				m_valueHidden = valueHidden;
+
+				// Input planes are binary, so their scale is one
+				if (!m_input.load(loader, inputPlanes, channels, 9, 1.0f))
+					return false;
+
+				m_tower.resize(blocks * 2);
+				float scale = m_input.outputScale();
+				for (ConvLayer& layer : m_tower) {
+					if (!layer.load(loader, channels, channels, 9, scale))
+						return false;
+
+					scale = layer.outputScale();
+				}
+
+				if (!m_policy.load(loader, channels, 64, 1, scale) || !m_value.load(loader, channels, 1, 1, scale))
+					return false;
+
+				m_valueWeights = detail::AlignedBuffer<int16_t>(valueHidden * 64);
+				m_valueBiases.resize(valueHidden);
+				m_valueOutputWeights.resize(valueHidden);
+
+				if (!loader.read(&m_valueScale) || !loader.read(m_valueWeights.data(), valueHidden * 64) ||
+				    !loader.read(m_valueBiases.data(), valueHidden) || !loader.read(m_valueOutputWeights.data(), valueHidden) ||
+				    !loader.read(&m_valueOutputBias))
+					return false;
+
+				m_valueScale *= m_value.outputScale();
+				return true;
+			}
+
+			inline size_t channels() const noexcept { return m_channels; }
+			inline size_t blocks() const noexcept { return m_blocks; }
+
+			/**
+			 * \returns The name of the kernels compiled in, for instance, "avx2".
+			 */
+			static constexpr const char* kernel() noexcept { return detail::kernelName; }
+
+			/**
+			 * Scratch buffers for a forward pass, so that evaluating does not allocate. A workspace
+			 * must not be shared between threads.
+			 */
+			class Workspace {
+				friend Network;
+
+				size_t lanes, activationSize, valueSize;
+				detail::AlignedBuffer<uint8_t> activations, hidden;		/* per lane */
+				std::vector<float> preActivations, residual;			/* per lane */
+
+			public:
+				/**
+				 * \param lanes The positions evaluated together, 1 or `BatchLanes`.
+				 */
+				explicit Workspace(const Network& network, const size_t lanes = 1) :
+					lanes{ lanes },
+					activationSize{ 64 * detail::padChannels(network.m_channels) },
+					valueSize{ 64 * network.m_channels },
+					activations(lanes * activationSize),
+					hidden(lanes * activationSize),
+					preActivations(lanes * valueSize),
+					residual(lanes * valueSize)
+				{ }
+			};
+
+		private:
+			template <size_t Lanes>
+			inline void evaluateLanes(const InputPlanes* inputs, Output* outputs, Workspace& workspace) const noexcept {
+				CHESS_ASSERT(workspace.lanes >= Lanes);
+				const size_t padded = detail::padChannels(m_channels);
+				const size_t inputPadded = detail::padChannels(m_inputPlanes);
+
+				alignas(64) uint8_t inputActivations[Lanes][64 * detail::ChannelAlignment] = { };
+				const uint8_t* input[Lanes];
+				uint8_t* activations[Lanes];
+				uint8_t* hidden[Lanes];
+				float* preActivations[Lanes];
+				float* residual[Lanes];
+
+				for (size_t lane = 0; lane < Lanes; ++lane) {
+					for (size_t plane = 0; plane < m_inputPlanes; ++plane)
+						for (int square = 0; square < 64; ++square)
+							inputActivations[lane][square * inputPadded + plane] = uint8_t((inputs[lane].planes[plane] >> square) & 1);
+
+					input[lane] = inputActivations[lane];
+					activations[lane] = workspace.activations.data() + lane * workspace.activationSize;
+					hidden[lane] = workspace.hidden.data() + lane * workspace.activationSize;
+					preActivations[lane] = workspace.preActivations.data() + lane * workspace.valueSize;
+					residual[lane] = workspace.residual.data() + lane * workspace.valueSize;
+				}
+
+				// Quantizes (with ReLU) into activation buffers, and optionally keeps the float values
+				const auto requantize = [&](uint8_t* const* out, const float scale, float* const* keep) {
+					for (size_t lane = 0; lane < Lanes; ++lane) {
+						for (int square = 0; square < 64; ++square) {
+							for (size_t c = 0; c < m_channels; ++c) {
+								const float value = std::max(preActivations[lane][square * m_channels + c], 0.0f);
+								out[lane][square * padded + c] = detail::quantizeActivation(value, scale);
+								if (keep)
+									keep[lane][square * m_channels + c] = value;
+							}
+						}
+					}
+				};
+
+				m_input.forward<Lanes>(input, preActivations);
+				requantize(activations, m_input.outputScale(), residual);
+
+				for (size_t block = 0; block < m_blocks; ++block) {
+					const ConvLayer& first = m_tower[block * 2];
+					const ConvLayer& second = m_tower[block * 2 + 1];
+
+					first.forward<Lanes>(activations, preActivations);
+					requantize(hidden, first.outputScale(), nullptr);
+
+					second.forward<Lanes>(hidden, preActivations);
+					for (size_t lane = 0; lane < Lanes; ++lane)
+						for (size_t i = 0; i < 64 * m_channels; ++i)
+							preActivations[lane][i] += residual[lane][i];
+					requantize(activations, second.outputScale(), residual);
+				}
+
+				// Policy head
+				float* policies[Lanes];
+				for (size_t lane = 0; lane < Lanes; ++lane)
+					policies[lane] = outputs[lane].policy.data();
+				m_policy.forward<Lanes>(activations, policies);
+
+				// Value head
+				float valuePlanes[Lanes][64];
+				float* valuePlane[Lanes];
+				for (size_t lane = 0; lane < Lanes; ++lane)
+					valuePlane[lane] = valuePlanes[lane];
+				m_value.forward<Lanes>(activations, valuePlane);
+
+				for (size_t lane = 0; lane < Lanes; ++lane) {
+					alignas(64) int16_t valueInputs[64];
+					for (int square = 0; square < 64; ++square)
+						valueInputs[square] = detail::quantizeActivation(std::max(valuePlanes[lane][square], 0.0f), m_value.outputScale());
+
+					float value = m_valueOutputBias;
+					for (size_t h = 0; h < m_valueHidden; ++h) {
+						const float x = float(detail::dot64(valueInputs, m_valueWeights.data() + h * 64)) * m_valueScale + m_valueBiases[h];
+						value += std::max(x, 0.0f) * m_valueOutputWeights[h];
+					}
+
+					outputs[lane].value = std::tanh(value);
+				}
+			}
+
+		public:
+			/**
+			 * Evaluates a single position.
+			 */
+			inline void evaluate(const InputPlanes& input, Output& output, Workspace& workspace) const noexcept {
+				evaluateLanes<1>(&input, &output, workspace);
+			}
+
+			/**
+			 * Evaluates a batch of positions, `BatchLanes` at a time, with a workspace of
+			 * `BatchLanes` lanes. The outputs are the same as those of single evaluations.
+			 */
+			inline void evaluate(std::span<const InputPlanes> inputs, std::span<Output> outputs, Workspace& workspace) const noexcept {
+				size_t i = 0;
+				for (; i + BatchLanes <= inputs.size(); i += BatchLanes)
+					evaluateLanes<BatchLanes>(inputs.data() + i, outputs.data() + i, workspace);
+
+				for (; i < inputs.size(); ++i)
+					evaluateLanes<1>(inputs.data() + i, outputs.data() + i, workspace);
+			}
+
+			/**
+			 * Evaluates a batch of positions. This is the `EvalBroker` backend interface.
+			 */
+			inline void evaluate(std::span<const InputPlanes> inputs, std::span<Output> outputs) const {
+				Workspace workspace(*this, BatchLanes);
+				evaluate(inputs, outputs, workspace);
+			}
+		};
+
+		/**
+		 * \tparam Color The current turn.
+		 * \param game The position the logits were computed for.
+		 * \param logits The policy logits, see `policyIndex`.
+		 * \param moves Filled with the legal moves, in `legalMoves` order.
+		 * \param probabilities Filled with the probability of each legal move, at least `moves.size()` floats.
+		 *
+		 * Computes a softmax of the policy restricted to the legal moves.
+		 */
+		template <Color Color>
+		inline void legalPolicy(const Game& game, const float* logits, MoveList& moves, float* probabilities) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			moves.clear();
+			movegen::legalMoves<Color>(game, moves);
+
+			float maximum = -INFINITY;
+			for (size_t i = 0; i < moves.size(); ++i) {
+				probabilities[i] = logits[policyIndex<Color>(moves[i])];
+				maximum = std::max(maximum, probabilities[i]);
+			}
+
+			float sum = 0.0f;
+			for (size_t i = 0; i < moves.size(); ++i)
+				sum += probabilities[i] = std::exp(probabilities[i] - maximum);
+
+			for (size_t i = 0; i < moves.size(); ++i)
+				probabilities[i] /= sum;
+		}
+	}
+}
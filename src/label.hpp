@@ -0,0 +1,119 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "helper.hpp"
+#include "packed.hpp"
+#include "search.hpp"
+#include <atomic>
+#include <span>
+
+/**
+ * @file Provides batch labeling of dataset positions with a static evaluation and a quiescence
+ *       search score, without a full search.
+ */
+namespace chess {
+	namespace label {
+		struct Label {
+			int16_t staticEval;			/* from the side to move's point of view */
+			int16_t quiescence;			/* from the side to move's point of view */
+			packed::Position leaf;		/* the quiet position at the end of the quiescence principal variation */
+		};
+
+		/**
+		 * Labels positions one at a time, reusing a single Game. One per thread.
+		 */
+		class Labeler {
+			Game m_game;
+			search::Line m_pv;
+			uint64_t m_nodes = 0;
+
+			inline Label label() noexcept {
+				Label result;
+
+				CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+					CHESS_METRIC_SCOPE(Search);
+					result.staticEval = int16_t(eval::evaluate<Color>(m_game));
+					result.quiescence = int16_t(search::quiescence<Color>(m_game, -search::Infinity, search::Infinity, 0, m_pv, m_nodes));
+				});
+
+				// Walk down the principal variation to the leaf, and back
+				UndoInfo undoInfos[search::MaxPly];
+				for (int i = 0; i < m_pv.length; ++i) {
+					undoInfos[i] = CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+						return m_game.make<Color>(m_pv.moves[i]);
+					});
+				}
+
+				result.leaf = packed::pack(m_game);
+
+				for (int i = m_pv.length - 1; i >= 0; --i) {
+					CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(m_game, {
+						m_game.unmake<~Color>(m_pv.moves[i], undoInfos[i]);
+					});
+				}
+
+				return result;
+			}
+
+		public:
+			inline Label operator()(const packed::Position& position) noexcept {
+				CHESS_METRIC_SCOPE(Request);
+				packed::unpack(position, m_game);
+				return label();
+			}
+
+			// FEN must be valid. Its full-move number is capped as for packed positions, so that a
+			// large one cannot run past the history of the game.
+			inline Label operator()(const std::string_view fen) noexcept {
+				CHESS_METRIC_SCOPE(Request);
+				packed::unpack(packed::packFEN(fen), m_game);
+				return label();
+			}
+
+			inline uint64_t nodes() const noexcept { return m_nodes; }
+		};
+
+		/**
+		 * \param positions Packed positions, or valid FEN strings.
+		 * \param threads The number of worker threads, 0 for the hardware concurrency.
+		 * \returns The labels, in the order of the positions.
+		 *
+		 * Labels a batch of positions in parallel. Workers take blocks of positions from a shared
+		 * counter, so slow positions (with long capture sequences) do not stall a whole thread's
+		 * range.
+		 */
+		template <typename Position>
+		inline std::vector<Label> labelBatch(const std::span<const Position> positions, unsigned threads = 0) {
+			constexpr size_t BlockSize = 1024;
+
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			// The lookup tables must be initialized before the workers construct their labelers
+			lookup::init();
+
+			std::vector<Label> labels(positions.size());
+			std::atomic<size_t> next = 0;
+			std::vector<std::thread> workers;
+
+			for (unsigned t = 0; t < threads; ++t) {
+				workers.emplace_back([&]() {
+					Labeler labeler;
+
+					for (size_t begin; (begin = next.fetch_add(BlockSize, std::memory_order_relaxed)) < positions.size();) {
+						const size_t end = std::min(positions.size(), begin + BlockSize);
+
+						for (size_t i = begin; i < end; ++i)
+							labels[i] = labeler(positions[i]);
+					}
+				});
+			}
+
+			for (std::thread& worker : workers)
+				worker.join();
+
+			return labels;
+		}
+	}
+}
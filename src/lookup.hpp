@@ -3,6 +3,7 @@
  */
 #pragma once
 #include "defs.hpp"
+#include <algorithm>
 #include <array>
 #include <immintrin.h> // TODO: Do not always assume __has_include(<immintrin.h>)
 
@@ -216,30 +217,193 @@ namespace chess {
 			}
 		}
 
+#ifdef CHESS_MULTIVERSION
+		// Tables indexed with plain magic multiplication instead of PEXT, for CPUs without a fast PEXT
+		alignas(64) inline Bitboard rookMagicAttacks[64 * 4096];
+		alignas(64) inline Bitboard bishopMagicAttacks[64 * 512];
+		inline Bitboard rookMagics[64];
+		inline Bitboard bishopMagics[64];
+
+		// Whether the PEXT tables are built, decided by `init` from the CPU
+		inline bool usePext = false;
+#endif
+
+		namespace detail {
+			CHESS_ALWAYS_INLINE inline Bitboard pext(const Bitboard value, const Bitboard mask) noexcept {
+#if defined(__BMI2__)
+				return _pext_u64(value, mask);
+#else
+				// Without BMI2 enabled at compile time, the intrinsic cannot be used. This is only
+				// executed after `init` has checked that the CPU supports it.
+				Bitboard result;
+				asm("pextq %2, %1, %0" : "=r"(result) : "r"(value), "r"(mask));
+				return result;
+#endif
+			}
+
+			CHESS_ALWAYS_INLINE inline Bitboard pdep(const Bitboard value, const Bitboard mask) noexcept {
+#if defined(__BMI2__)
+				return _pdep_u64(value, mask);
+#else
+				Bitboard result;
+				asm("pdepq %2, %1, %0" : "=r"(result) : "r"(value), "r"(mask));
+				return result;
+#endif
+			}
+
+			inline void initPext() noexcept {
+				for (int i = 0; i < 64; ++i) {
+					Bitboard subset = 0;
+					do {
+						rookAttacks[i * 4096 + pext(subset, rookBlocker[i])] = rookAttack(i, subset);
+						subset = (subset - rookBlocker[i]) & rookBlocker[i];
+					} while (subset);
+
+					do {
+						bishopAttacks[i * 512 + pext(subset, bishopBlocker[i])] = bishopAttack(i, subset);
+						subset = (subset - bishopBlocker[i]) & bishopBlocker[i];
+					} while (subset);
+				}
+			}
+
+#ifdef CHESS_MULTIVERSION
+			/**
+			 * Finds a magic multiplier that maps every subset of the blocker mask to a table entry
+			 * without destructive collisions, and fills the table.
+			 */
+			template <int Bits>
+			inline Bitboard findMagic(const int square, const Bitboard mask, Bitboard* table, Bitboard (*attack)(int, Bitboard), uint64_t& seed) noexcept {
+				constexpr size_t Size = size_t(1) << Bits;
+
+				Bitboard occupancies[Size], attacks[Size];
+				size_t count = 0;
+				Bitboard subset = 0;
+				do {
+					occupancies[count] = subset;
+					attacks[count++] = attack(square, subset);
+					subset = (subset - mask) & mask;
+				} while (subset);
+
+				const auto random = [&seed]() {
+					seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+					return seed * 2685821657736338717ull;
+				};
+
+				// An entry is filled in this trial if it holds the trial number
+				uint32_t used[Size];
+				std::fill(used, used + Size, 0u);
+
+				for (uint32_t trial = 1;; ++trial) {
+					const Bitboard magic = random() & random() & random();
+					if (popcount((mask * magic) >> 56) < 6)
+						continue;
+
+					bool ok = true;
+					for (size_t i = 0; i < count && ok; ++i) {
+						const size_t index = (occupancies[i] * magic) >> (64 - Bits);
+
+						if (used[index] != trial) {
+							used[index] = trial;
+							table[index] = attacks[i];
+						} else {
+							ok = table[index] == attacks[i];
+						}
+					}
+
+					if (ok)
+						return magic;
+				}
+			}
+
+			inline void initMagics() noexcept {
+				uint64_t seed = 728;
+
+				for (int i = 0; i < 64; ++i) {
+					rookMagics[i] = findMagic<12>(i, rookBlocker[i], rookMagicAttacks + i * 4096, rookAttack, seed);
+					bishopMagics[i] = findMagic<9>(i, bishopBlocker[i], bishopMagicAttacks + i * 512, bishopAttack, seed);
+				}
+			}
+
+			inline bool hasFastPext() noexcept {
+				__builtin_cpu_init();
+
+				// PEXT is microcoded, and slow, on AMD before Zen 3
+				return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("bdver4") &&
+				       !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+			}
+#endif
+		}
+
+		/**
+		 * Slider attacks through the PEXT tables. The default, which needs BMI2.
+		 */
+		struct PextIndex {
+			CHESS_ALWAYS_INLINE static inline Bitboard bishop(const int from, const Bitboard occupied) noexcept {
+				return bishopAttacks[(from << 9) + detail::pext(occupied, bishopBlocker[from])];
+			}
+
+			CHESS_ALWAYS_INLINE static inline Bitboard rook(const int from, const Bitboard occupied) noexcept {
+				return rookAttacks[(from << 12) + detail::pext(occupied, rookBlocker[from])];
+			}
+		};
+
+#ifdef CHESS_MULTIVERSION
+		/**
+		 * Slider attacks through the magic tables, for any x86-64 CPU.
+		 */
+		struct MagicIndex {
+			CHESS_ALWAYS_INLINE static inline Bitboard bishop(const int from, const Bitboard occupied) noexcept {
+				return bishopMagicAttacks[(from << 9) + (((occupied & bishopBlocker[from]) * bishopMagics[from]) >> 55)];
+			}
+
+			CHESS_ALWAYS_INLINE static inline Bitboard rook(const int from, const Bitboard occupied) noexcept {
+				return rookMagicAttacks[(from << 12) + (((occupied & rookBlocker[from]) * rookMagics[from]) >> 52)];
+			}
+		};
+#endif
+
 		inline bool initialized = false;
 
 		/**
 		 * Initialize lookup tables. This can safely be called multiple times.
+		 *
+		 * With `CHESS_MULTIVERSION` defined, the library does not assume BMI2 at compile time.
+		 * The magic tables are always built, and the PEXT tables only on CPUs with a fast PEXT.
 		 */
 		inline void init() noexcept {
 			if (initialized) return;
-			
-			for (size_t i = 0; i < 64; ++i)
-				for (size_t j = 0; j < 4096; ++j)
-					rookAttacks[i * 4096 + j] = detail::rookAttack(i, _pdep_u64(j, rookBlocker[i]));
-			for (size_t i = 0; i < 64; ++i)
-				for (size_t j = 0; j < 512; ++j)
-					bishopAttacks[i * 512 + j] = detail::bishopAttack(i, _pdep_u64(j, bishopBlocker[i]));
-			
+
+#ifdef CHESS_MULTIVERSION
+			usePext = detail::hasFastPext();
+			detail::initMagics();
+			if (usePext)
+				detail::initPext();
+#else
+			detail::initPext();
+#endif
+
 			initialized = true;
 		}
 
+		/**
+		 * With `CHESS_MULTIVERSION` defined, these always go through the magic tables, which every
+		 * CPU has, instead of testing `usePext` on each lookup. The PEXT index is chosen once, for
+		 * whole kernels, by dispatch.hpp.
+		 */
 		CHESS_ALWAYS_INLINE inline constexpr Bitboard bishopAttack(const int from, const Bitboard occupied) noexcept {
-			return bishopAttacks[(from << 9) + _pext_u64(occupied, bishopBlocker[from])];
+#ifdef CHESS_MULTIVERSION
+			return MagicIndex::bishop(from, occupied);
+#else
+			return PextIndex::bishop(from, occupied);
+#endif
 		}
 
 		CHESS_ALWAYS_INLINE inline constexpr Bitboard rookAttack(const int from, const Bitboard occupied) noexcept {
-			return rookAttacks[(from << 12) + _pext_u64(occupied, rookBlocker[from])];
+#ifdef CHESS_MULTIVERSION
+			return MagicIndex::rook(from, occupied);
+#else
+			return PextIndex::rook(from, occupied);
+#endif
 		}
 
 		CHESS_ALWAYS_INLINE inline constexpr Bitboard queenAttack(const int from, const Bitboard occupied) noexcept {
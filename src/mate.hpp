@@ -0,0 +1,481 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "movegen.hpp"
+
+/**
+ * @file Provides a dedicated mate-in-one detection kernel.
+ *
+ * Only checking moves are generated: direct checks from the enemy king's attack masks, and
+ * discovered checks from the lines between our sliders and the enemy king. For each of those,
+ * the resulting position is only described by its bitboards (no make/unmake), and the
+ * defender is tested for the existence of a single legal evasion, without generating them all.
+ */
+namespace chess {
+	namespace movegen {
+		namespace detail {
+			/**
+			 * The bitboards of a position after a move, without any of the Game state.
+			 */
+			struct VirtualPosition {
+				Bitboard pieces[2][6];
+				Bitboard occupancy[2];
+				Bitboard occupied;
+				int enPassantSquare;
+
+				template <Color Color, PieceType PieceType>
+				CHESS_ALWAYS_INLINE inline constexpr Bitboard& get() noexcept {
+					return pieces[size_t(Color)][size_t(PieceType)];
+				}
+
+				template <Color Color, PieceType PieceType>
+				CHESS_ALWAYS_INLINE inline constexpr Bitboard get() const noexcept {
+					return pieces[size_t(Color)][size_t(PieceType)];
+				}
+			};
+
+			// Attackers of the given color to a square, ignoring pieces outside `include`
+			template <Color Attacker>
+			inline constexpr Bitboard attackersTo(const VirtualPosition& position, const int square,
+			                                      const Bitboard occupied, const Bitboard include) noexcept {
+				const Bitboard spot = 1ull << square;
+				const Bitboard queens = position.get<Attacker, PieceType::Queen>();
+
+				return include & (
+					((leftPawnAttack<~Attacker>(spot) | rightPawnAttack<~Attacker>(spot)) & position.get<Attacker, PieceType::Pawn>()) |
+					(lookup::knightAttack(square) & position.get<Attacker, PieceType::Knight>()) |
+					(lookup::kingAttack(square) & position.get<Attacker, PieceType::King>()) |
+					(lookup::bishopAttack(square, occupied) & (position.get<Attacker, PieceType::Bishop>() | queens)) |
+					(lookup::rookAttack(square, occupied) & (position.get<Attacker, PieceType::Rook>() | queens))
+				);
+			}
+
+			// Pieces of the given color that are pinned to their king
+			template <Color Color>
+			inline constexpr Bitboard pinnedPieces(const VirtualPosition& position, const int kingSquare) noexcept {
+				const Bitboard ours = position.occupancy[size_t(Color)];
+				const Bitboard enemyQueens = position.get<~Color, PieceType::Queen>();
+				Bitboard pinned = 0;
+
+				const Bitboard rookProbe = lookup::rookAttack(kingSquare, position.occupied);
+				const Bitboard rookXray = lookup::rookAttack(kingSquare, position.occupied & ~(rookProbe & ours));
+				for (Bitboard pinners = rookXray & ~rookProbe & (position.get<~Color, PieceType::Rook>() | enemyQueens); pinners;)
+					pinned |= lookup::rookAttack(popLSB(pinners), position.occupied) & rookProbe & ours;
+
+				const Bitboard bishopProbe = lookup::bishopAttack(kingSquare, position.occupied);
+				const Bitboard bishopXray = lookup::bishopAttack(kingSquare, position.occupied & ~(bishopProbe & ours));
+				for (Bitboard pinners = bishopXray & ~bishopProbe & (position.get<~Color, PieceType::Bishop>() | enemyQueens); pinners;)
+					pinned |= lookup::bishopAttack(popLSB(pinners), position.occupied) & bishopProbe & ours;
+
+				return pinned;
+			}
+
+			/**
+			 * \tparam Color The defending side, which is in check.
+			 * \returns True if the defender has at least one legal move.
+			 */
+			template <Color Color>
+			inline constexpr bool hasEvasion(const VirtualPosition& position, const Bitboard checkers) noexcept {
+				const Bitboard king = position.get<Color, PieceType::King>();
+				const int kingSquare = toSquare(king);
+				const Bitboard ours = position.occupancy[size_t(Color)];
+
+				// King moves, with enemy attacks going through the king's old square
+				const Bitboard withoutKing = position.occupied ^ king;
+				for (Bitboard targets = lookup::kingAttack(kingSquare) & ~ours; targets;) {
+					const int target = popLSB(targets);
+
+					// A captured attacker does not attack anymore
+					if (attackersTo<~Color>(position, target, withoutKing, ~(1ull << target)) == 0)
+						return true;
+				}
+
+				// Only the king can escape a double check
+				if ((checkers & (checkers - 1)) != 0)
+					return false;
+
+				const int checkerSquare = toSquare(checkers);
+
+				// En-passant capture of a double-pushed pawn. This may capture the checker, or block
+				// a discovered check, so just test the resulting position.
+				if (position.enPassantSquare != Square::None) {
+					const Bitboard epSpot = 1ull << position.enPassantSquare;
+					const Bitboard victim = forward<~Color>(epSpot);
+
+					for (Bitboard capturers = (leftPawnAttack<~Color>(epSpot) | rightPawnAttack<~Color>(epSpot)) &
+					                          position.get<Color, PieceType::Pawn>(); capturers;) {
+						const Bitboard capturer = 1ull << popLSB(capturers);
+						const Bitboard occupied = (position.occupied ^ capturer ^ victim) | epSpot;
+
+						if (attackersTo<~Color>(position, kingSquare, occupied, ~victim) == 0)
+							return true;
+					}
+				}
+
+				// Otherwise, capture the checker or block a slider check with an unpinned piece.
+				// A pinned piece can never resolve a check.
+				Bitboard between = 0;
+				if (const Bitboard diagonal = lookup::bishopAttack(kingSquare, position.occupied); diagonal & checkers)
+					between = diagonal & lookup::bishopAttack(checkerSquare, position.occupied);
+				else if (const Bitboard orthogonal = lookup::rookAttack(kingSquare, position.occupied); orthogonal & checkers)
+					between = orthogonal & lookup::rookAttack(checkerSquare, position.occupied);
+
+				const Bitboard movers = ours & ~king & ~pinnedPieces<Color>(position, kingSquare);
+				const Bitboard pawns = position.get<Color, PieceType::Pawn>() & movers;
+				const Bitboard knights = position.get<Color, PieceType::Knight>() & movers;
+				const Bitboard queens = position.get<Color, PieceType::Queen>();
+				const Bitboard diagonalMovers = (position.get<Color, PieceType::Bishop>() | queens) & movers;
+				const Bitboard orthogonalMovers = (position.get<Color, PieceType::Rook>() | queens) & movers;
+
+				for (Bitboard targets = between | checkers; targets;) {
+					const int target = popLSB(targets);
+					const Bitboard spot = 1ull << target;
+
+					if ((lookup::knightAttack(target) & knights) ||
+					    (lookup::bishopAttack(target, position.occupied) & diagonalMovers) ||
+					    (lookup::rookAttack(target, position.occupied) & orthogonalMovers))
+						return true;
+
+					if (spot == checkers) {
+						// Pawn captures of the checker
+						if ((leftPawnAttack<~Color>(spot) | rightPawnAttack<~Color>(spot)) & pawns)
+							return true;
+					} else {
+						// Pawn pushes onto a blocking square
+						if (forward<~Color>(spot) & pawns)
+							return true;
+
+						if ((spot & forward<Color>(forward<Color>(pawnStartingRank<Color>()))) &&
+						    (forward<~Color>(spot) & position.occupied) == 0 &&
+						    (doubleForward<~Color>(spot) & pawns))
+							return true;
+					}
+				}
+
+				return false;
+			}
+
+			/**
+			 * \tparam Color The side making the move.
+			 * \returns The position after the move.
+			 */
+			template <Color Color>
+			inline constexpr VirtualPosition applyMove(const Game& game, const Move move) noexcept {
+				const Board& board = game.board();
+				VirtualPosition position;
+
+				for (size_t color = 0; color < 2; ++color)
+					for (size_t pieceType = 0; pieceType < 6; ++pieceType)
+						position.pieces[color][pieceType] = board.pieceBitboard(makePiece(PieceType(pieceType), ::chess::Color(color)));
+
+				const int from = move.getFrom(), to = move.getTo();
+				const Bitboard fromSpot = 1ull << from, toSpot = 1ull << to;
+				const PieceType moving = getPieceType(board.pieceAt(from));
+
+				if (move.isCapture()) {
+					const int captureSquare = move.captureDestinationSquare<Color>();
+					const Piece captured = board.pieceAt(captureSquare);
+					position.pieces[size_t(~Color)][size_t(getPieceType(captured))] ^= 1ull << captureSquare;
+				}
+
+				position.pieces[size_t(Color)][size_t(moving)] ^= fromSpot;
+				position.pieces[size_t(Color)][size_t(move.isPromotion() ? move.promotionPieceType() : moving)] |= toSpot;
+
+				if (move.isKingsideCastle())
+					position.get<Color, PieceType::Rook>() ^= (1ull << kingsideCastleRookFromSquare<Color>()) | (1ull << kingsideCastleRookToSquare<Color>());
+				else if (move.isQueensideCastle())
+					position.get<Color, PieceType::Rook>() ^= (1ull << queensideCastleRookFromSquare<Color>()) | (1ull << queensideCastleRookToSquare<Color>());
+
+				for (size_t color = 0; color < 2; ++color) {
+					position.occupancy[color] = 0;
+					for (size_t pieceType = 0; pieceType < 6; ++pieceType)
+						position.occupancy[color] |= position.pieces[color][pieceType];
+				}
+
+				position.occupied = position.occupancy[0] | position.occupancy[1];
+				position.enPassantSquare = move.isDoublePawnPush() ? move.doublePawnPushEnPassantSquare<Color>() : int(Square::None);
+
+				return position;
+			}
+		}
+
+		/**
+		 * Generates the legal moves that give check, and only those: moves onto a direct check
+		 * square of the moving piece, moves of pieces that block one of our sliders from the enemy
+		 * king and leave its line, and the promotions, castles and en-passant captures that check.
+		 *
+		 * \tparam Color The current turn.
+		 * \param callback Called with each checking move, as with `legalMoves`.
+		 */
+		template <Color Color, typename Callback>
+		inline constexpr void checkingMoves(const Game& game, Callback&& callback) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			constexpr Piece pawn = makePiece(PieceType::Pawn, Color);
+
+			const Board& board = game.board();
+			const Bitboard occupied = board.occupied();
+			const Bitboard ours = board.occupancy<Color>();
+			const Bitboard theirs = board.occupancy<~Color>();
+			const Bitboard king = board.kings<Color>();
+			const Bitboard queens = board.queens<Color>();
+			const int kingSquare = toSquare(king);
+			const int enemyKingSquare = toSquare(board.kings<~Color>());
+			const Bitboard enemyKing = 1ull << enemyKingSquare;
+
+			const Bitboard checkmask = computeCheckmask<Color>(game);
+			const Bitboard pinHV = computeHorizontalVerticalPinmask<Color>(game);
+			const Bitboard pinD = computeDiagonalPinmask<Color>(game);
+			const Bitboard moveable = ~ours & checkmask;
+
+			// Direct check squares, by moving piece type
+			const Bitboard pawnChecks = leftPawnAttack<~Color>(enemyKing) | rightPawnAttack<~Color>(enemyKing);
+			const Bitboard knightChecks = lookup::knightAttack(enemyKingSquare);
+			const Bitboard diagonalChecks = lookup::bishopAttack(enemyKingSquare, occupied);
+			const Bitboard orthogonalChecks = lookup::rookAttack(enemyKingSquare, occupied);
+
+			// Our pieces that block one of our sliders from the enemy king, each with the squares
+			// between the two (where the attacks of each, blocked only by the other, meet). Leaving those squares discovers the check. Only the entries of the
+			// discoverers are ever written or read.
+			Bitboard discoverers = 0;
+			Bitboard discoveryLines[64];
+			{
+				const Bitboard orthogonalXray = lookup::rookAttack(enemyKingSquare, occupied & ~(orthogonalChecks & ours));
+				for (Bitboard snipers = orthogonalXray & ~orthogonalChecks & (board.rooks<Color>() | queens); snipers;) {
+					const int sniper = popLSB(snipers);
+					const Bitboard line = lookup::rookAttack(sniper, enemyKing) & lookup::rookAttack(enemyKingSquare, 1ull << sniper);
+					const int blocker = toSquare(line & ours);
+
+					discoverers |= 1ull << blocker;
+					discoveryLines[blocker] = line;
+				}
+
+				const Bitboard diagonalXray = lookup::bishopAttack(enemyKingSquare, occupied & ~(diagonalChecks & ours));
+				for (Bitboard snipers = diagonalXray & ~diagonalChecks & (board.bishops<Color>() | queens); snipers;) {
+					const int sniper = popLSB(snipers);
+					const Bitboard line = lookup::bishopAttack(sniper, enemyKing) & lookup::bishopAttack(enemyKingSquare, 1ull << sniper);
+					const int blocker = toSquare(line & ours);
+
+					discoverers |= 1ull << blocker;
+					discoveryLines[blocker] = line;
+				}
+			}
+
+			// The squares a piece gives check from, given its direct check squares
+			const auto checksFrom = [&](const int from, const Bitboard direct) {
+				return ((discoverers >> from) & 1) ? direct | ~discoveryLines[from] : direct;
+			};
+
+			const auto emitAll = [&](const int from, Bitboard targets, const Piece moved) {
+				while (targets != 0) {
+					const int to = popLSB(targets);
+
+					// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
+					const MoveFlags moveFlag = static_cast<MoveFlags>(((theirs >> to) & 1ull) << 2);
+
+					detail::emit(callback, Move{from, to, moveFlag}, moved, board.pieceAt(to));
+				}
+			};
+
+			// The rare moves that the masks do not describe exactly are tested on the resulting position
+			const auto emitIfChecking = [&](const Move move, const Piece captured) {
+				const detail::VirtualPosition position = detail::applyMove<Color>(game, move);
+
+				if (detail::attackersTo<~Color>(position, toSquare(position.get<Color, PieceType::King>()), position.occupied, ~Bitboard(0)) == 0 &&
+				    detail::attackersTo<Color>(position, enemyKingSquare, position.occupied, ~Bitboard(0)) != 0)
+					detail::emit(callback, move, board.pieceAt(move.getFrom()), captured);
+			};
+
+			// Pawn moves, pruned for pins as in `legalMoves`
+			{
+				const Bitboard pawns = board.pawns<Color>();
+				const Bitboard pawnsUHV = pawns & ~pinHV;
+				const Bitboard pawnsUD = pawns & ~pinD;
+
+				Bitboard quiet = pawnsUD & forward<~Color>(~occupied);
+				Bitboard doublePush = quiet & pawnStartingRank<Color>() & doubleForward<~Color>(~occupied & checkmask);
+				Bitboard leftCapture = pawnsUHV & reverseLeftPawnAttack<Color>(theirs & checkmask);
+				Bitboard rightCapture = pawnsUHV & reverseRightPawnAttack<Color>(theirs & checkmask);
+				quiet &= forward<~Color>(checkmask);
+
+				quiet &= ~pinHV | forward<~Color>(pinHV);
+				doublePush &= ~pinHV | doubleForward<~Color>(pinHV);
+				leftCapture &= ~pinD | reverseLeftPawnAttack<Color>(pinD);
+				rightCapture &= ~pinD | reverseRightPawnAttack<Color>(pinD);
+
+				// Promotions check with whichever piece they promote to. The pawn leaves its square,
+				// which may open a line from the new piece to the enemy king.
+				for (Bitboard promoting = (quiet | leftCapture | rightCapture) & pawnLastRank<Color>(); promoting;) {
+					const int from = popLSB(promoting);
+					const Bitboard fromSpot = 1ull << from;
+					const Bitboard vacated = occupied ^ fromSpot;
+					const Bitboard diagonal = lookup::bishopAttack(enemyKingSquare, vacated);
+					const Bitboard orthogonal = lookup::rookAttack(enemyKingSquare, vacated);
+					const Bitboard promotionChecks[4] = {
+						checksFrom(from, knightChecks),
+						checksFrom(from, diagonal),
+						checksFrom(from, orthogonal),
+						checksFrom(from, diagonal | orthogonal)
+					};
+
+					Bitboard targets = 0;
+					if (quiet & fromSpot) targets |= forward<Color>(fromSpot);
+					if (leftCapture & fromSpot) targets |= forward<Color>(fromSpot) >> 1;
+					if (rightCapture & fromSpot) targets |= forward<Color>(fromSpot) << 1;
+
+					while (targets != 0) {
+						const int to = popLSB(targets);
+						const int capture = int((theirs >> to) & 1) << 2;
+
+						for (size_t promotion = 0; promotion < 4; ++promotion)
+							if ((promotionChecks[promotion] >> to) & 1)
+								detail::emit(callback, Move{from, to, MoveFlags(0b1000 | capture | int(promotion))}, pawn, board.pieceAt(to));
+					}
+				}
+
+				// The other pawn moves, with the pawns that cannot check dropped up front
+				const Bitboard pawnDiscoverers = discoverers & pawns;
+				quiet &= ~pawnLastRank<Color>() & (forward<~Color>(pawnChecks) | pawnDiscoverers);
+				doublePush &= doubleForward<~Color>(pawnChecks) | pawnDiscoverers;
+				leftCapture &= ~pawnLastRank<Color>() & (reverseLeftPawnAttack<Color>(pawnChecks) | pawnDiscoverers);
+				rightCapture &= ~pawnLastRank<Color>() & (reverseRightPawnAttack<Color>(pawnChecks) | pawnDiscoverers);
+
+				while (quiet != 0) {
+					const int from = popLSB(quiet);
+					const int to = forwardSquare<Color>(from);
+
+					if ((checksFrom(from, pawnChecks) >> to) & 1)
+						detail::emit(callback, Move{from, to, MoveFlags::QuietMove}, pawn, Piece::None);
+				}
+
+				while (doublePush != 0) {
+					const int from = popLSB(doublePush);
+					const int to = doubleForwardSquare<Color>(from);
+
+					if ((checksFrom(from, pawnChecks) >> to) & 1)
+						detail::emit(callback, Move{from, to, MoveFlags::DoublePawnPush}, pawn, Piece::None);
+				}
+
+				while (leftCapture != 0) {
+					const int from = popLSB(leftCapture);
+					const int to = forwardSquare<Color>(from) - 1;
+
+					if ((checksFrom(from, pawnChecks) >> to) & 1)
+						detail::emit(callback, Move{from, to, MoveFlags::Capture}, pawn, board.pieceAt(to));
+				}
+
+				while (rightCapture != 0) {
+					const int from = popLSB(rightCapture);
+					const int to = forwardSquare<Color>(from) + 1;
+
+					if ((checksFrom(from, pawnChecks) >> to) & 1)
+						detail::emit(callback, Move{from, to, MoveFlags::Capture}, pawn, board.pieceAt(to));
+				}
+
+				if (const int epSquare = game.enPassantSquare(); epSquare != Square::None) {
+					const Bitboard epSpot = 1ull << epSquare;
+
+					for (Bitboard capturers = (leftPawnAttack<~Color>(epSpot) | rightPawnAttack<~Color>(epSpot)) & pawns; capturers;)
+						emitIfChecking(Move{popLSB(capturers), epSquare, MoveFlags::EnPassantCapture}, makePiece(PieceType::Pawn, ~Color));
+				}
+			}
+
+			// Knight moves; pinned knights cannot move
+			for (Bitboard knights = board.knights<Color>() & ~(pinHV | pinD); knights;) {
+				const int from = popLSB(knights);
+				emitAll(from, lookup::knightAttack(from) & moveable & checksFrom(from, knightChecks), makePiece(PieceType::Knight, Color));
+			}
+
+			// Diagonal moves of bishops and queens
+			for (Bitboard movers = (board.bishops<Color>() | queens) & ~pinHV; movers;) {
+				const int from = popLSB(movers);
+				const bool queen = (queens >> from) & 1;
+
+				Bitboard legal = lookup::bishopAttack(from, occupied) & moveable;
+				if ((pinD >> from) & 1)
+					legal &= pinD;
+
+				emitAll(from, legal & checksFrom(from, queen ? diagonalChecks | orthogonalChecks : diagonalChecks),
+				        queen ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Bishop, Color));
+			}
+
+			// Orthogonal moves of rooks and queens
+			for (Bitboard movers = (board.rooks<Color>() | queens) & ~pinD; movers;) {
+				const int from = popLSB(movers);
+				const bool queen = (queens >> from) & 1;
+
+				Bitboard legal = lookup::rookAttack(from, occupied) & moveable;
+				if ((pinHV >> from) & 1)
+					legal &= pinHV;
+
+				emitAll(from, legal & checksFrom(from, queen ? diagonalChecks | orthogonalChecks : orthogonalChecks),
+				        queen ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Rook, Color));
+			}
+
+			// The king only checks by discovery, or by castling into a rook check
+			const bool canCastle = (game.castlingRights() & (kingsideCastleFlag<Color>() | queensideCastleFlag<Color>())) != CastlingFlags::None;
+			if (((discoverers & king) != 0) || canCastle) {
+				const Bitboard banned = computeAttackedWithoutKing<Color>(game);
+
+				if (discoverers & king)
+					emitAll(kingSquare, lookup::kingAttack(kingSquare) & ~ours & ~banned & ~discoveryLines[kingSquare], makePiece(PieceType::King, Color));
+
+				constexpr Bitboard shouldUnoccupiedKingside =
+					squaresBetweenUnordered(kingsideCastleRookFromSquare<Color>(), initialKingSquare<Color>());
+				constexpr Bitboard shouldUnoccupiedQueenside =
+					squaresBetweenUnordered(queensideCastleRookFromSquare<Color>(), initialKingSquare<Color>());
+				constexpr Bitboard shouldNotAttackedKingside =
+					squaresBetweenUnordered(kingsideCastleKingToSquare<Color>(), initialKingSquare<Color>()) |
+					(1ull << kingsideCastleKingToSquare<Color>()) | (1ull << initialKingSquare<Color>());
+				constexpr Bitboard shouldNotAttackedQueenside =
+					squaresBetweenUnordered(queensideCastleKingToSquare<Color>(), initialKingSquare<Color>()) |
+					(1ull << queensideCastleKingToSquare<Color>()) | (1ull << initialKingSquare<Color>());
+
+				if ((game.castlingRights() & kingsideCastleFlag<Color>()) != CastlingFlags::None &&
+				    (shouldUnoccupiedKingside & occupied) == 0 &&
+				    (shouldNotAttackedKingside & banned) == 0)
+					emitIfChecking(Move{kingSquare, kingSquare + 2, MoveFlags::KingCastle}, Piece::None);
+
+				if ((game.castlingRights() & queensideCastleFlag<Color>()) != CastlingFlags::None &&
+				    (shouldUnoccupiedQueenside & occupied) == 0 &&
+				    (shouldNotAttackedQueenside & banned) == 0)
+					emitIfChecking(Move{kingSquare, kingSquare - 2, MoveFlags::QueenCastle}, Piece::None);
+			}
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \returns A move that checkmates the opponent, or the null move if there is none.
+		 */
+		template <Color Color>
+		inline constexpr Move findMateInOne(const Game& game) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			const int enemyKingSquare = toSquare(game.board().kings<~Color>());
+			Move mate = Move::null();
+
+			checkingMoves<Color>(game, [&](const Move move) {
+				if (!mate.isNull())
+					return;
+
+				const detail::VirtualPosition position = detail::applyMove<Color>(game, move);
+				const Bitboard checkers = detail::attackersTo<Color>(position, enemyKingSquare, position.occupied, ~Bitboard(0));
+
+				if (!detail::hasEvasion<~Color>(position, checkers))
+					mate = move;
+			});
+
+			return mate;
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \returns True if the side to move can checkmate in one move.
+		 */
+		template <Color Color>
+		inline constexpr bool hasMateInOne(const Game& game) noexcept {
+			return !findMateInOne<Color>(game).isNull();
+		}
+	}
+}
@@ -0,0 +1,451 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <arpa/inet.h>
+#	include <netinet/in.h>
+#	include <poll.h>
+#	include <sys/socket.h>
+#	include <unistd.h>
+#	define CHESS_HAS_SOCKETS
+#endif
+
+/**
+ * @file Provides latency histograms for service deployments, with a Prometheus text exposition
+ *       written to a file or served over a local socket.
+ *
+ * Define `CHESS_METRICS` to have `legalMoves`, `make`, searches, labeling requests and thread
+ * pool wakeups record their latencies. Each thread records into its own histograms without contention, and
+ * `collect` merges them. Services record their own requests with a `ScopedTimer`:
+ *
+ *     chess::metrics::Exporter exporter({ .path = "/var/lib/node_exporter/chess.prom", .port = 9464 });
+ *
+ *     void handle(const Request& request) {
+ *         const chess::metrics::ScopedTimer timer(chess::metrics::Operation::Request);
+ *         ...
+ *     }
+ */
+namespace chess {
+	namespace metrics {
+		enum class Operation : uint8_t {
+			LegalMoves,
+			Make,
+			Search,
+			Request,
+			Wakeup		/* from the start of a parallel search to a helper thread's first node */
+		};
+
+		inline constexpr size_t OperationCount = 5;
+		inline constexpr const char* OperationNames[OperationCount] = { "legal_moves", "make", "search", "request", "wakeup" };
+
+		namespace detail {
+			struct Recorder;
+		}
+
+		/**
+		 * A latency histogram in nanoseconds, with HDR-style log-linear buckets: each power of two is
+		 * split into 32 linear sub-buckets, so a quantile is within about 3% of the true value, from
+		 * 1 ns up to about 39 hours. This is not thread-safe; see `collect` for merged histograms.
+		 */
+		class Histogram {
+		public:
+			static constexpr int SubBucketBits = 5;
+			static constexpr int SubBucketHalf = 1 << SubBucketBits;
+			static constexpr int MaxBits = 47;
+			static constexpr size_t BucketCount = (MaxBits - SubBucketBits + 1) * SubBucketHalf;
+			static constexpr uint64_t MaxValue = (uint64_t(1) << MaxBits) - 1;
+
+			static inline constexpr size_t bucketOf(uint64_t value) noexcept {
+				value = std::min(value, MaxValue);
+
+				const int bucket = std::max(0, int(std::bit_width(value)) - 1 - SubBucketBits);
+				return size_t((bucket + 1) * SubBucketHalf + int(value >> bucket) - SubBucketHalf);
+			}
+
+			// The highest value that is recorded into the bucket
+			static inline constexpr uint64_t upperBoundOf(const size_t index) noexcept {
+				const int bucket = std::max(0, int(index) / SubBucketHalf - 1);
+				const uint64_t subBucket = index - size_t(bucket + 1) * SubBucketHalf + SubBucketHalf;
+				return ((subBucket + 1) << bucket) - 1;
+			}
+
+		private:
+			std::vector<uint64_t> m_counts = std::vector<uint64_t>(BucketCount);
+			uint64_t m_count = 0;
+			uint64_t m_sum = 0;
+			uint64_t m_max = 0;
+
+			friend struct detail::Recorder;
+
+		public:
+			inline void record(const uint64_t nanoseconds, const uint64_t times = 1) noexcept {
+				m_counts[bucketOf(nanoseconds)] += times;
+				m_count += times;
+				m_sum += nanoseconds * times;
+				m_max = std::max(m_max, nanoseconds);
+			}
+
+			inline void merge(const Histogram& other) noexcept {
+				for (size_t i = 0; i < BucketCount; ++i)
+					m_counts[i] += other.m_counts[i];
+
+				m_count += other.m_count;
+				m_sum += other.m_sum;
+				m_max = std::max(m_max, other.m_max);
+			}
+
+			inline void reset() noexcept {
+				std::fill(m_counts.begin(), m_counts.end(), 0);
+				m_count = m_sum = m_max = 0;
+			}
+
+			inline uint64_t count() const noexcept { return m_count; }
+			inline uint64_t sum() const noexcept { return m_sum; }
+			inline uint64_t max() const noexcept { return m_max; }
+			inline uint64_t bucketCount(const size_t index) const noexcept { return m_counts[index]; }
+
+			/**
+			 * \param quantile In [0, 1], such as 0.99.
+			 * \returns The value below which that fraction of the recorded values lies, rounded up
+			 *          to its bucket, or 0 if nothing was recorded.
+			 */
+			inline uint64_t quantile(const double quantile) const noexcept {
+				if (m_count == 0)
+					return 0;
+
+				const uint64_t rank = std::max<uint64_t>(1, uint64_t(quantile * double(m_count) + 0.5));
+
+				uint64_t seen = 0;
+				for (size_t i = 0; i < BucketCount; ++i) {
+					seen += m_counts[i];
+					if (seen >= rank)
+						return std::min(upperBoundOf(i), m_max);
+				}
+
+				return m_max;
+			}
+		};
+
+		/**
+		 * The merged histograms of every thread, indexed by Operation.
+		 */
+		struct Snapshot {
+			Histogram operations[OperationCount];
+
+			inline const Histogram& operator[](const Operation operation) const noexcept {
+				return operations[(size_t)operation];
+			}
+		};
+
+		namespace detail {
+			/**
+			 * The histograms of one thread. Only the owning thread writes, so relaxed loads and stores
+			 * suffice, with no read-modify-write, and `collect` reads them concurrently.
+			 */
+			struct Recorder {
+				std::atomic<uint64_t> counts[OperationCount][Histogram::BucketCount];
+				std::atomic<uint64_t> sums[OperationCount];
+				std::atomic<uint64_t> maxima[OperationCount];
+
+				inline void record(const Operation operation, const uint64_t nanoseconds) noexcept {
+					const size_t op = (size_t)operation;
+					const auto bump = [](std::atomic<uint64_t>& counter, const uint64_t value) {
+						counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+					};
+
+					bump(counts[op][Histogram::bucketOf(nanoseconds)], 1);
+					bump(sums[op], nanoseconds);
+					if (nanoseconds > maxima[op].load(std::memory_order_relaxed))
+						maxima[op].store(nanoseconds, std::memory_order_relaxed);
+				}
+
+				inline void addTo(Snapshot& snapshot) const noexcept {
+					for (size_t op = 0; op < OperationCount; ++op) {
+						Histogram& histogram = snapshot.operations[op];
+
+						for (size_t i = 0; i < Histogram::BucketCount; ++i) {
+							const uint64_t count = counts[op][i].load(std::memory_order_relaxed);
+							histogram.m_counts[i] += count;
+							histogram.m_count += count;
+						}
+
+						histogram.m_sum += sums[op].load(std::memory_order_relaxed);
+						histogram.m_max = std::max(histogram.m_max, maxima[op].load(std::memory_order_relaxed));
+					}
+				}
+			};
+
+			struct Registry {
+				std::mutex mutex;
+				std::vector<const Recorder*> live;
+				Snapshot retired;		/* from the threads that have exited */
+			};
+
+			inline Registry registry;
+
+			// Registers the thread's recorder on first use, and folds it into `retired` at thread exit
+			class ThreadRecorder {
+				std::unique_ptr<Recorder> m_recorder = std::make_unique<Recorder>();
+
+			public:
+				inline ThreadRecorder() {
+					const std::lock_guard lock(registry.mutex);
+					registry.live.push_back(m_recorder.get());
+				}
+
+				inline ~ThreadRecorder() {
+					const std::lock_guard lock(registry.mutex);
+					std::erase(registry.live, m_recorder.get());
+					m_recorder->addTo(registry.retired);
+				}
+
+				inline Recorder& get() noexcept { return *m_recorder; }
+			};
+
+			inline Recorder& threadRecorder() {
+				thread_local ThreadRecorder recorder;
+				return recorder.get();
+			}
+		}
+
+		/**
+		 * Records a latency on the calling thread.
+		 */
+		inline void record(const Operation operation, const std::chrono::nanoseconds latency) {
+			detail::threadRecorder().record(operation, uint64_t(std::max<int64_t>(0, latency.count())));
+		}
+
+		/**
+		 * Records the time from construction to destruction. It can be used in constexpr functions,
+		 * and records nothing during constant evaluation.
+		 */
+		class ScopedTimer {
+			Operation m_operation;
+			std::chrono::steady_clock::time_point m_start;
+
+		public:
+			constexpr explicit ScopedTimer(const Operation operation) noexcept : m_operation{ operation }, m_start{ } {
+				if (!std::is_constant_evaluated())
+					m_start = std::chrono::steady_clock::now();
+			}
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+			constexpr ~ScopedTimer() {
+				if (!std::is_constant_evaluated())
+					record(m_operation, std::chrono::steady_clock::now() - m_start);
+			}
+		};
+
+		/**
+		 * \returns The histograms of every thread, merged. They are cumulative since startup.
+		 */
+		inline Snapshot collect() {
+			Snapshot snapshot;
+
+			const std::lock_guard lock(detail::registry.mutex);
+			for (size_t op = 0; op < OperationCount; ++op)
+				snapshot.operations[op].merge(detail::registry.retired.operations[op]);
+			for (const detail::Recorder* recorder : detail::registry.live)
+				recorder->addTo(snapshot);
+
+			return snapshot;
+		}
+
+		/**
+		 * \returns The snapshot in the Prometheus text exposition format: a summary per operation
+		 *          with the median and tail quantiles, in seconds.
+		 */
+		inline std::string format(const Snapshot& snapshot) {
+			constexpr double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+			std::string text =
+				"# HELP chess_latency_seconds Latency of chess library operations.\n"
+				"# TYPE chess_latency_seconds summary\n";
+
+			char line[160];
+			for (size_t op = 0; op < OperationCount; ++op) {
+				const Histogram& histogram = snapshot.operations[op];
+
+				for (const double quantile : Quantiles) {
+					std::snprintf(line, sizeof(line), "chess_latency_seconds{operation=\"%s\",quantile=\"%g\"} %.9g\n",
+					              OperationNames[op], quantile, double(histogram.quantile(quantile)) * 1e-9);
+					text += line;
+				}
+
+				std::snprintf(line, sizeof(line), "chess_latency_seconds_sum{operation=\"%s\"} %.9g\n", OperationNames[op], double(histogram.sum()) * 1e-9);
+				text += line;
+				std::snprintf(line, sizeof(line), "chess_latency_seconds_count{operation=\"%s\"} %llu\n", OperationNames[op], (unsigned long long)histogram.count());
+				text += line;
+			}
+
+			text +=
+				"# HELP chess_latency_max_seconds Highest latency of chess library operations.\n"
+				"# TYPE chess_latency_max_seconds gauge\n";
+
+			for (size_t op = 0; op < OperationCount; ++op) {
+				std::snprintf(line, sizeof(line), "chess_latency_max_seconds{operation=\"%s\"} %.9g\n", OperationNames[op], double(snapshot.operations[op].max()) * 1e-9);
+				text += line;
+			}
+
+			return text;
+		}
+
+		/**
+		 * Writes the current metrics to a file, replacing it atomically, as the node exporter's
+		 * textfile collector expects.
+		 *
+		 * \returns Whether the file was written.
+		 */
+		inline bool writeFile(const std::string& path) {
+			const std::string text = format(collect());
+			const std::string temporary = path + ".tmp";
+
+			std::FILE* file = std::fopen(temporary.c_str(), "wb");
+			if (!file)
+				return false;
+
+			const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+			if (std::fclose(file) != 0 || !written) {
+				std::remove(temporary.c_str());
+				return false;
+			}
+
+#ifndef CHESS_HAS_SOCKETS
+			std::remove(path.c_str());
+#endif
+			return std::rename(temporary.c_str(), path.c_str()) == 0;
+		}
+
+		/**
+		 * Exports the metrics in the background: periodically to a file, and on request over HTTP on
+		 * a loopback port, for a Prometheus scraper. Stopped on destruction.
+		 */
+		class Exporter {
+		public:
+			struct Options {
+				std::string path;										/* empty for no file */
+				uint16_t port = 0;										/* 0 for no socket, listens on 127.0.0.1 */
+				std::chrono::milliseconds interval = std::chrono::seconds(10);
+			};
+
+		private:
+			Options m_options;
+			std::atomic<bool> m_stop = false;
+			int m_socket = -1;
+			std::thread m_thread;
+
+			inline void serve() noexcept {
+#ifdef CHESS_HAS_SOCKETS
+				const int client = ::accept(m_socket, nullptr, nullptr);
+				if (client < 0)
+					return;
+
+				// The request itself does not matter, every path gets the metrics
+				char request[1024];
+				(void)::recv(client, request, sizeof(request), 0);
+
+				const std::string body = format(collect());
+				const std::string response =
+					"HTTP/1.0 200 OK\r\n"
+					"Content-Type: text/plain; version=0.0.4\r\n"
+					"Content-Length: " + std::to_string(body.size()) + "\r\n"
+					"\r\n" + body;
+
+				for (size_t sent = 0; sent < response.size();) {
+					const ssize_t n = ::send(client, response.data() + sent, response.size() - sent, 0);
+					if (n <= 0)
+						break;
+					sent += size_t(n);
+				}
+
+				::close(client);
+#endif
+			}
+
+			inline void run() noexcept {
+				constexpr auto Tick = std::chrono::milliseconds(100);
+				auto nextWrite = std::chrono::steady_clock::now();
+
+				while (!m_stop.load(std::memory_order_relaxed)) {
+					if (!m_options.path.empty() && std::chrono::steady_clock::now() >= nextWrite) {
+						writeFile(m_options.path);
+						nextWrite = std::chrono::steady_clock::now() + m_options.interval;
+					}
+
+#ifdef CHESS_HAS_SOCKETS
+					if (m_socket >= 0) {
+						pollfd descriptor = { m_socket, POLLIN, 0 };
+						if (::poll(&descriptor, 1, int(Tick.count())) > 0)
+							serve();
+						continue;
+					}
+#endif
+					std::this_thread::sleep_for(Tick);
+				}
+
+				if (!m_options.path.empty())
+					writeFile(m_options.path);
+			}
+
+		public:
+			/**
+			 * \throws std::runtime_error If the port cannot be bound.
+			 */
+			inline explicit Exporter(Options options) : m_options{ std::move(options) } {
+				if (m_options.port != 0) {
+#ifdef CHESS_HAS_SOCKETS
+					m_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+
+					const int reuse = 1;
+					::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+					sockaddr_in address = { };
+					address.sin_family = AF_INET;
+					address.sin_port = htons(m_options.port);
+					address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+					if (m_socket < 0 || ::bind(m_socket, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(m_socket, 16) != 0) {
+						if (m_socket >= 0)
+							::close(m_socket);
+						throw std::runtime_error("chess::metrics: cannot listen on port " + std::to_string(m_options.port));
+					}
+#else
+					throw std::runtime_error("chess::metrics: sockets are not supported on this platform");
+#endif
+				}
+
+				m_thread = std::thread([this]() { run(); });
+			}
+
+			Exporter(const Exporter&) = delete;
+			Exporter& operator=(const Exporter&) = delete;
+
+			inline ~Exporter() {
+				m_stop.store(true, std::memory_order_relaxed);
+				m_thread.join();
+
+#ifdef CHESS_HAS_SOCKETS
+				if (m_socket >= 0)
+					::close(m_socket);
+#endif
+			}
+		};
+	}
+}
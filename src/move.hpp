@@ -3,6 +3,7 @@
  */
 #pragma once
 #include "utils.hpp"
+#include <bit>
 
 namespace chess {
 	// Move representation from https://www.chessprogramming.org/Encoding_Moves
@@ -74,6 +75,43 @@ namespace chess {
 		return lhs.data() == rhs.data();
 	}
 
+	/**
+	 * A move together with the piece that moves and the piece it captures (Piece::None if it is
+	 * not a capture, the enemy pawn for en-passant). Move generation fills these in for callbacks
+	 * that take a WideMove, so making and unmaking it, and ordering it, need no mailbox lookups.
+	 *
+	 * Convert to the 16-bit Move with `move()` for compact storage, such as transposition tables,
+	 * and back with `Board::widen`.
+	 */
+	class WideMove {
+		uint32_t m_data;
+
+	public:
+		constexpr WideMove() : m_data{0} { }
+
+		constexpr WideMove(Move move, Piece moved, Piece captured) :
+			m_data{ uint32_t(move.data()) | uint32_t(moved) << 16 | uint32_t(captured) << 20 }
+		{ }
+
+		inline constexpr Move move() const noexcept { return std::bit_cast<Move>(uint16_t(m_data)); }
+		inline constexpr Piece movedPiece() const noexcept { return Piece((m_data >> 16) & 0xF); }
+		inline constexpr Piece capturedPiece() const noexcept { return Piece((m_data >> 20) & 0xF); }
+
+		inline constexpr int getTo() const noexcept { return move().getTo(); }
+		inline constexpr int getFrom() const noexcept { return move().getFrom(); }
+		inline constexpr MoveFlags getFlags() const noexcept { return move().getFlags(); }
+		inline constexpr bool isCapture() const noexcept { return move().isCapture(); }
+		inline constexpr bool isPromotion() const noexcept { return move().isPromotion(); }
+
+		inline constexpr uint32_t data() const noexcept { return m_data; }
+		inline constexpr bool isNull() const noexcept { return move().isNull(); }
+	};
+	static_assert(sizeof(WideMove) == sizeof(uint32_t));
+
+	inline constexpr bool operator==(const WideMove lhs, const WideMove rhs) {
+		return lhs.data() == rhs.data();
+	}
+
 	// UCI-compatible move representation
 	inline std::ostream& operator<<(std::ostream& os, const Move& move) {
 		os
@@ -91,4 +129,8 @@ namespace chess {
 
 		return os;
 	}
+
+	inline std::ostream& operator<<(std::ostream& os, const WideMove& move) {
+		return os << move.move();
+	}
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "movegen.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+/**
+ * @file Provides an optional cache of legal move lists, keyed by Zobrist hash.
+ *
+ * This is meant for game servers and analysis GUIs, which ask for the legal moves of
+ * the same position over and over again (rendering, validation, premoves...). A hit
+ * skips `legalMoves` entirely.
+ */
+namespace chess {
+	/**
+	 * Status flags of a position that only depend on the position itself. Rules that
+	 * depend on the history, like the 50-move rule or repetitions, are not included.
+	 */
+	enum class PositionStatus : uint8_t {
+		None = 0b000,
+		Check = 0b001,
+		Checkmate = 0b010,
+		Stalemate = 0b100
+	};
+
+	inline constexpr PositionStatus operator|(PositionStatus lhs, PositionStatus rhs) {
+		return PositionStatus(uint8_t(lhs) | uint8_t(rhs));
+	}
+
+	inline constexpr PositionStatus operator&(PositionStatus lhs, PositionStatus rhs) {
+		return PositionStatus(uint8_t(lhs) & uint8_t(rhs));
+	}
+
+	/**
+	 * A thread-safe, fixed-size legal move cache.
+	 *
+	 * \cond The cache is 8-way set associative. Each set is replaced with the CLOCK
+	 *       (second chance) policy: a hit sets the reference bit of the way, and the
+	 *       replacement hand skips (and clears) referenced ways. Sets are guarded by
+	 *       a striped array of reader-writer locks, so lookups run concurrently and
+	 *       only insertions take an exclusive lock.
+	 */
+	class MoveCache {
+		static constexpr size_t Ways = 8;
+		static constexpr size_t Stripes = 64;
+
+		struct Entry {
+			MoveList moves;
+			PositionStatus status;
+		};
+
+		struct alignas(64) Set {
+			zobrist::Key keys[Ways];
+			std::atomic<uint8_t> referenced;	/* one bit per way */
+			uint8_t occupied;					/* one bit per way */
+			uint8_t hand;						/* CLOCK hand */
+		};
+
+		struct alignas(64) Stripe {
+			std::shared_mutex mutex;
+		};
+
+		std::unique_ptr<Set[]> m_sets;
+		std::unique_ptr<Entry[]> m_entries;
+		std::unique_ptr<Stripe[]> m_stripes;
+		size_t m_setMask;
+
+		inline size_t setIndex(const zobrist::Key key) const noexcept {
+			return key & m_setMask;
+		}
+
+		inline std::shared_mutex& mutexFor(const size_t set) const noexcept {
+			return m_stripes[set & (Stripes - 1)].mutex;
+		}
+
+	public:
+		/**
+		 * \param capacity The maximum number of positions to store. This is rounded up to a power of two.
+		 */
+		explicit MoveCache(const size_t capacity = 4096) {
+			size_t sets = 1;
+			while (sets * Ways < capacity)
+				sets <<= 1;
+
+			m_sets = std::make_unique<Set[]>(sets);
+			m_entries = std::make_unique<Entry[]>(sets * Ways);
+			m_stripes = std::make_unique<Stripe[]>(Stripes);
+			m_setMask = sets - 1;
+
+			clear();
+		}
+
+		inline size_t capacity() const noexcept { return (m_setMask + 1) * Ways; }
+
+		/**
+		 * Removes all entries. This is not thread-safe.
+		 */
+		inline void clear() noexcept {
+			for (size_t i = 0; i <= m_setMask; ++i) {
+				m_sets[i].referenced.store(0, std::memory_order_relaxed);
+				m_sets[i].occupied = 0;
+				m_sets[i].hand = 0;
+			}
+		}
+
+		/**
+		 * \param key The Zobrist hash of the position.
+		 * \param moves The move list to fill on a hit.
+		 * \param status The position status to fill on a hit.
+		 * \returns True on a hit, false on a miss.
+		 */
+		inline bool probe(const zobrist::Key key, MoveList& moves, PositionStatus& status) const noexcept {
+			const size_t setIdx = setIndex(key);
+			Set& set = m_sets[setIdx];
+
+			std::shared_lock lock(mutexFor(setIdx));
+
+			for (size_t way = 0; way < Ways; ++way) {
+				if ((set.occupied >> way) & 1 && set.keys[way] == key) {
+					const Entry& entry = m_entries[setIdx * Ways + way];
+					moves = entry.moves;
+					status = entry.status;
+
+					set.referenced.fetch_or(uint8_t(1u << way), std::memory_order_relaxed);
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		/**
+		 * Stores a move list, evicting an entry of the same set if necessary.
+		 */
+		inline void store(const zobrist::Key key, const MoveList& moves, const PositionStatus status) noexcept {
+			const size_t setIdx = setIndex(key);
+			Set& set = m_sets[setIdx];
+
+			std::unique_lock lock(mutexFor(setIdx));
+
+			// Another thread may have inserted this position in the meantime
+			for (size_t way = 0; way < Ways; ++way)
+				if ((set.occupied >> way) & 1 && set.keys[way] == key)
+					return;
+
+			size_t way;
+			if (set.occupied != 0xFF) {
+				way = toSquare(~Bitboard(set.occupied));
+			} else {
+				// Second chance: clear reference bits until an unreferenced way comes up
+				for (;; set.hand = (set.hand + 1) % Ways) {
+					const uint8_t bit = uint8_t(1u << set.hand);
+					if ((set.referenced.load(std::memory_order_relaxed) & bit) == 0)
+						break;
+
+					set.referenced.fetch_and(uint8_t(~bit), std::memory_order_relaxed);
+				}
+
+				way = set.hand;
+				set.hand = (set.hand + 1) % Ways;
+			}
+
+			set.keys[way] = key;
+			set.occupied |= uint8_t(1u << way);
+			set.referenced.fetch_and(uint8_t(~(1u << way)), std::memory_order_relaxed);
+
+			Entry& entry = m_entries[setIdx * Ways + way];
+			entry.moves = moves;
+			entry.status = status;
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \param game The game to obtain legal moves for.
+		 * \param moves The move list to fill.
+		 * \returns The status of the position.
+		 *
+		 * Obtains the legal moves of the current position, out of the cache if possible. The
+		 * moves are in the same order as `movegen::legalMoves` would generate them.
+		 */
+		template <Color Color>
+		inline PositionStatus legalMoves(const Game& game, MoveList& moves) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			const zobrist::Key key = game.zobristHash();
+			PositionStatus status;
+
+			if (probe(key, moves, status))
+				return status;
+
+			moves.clear();
+			movegen::legalMoves<Color>(game, moves);
+
+			status = movegen::isCheck<Color>(game) ? PositionStatus::Check : PositionStatus::None;
+			if (moves.size() == 0)
+				status = status | (status == PositionStatus::Check ? PositionStatus::Checkmate : PositionStatus::Stalemate);
+
+			store(key, moves, status);
+			return status;
+		}
+	};
+}
@@ -19,6 +19,71 @@ namespace chess {
 
 				inline constexpr void operator()(auto&&) const noexcept { }
 			};
+
+			// Callbacks that take a WideMove, and not a Move, get the moving and captured pieces
+			template <typename Callback>
+			concept isWideMoveCallback =
+				std::is_invocable_v<std::remove_cvref_t<Callback>&, WideMove> &&
+				!std::is_invocable_v<std::remove_cvref_t<Callback>&, Move>;
+
+			template <typename Callback>
+			CHESS_ALWAYS_INLINE inline constexpr void emit(Callback& callback, const Move move, const Piece moved, const Piece captured) noexcept {
+				if constexpr (isWideMoveCallback<Callback>)
+					callback(WideMove{ move, moved, captured });
+				else
+					callback(move);
+			}
+
+			// Slider attacks of the moving pieces, straight from the lookup tables
+			struct LookupSliderAttacks {
+				CHESS_ALWAYS_INLINE inline constexpr Bitboard bishop(const int from, const Bitboard occupied) const noexcept {
+					return lookup::bishopAttack(from, occupied);
+				}
+
+				CHESS_ALWAYS_INLINE inline constexpr Bitboard rook(const int from, const Bitboard occupied) const noexcept {
+					return lookup::rookAttack(from, occupied);
+				}
+			};
+		}
+
+		/**
+		 * What a position contains, for move generation specialized at compile time. A missing flag
+		 * promises that the position has none of it, and the parts of the generator that handle it are
+		 * left out. Endgames like KNK or KRK have no pawns, and endgames like KPK no sliders.
+		 */
+		enum class MaterialClass : uint8_t {
+			None = 0,
+			Pawns = 1,			/* pawns of either color */
+			Sliders = 2,		/* bishops, rooks or queens of either color */
+			PawnsSliders = 3,
+			Castling = 4,		/* castling rights of the side to move */
+			PawnsCastling = 5,
+			SlidersCastling = 6,
+			Any = 7
+		};
+
+		inline constexpr MaterialClass operator|(const MaterialClass lhs, const MaterialClass rhs) noexcept {
+			return MaterialClass(uint8_t(lhs) | uint8_t(rhs));
+		}
+
+		inline constexpr bool includes(const MaterialClass material, const MaterialClass flag) noexcept {
+			return (uint8_t(material) & uint8_t(flag)) != 0;
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \returns The narrowest material class of the position.
+		 */
+		template <Color Color>
+		inline constexpr MaterialClass materialClass(const Game& game) noexcept {
+			const Board& board = game.board();
+			const Bitboard pawns = board.pawns<Color::White>() | board.pawns<Color::Black>();
+			const Bitboard sliders = board.bishops<Color::White>() | board.bishops<Color::Black>() |
+			                         board.rooks<Color::White>() | board.rooks<Color::Black>() |
+			                         board.queens<Color::White>() | board.queens<Color::Black>();
+			const CastlingFlags castling = game.castlingRights() & (kingsideCastleFlag<Color>() | queensideCastleFlag<Color>());
+
+			return MaterialClass(uint8_t(pawns != 0) | uint8_t(sliders != 0) << 1 | uint8_t(castling != CastlingFlags::None) << 2);
 		}
 
 		template <Color Color>
@@ -43,8 +108,8 @@ namespace chess {
 			return forward<~Color>(left & ~FileMask::hFile) << 1;
 		}
 
-		template <Color Color>
-		inline constexpr Bitboard computeCheckmask(const Game& game) noexcept {
+		template <Color Color, MaterialClass Material = MaterialClass::Any, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr Bitboard computeCheckmask(const Game& game, const SliderAttacks& sliderAttacks = { }) noexcept {
 			// ================================ EXPLANATION OF CONCEPT ================================
 			//
 			// The checkmask is a key part of legal move detection. Essentially, when a king is in check,
@@ -76,25 +141,27 @@ namespace chess {
 			// You may think that two of the same slider will never double check a king, but this is wrong.
 			// Consider promotion as an edge case. However, it is assumed that two bishops cannot perform
 			// a double check.
-			const Bitboard rookAttack = lookup::rookAttack(square, board.occupied());
-			if (const Bitboard checker = rookAttack & (enemyRooks | enemyQueens)) {
-				// The reason why double check can happen with two rook sliders:
-				//   https://lichess.org/editor/4kn2/4P3/8/8/4Q3/4K3/8/8_w_-_-_0_1?color=white (e7f8q)
-				if ((checker & (checker - 1)) != 0) {
-					checkmask = 0;
-				} else {
-					// The checkmask should not contain the king but should contain the checking piece.
-					checkmask &= rookAttack & (lookup::rookAttack(toSquare(checker), board.occupied()) | checker);
+			if constexpr (includes(Material, MaterialClass::Sliders)) {
+				const Bitboard rookAttack = sliderAttacks.rook(square, board.occupied());
+				if (const Bitboard checker = rookAttack & (enemyRooks | enemyQueens)) {
+					// The reason why double check can happen with two rook sliders:
+					//   https://lichess.org/editor/4kn2/4P3/8/8/4Q3/4K3/8/8_w_-_-_0_1?color=white (e7f8q)
+					if ((checker & (checker - 1)) != 0) {
+						checkmask = 0;
+					} else {
+						// The checkmask should not contain the king but should contain the checking piece.
+						checkmask &= rookAttack & (sliderAttacks.rook(toSquare(checker), board.occupied()) | checker);
+					}
 				}
-			}
 
-			// Check for bishop attacks.
-			const Bitboard bishopAttack = lookup::bishopAttack(square, board.occupied());
-			if (const Bitboard checker = bishopAttack & (enemyBishops | enemyQueens)) {
-				// Two bishop attacks at once can never happen
-				CHESS_ASSERT((checker & (checker - 1)) == 0);
-				
-				checkmask &= bishopAttack & (lookup::bishopAttack(toSquare(checker), board.occupied()) | checker);
+				// Check for bishop attacks.
+				const Bitboard bishopAttack = sliderAttacks.bishop(square, board.occupied());
+				if (const Bitboard checker = bishopAttack & (enemyBishops | enemyQueens)) {
+					// Two bishop attacks at once can never happen
+					CHESS_ASSERT((checker & (checker - 1)) == 0);
+					
+					checkmask &= bishopAttack & (sliderAttacks.bishop(toSquare(checker), board.occupied()) | checker);
+				}
 			}
 
 			// If a knight is checking the king, then the checkmask will be just that knight.
@@ -109,11 +176,13 @@ namespace chess {
 			}
 
 			// Same thing as with knights, but this time with pawns.
-			const Bitboard pawnAttack = leftPawnAttack<Color>(king) | rightPawnAttack<Color>(king);
-			if (const Bitboard checker = pawnAttack & enemyPawns) {
-				CHESS_ASSERT((checker & (checker - 1)) == 0);
+			if constexpr (includes(Material, MaterialClass::Pawns)) {
+				const Bitboard pawnAttack = leftPawnAttack<Color>(king) | rightPawnAttack<Color>(king);
+				if (const Bitboard checker = pawnAttack & enemyPawns) {
+					CHESS_ASSERT((checker & (checker - 1)) == 0);
 
-				checkmask &= checker;
+					checkmask &= checker;
+				}
 			}
 			
 			// The king will never check the opposing king, so checking for that is unnecessary.
@@ -123,16 +192,18 @@ namespace chess {
 
 		// This function outputs the squares that the enemy attacks without considering the king.
 		// That is, attacks can go through the king.
-		template <Color Color>
-		inline constexpr Bitboard computeAttackedWithoutKing(const Game& game) noexcept {
+		template <Color Color, MaterialClass Material = MaterialClass::Any, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr Bitboard computeAttackedWithoutKing(const Game& game, const SliderAttacks& sliderAttacks = { }) noexcept {
 			const Board& board = game.board();
 			const Bitboard king = board.kings<Color>();
 			Bitboard banned = 0;
 
 			// Calculate attack from enemy pawns
-			const Bitboard pl = leftPawnAttack<~Color>(board.pawns<~Color>());
-			const Bitboard pr = rightPawnAttack<~Color>(board.pawns<~Color>());
-			banned |= pl | pr;
+			if constexpr (includes(Material, MaterialClass::Pawns)) {
+				const Bitboard pl = leftPawnAttack<~Color>(board.pawns<~Color>());
+				const Bitboard pr = rightPawnAttack<~Color>(board.pawns<~Color>());
+				banned |= pl | pr;
+			}
 
 			// Calculate attack from enemy king
 			banned |= lookup::kingAttack(toSquare(board.kings<~Color>()));
@@ -142,36 +213,38 @@ namespace chess {
 			while (enemyKnights != 0)
 				banned |= lookup::knightAttack(popLSB(enemyKnights));
 
-			// Calculate attack from enemy bishops (do not include king, to stop king from going backwards but still in check)
-			// (XOR is used instead of &~ as micro-optimization)
-			Bitboard enemyBishops = board.bishops<~Color>() | board.queens<~Color>();
-			while (enemyBishops != 0)
-				banned |= lookup::bishopAttack(popLSB(enemyBishops), board.occupied() ^ king);
-
-			// Calculate attack from enemy rooks
-			Bitboard enemyRooks = board.rooks<~Color>() | board.queens<~Color>();
-			while (enemyRooks != 0)
-				banned |= lookup::rookAttack(popLSB(enemyRooks), board.occupied() ^ king);
+			if constexpr (includes(Material, MaterialClass::Sliders)) {
+				// Calculate attack from enemy bishops (do not include king, to stop king from going backwards but still in check)
+				// (XOR is used instead of &~ as micro-optimization)
+				Bitboard enemyBishops = board.bishops<~Color>() | board.queens<~Color>();
+				while (enemyBishops != 0)
+					banned |= sliderAttacks.bishop(popLSB(enemyBishops), board.occupied() ^ king);
+
+				// Calculate attack from enemy rooks
+				Bitboard enemyRooks = board.rooks<~Color>() | board.queens<~Color>();
+				while (enemyRooks != 0)
+					banned |= sliderAttacks.rook(popLSB(enemyRooks), board.occupied() ^ king);
+			}
 			
 			// Compute king legal moves
 			return banned;
 		}
 
 		// This function outputs a mask of the current horizontal or vertical pin paths through relevant pinned pieces.
-		template <Color Color>
-		inline constexpr Bitboard computeHorizontalVerticalPinmask(const Game& game) noexcept {
+		template <Color Color, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr Bitboard computeHorizontalVerticalPinmask(const Game& game, const SliderAttacks& sliderAttacks = { }) noexcept {
 			const Board& board = game.board();
 			const Bitboard king = board.kings<Color>();
 			const int kingSquare = toSquare(king);
 			const Bitboard enemyRooks = board.rooks<~Color>() | board.queens<~Color>();
 
 			// All potentially horizontally or vertically pinned pieces
-			const Bitboard probe = lookup::rookAttack(kingSquare, board.occupied());
+			const Bitboard probe = sliderAttacks.rook(kingSquare, board.occupied());
 			const Bitboard potentiallyPinned = probe & board.occupancy<Color>();
 
 			// Look through those pinned pieces for enemy rooks, like an X-ray
 			// Pieces that check the king directly would have been caught by the first probe, so discard those pieces
-			const Bitboard xray = lookup::rookAttack(kingSquare, board.occupied() & ~potentiallyPinned);
+			const Bitboard xray = sliderAttacks.rook(kingSquare, board.occupied() & ~potentiallyPinned);
 			Bitboard pinners = xray & enemyRooks & ~probe;
 
 			// Look through each pinner
@@ -180,18 +253,18 @@ namespace chess {
 				const int pinnerSquare = popLSB(pinners);
 
 				// If the pinner is attacking a potentially pinned piece, then that piece is surely pinned
-				const Bitboard pinnedPieceSpot = lookup::rookAttack(pinnerSquare, board.occupied()) & potentiallyPinned;
+				const Bitboard pinnedPieceSpot = sliderAttacks.rook(pinnerSquare, board.occupied()) & potentiallyPinned;
 				
 				// Obtain the path of the pin in a clever way
-				pinmask |= (lookup::rookAttack(toSquare(pinnedPieceSpot), board.occupied()) | pinnedPieceSpot) & xray;
+				pinmask |= (sliderAttacks.rook(toSquare(pinnedPieceSpot), board.occupied()) | pinnedPieceSpot) & xray;
 			}
 
 			return pinmask;
 		}
 
 		// This function outputs a mask of the current diagonal pin paths through relevant pinned pieces.
-		template <Color Color>
-		inline constexpr Bitboard computeDiagonalPinmask(const Game& game) noexcept {
+		template <Color Color, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr Bitboard computeDiagonalPinmask(const Game& game, const SliderAttacks& sliderAttacks = { }) noexcept {
 			// This function is essentially just the same logic as the similar computeHVPinmask function,
 			// so I will skip commenting this.
 
@@ -200,25 +273,40 @@ namespace chess {
 			const int kingSquare = toSquare(king);
 			const Bitboard enemyBishops = board.bishops<~Color>() | board.queens<~Color>();
 
-			const Bitboard probe = lookup::bishopAttack(kingSquare, board.occupied());
+			const Bitboard probe = sliderAttacks.bishop(kingSquare, board.occupied());
 			const Bitboard potentiallyPinned = probe & board.occupancy<Color>();
 
-			const Bitboard xray = lookup::bishopAttack(kingSquare, board.occupied() & ~potentiallyPinned);
+			const Bitboard xray = sliderAttacks.bishop(kingSquare, board.occupied() & ~potentiallyPinned);
 			Bitboard pinners = xray & enemyBishops & ~probe;
 
 			Bitboard pinmask = 0;
 			while (pinners != 0) {
-				const Bitboard pinnedPieceSpot = lookup::bishopAttack(popLSB(pinners), board.occupied()) & potentiallyPinned;
+				const Bitboard pinnedPieceSpot = sliderAttacks.bishop(popLSB(pinners), board.occupied()) & potentiallyPinned;
 
-				pinmask |= (lookup::bishopAttack(toSquare(pinnedPieceSpot), board.occupied()) | pinnedPieceSpot) & xray;
+				pinmask |= (sliderAttacks.bishop(toSquare(pinnedPieceSpot), board.occupied()) | pinnedPieceSpot) & xray;
 			}
 
 			return pinmask;
 		}
 
-		template <Color Color, typename Callback>
-		inline constexpr void legalMoves(const Game& game, Callback&& callback) noexcept {
+		/**
+		 * \tparam Color The current turn.
+		 * \param game The position to generate moves for.
+		 * \param callback Called with every legal move, or a move counter. Callbacks that take a WideMove
+		 *                 (and not a Move) get the moving and captured pieces along with the move.
+		 * \param sliderAttacks Provides every slider attack of the generation, including those of the
+		 *                      checkmask and pinmasks. This is an extension point for other attack
+		 *                      lookups, such as the slider index selected once by dispatch.hpp.
+		 * \tparam Material What the position may contain; see `legalMovesByMaterial` to choose it at runtime.
+		 */
+		template <Color Color, MaterialClass Material = MaterialClass::Any, typename Callback, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr void legalMoves(const Game& game, Callback&& callback, const SliderAttacks& sliderAttacks = { }) noexcept {
 			CHESS_PROFILE;
+			CHESS_METRIC_SCOPE(LegalMoves);
+			CHESS_TRACE_EVENT(LegalMoves, game, detail::isMoveCounter<Callback>);
+
+			constexpr Piece pawn = makePiece(PieceType::Pawn, Color);
+			constexpr Piece enemyPawn = makePiece(PieceType::Pawn, ~Color);
 
 			// Obtain all pieces
 			const Board& board = game.board();
@@ -230,17 +318,20 @@ namespace chess {
 			const Bitboard king = board.kings<Color>();
 
 			// Compute checkmask
-			const Bitboard checkmask = computeCheckmask<Color>(game);
+			const Bitboard checkmask = computeCheckmask<Color, Material>(game, sliderAttacks);
 
-			// Compute pinmasks
-			const Bitboard pinHV = computeHorizontalVerticalPinmask<Color>(game);
-			const Bitboard pinD = computeDiagonalPinmask<Color>(game);
+			// Compute pinmasks, only sliders pin
+			Bitboard pinHV = 0, pinD = 0;
+			if constexpr (includes(Material, MaterialClass::Sliders)) {
+				pinHV = computeHorizontalVerticalPinmask<Color>(game, sliderAttacks);
+				pinD = computeDiagonalPinmask<Color>(game, sliderAttacks);
+			}
 
 			// Obtain the squares that are moveable to for non-pawn non-king pieces
 			const Bitboard moveable = ~board.occupancy<Color>() & checkmask;
 
 			// Generate legal pawn moves
-			{
+			if constexpr (includes(Material, MaterialClass::Pawns)) {
 				// Obtain pawns that are not pinned (in certain directions)
 				const Bitboard pawnsUHV = pawns & ~pinHV;
 				const Bitboard pawnsUD = pawns & ~pinD;
@@ -314,8 +405,8 @@ namespace chess {
 						Bitboard leftEP = pawnsUHV & ~FileMask::aFile & ((epTarget & checkmask) << 1);
 						Bitboard rightEP = pawnsUHV & ~FileMask::hFile & ((epTarget & checkmask) >> 1);
 
-						if ((leftEP | rightEP) != 0 && ((leftEP != 0 && rightEP != 0) ||
-							(lookup::rookAttack(toSquare(king), board.occupied() ^ (leftEP | rightEP | epSpot | epTarget)) &
+						if ((leftEP | rightEP) != 0 && ((leftEP != 0 && rightEP != 0) || !includes(Material, MaterialClass::Sliders) ||
+							(sliderAttacks.rook(toSquare(king), board.occupied() ^ (leftEP | rightEP | epSpot | epTarget)) &
 								(board.rooks<~Color>() | board.queens<~Color>())) == 0)) {
 							leftEP = (leftEP & pinD & reverseLeftPawnAttack<Color>(pinD)) | (leftEP & ~pinD);
 							rightEP = (rightEP & pinD & reverseRightPawnAttack<Color>(pinD)) | (rightEP & ~pinD);
@@ -345,15 +436,15 @@ namespace chess {
 						//
 						// When removing both pawns, we place a pawn on the en-passant capture spot
 						// because we do not check for the pin position.
-						if ((leftEP | rightEP) != 0 && ((leftEP != 0 && rightEP != 0) ||
-							(lookup::rookAttack(toSquare(king), board.occupied() ^ (leftEP | rightEP | epSpot | epTarget)) &
+						if ((leftEP | rightEP) != 0 && ((leftEP != 0 && rightEP != 0) || !includes(Material, MaterialClass::Sliders) ||
+							(sliderAttacks.rook(toSquare(king), board.occupied() ^ (leftEP | rightEP | epSpot | epTarget)) &
 								(board.rooks<~Color>() | board.queens<~Color>())) == 0)) {
 							// Prune away pinned en-passant captures.
 							leftEP = (leftEP & pinD & reverseLeftPawnAttack<Color>(pinD)) | (leftEP & ~pinD);
 							rightEP = (rightEP & pinD & reverseRightPawnAttack<Color>(pinD)) | (rightEP & ~pinD);
 
-							if (leftEP) callback(Move{toSquare(leftEP), epSquare, MoveFlags::EnPassantCapture});
-							if (rightEP) callback(Move{toSquare(rightEP), epSquare, MoveFlags::EnPassantCapture});
+							if (leftEP) detail::emit(callback, Move{toSquare(leftEP), epSquare, MoveFlags::EnPassantCapture}, pawn, enemyPawn);
+							if (rightEP) detail::emit(callback, Move{toSquare(rightEP), epSquare, MoveFlags::EnPassantCapture}, pawn, enemyPawn);
 						}
 					}
 
@@ -362,58 +453,58 @@ namespace chess {
 						const int from = popLSB(quiet);
 						const int to = forwardSquare<Color>(from);
 
-						callback(Move{from, to, MoveFlags::QuietMove});
+						detail::emit(callback, Move{from, to, MoveFlags::QuietMove}, pawn, Piece::None);
 					}
 
 					while (doublePush != 0) {
 						const int from = popLSB(doublePush);
 						const int to = doubleForwardSquare<Color>(from);
 
-						callback(Move{from, to, MoveFlags::DoublePawnPush});
+						detail::emit(callback, Move{from, to, MoveFlags::DoublePawnPush}, pawn, Piece::None);
 					}
 
 					while (leftCapture != 0) {
 						const int from = popLSB(leftCapture);
 						const int to = forwardSquare<Color>(from) - 1;
 
-						callback(Move{from, to, MoveFlags::Capture});
+						detail::emit(callback, Move{from, to, MoveFlags::Capture}, pawn, board.pieceAt(to));
 					}
 
 					while (rightCapture != 0) {
 						const int from = popLSB(rightCapture);
 						const int to = forwardSquare<Color>(from) + 1;
 
-						callback(Move{from, to, MoveFlags::Capture});
+						detail::emit(callback, Move{from, to, MoveFlags::Capture}, pawn, board.pieceAt(to));
 					}
 
 					while (quietPromotion != 0) {
 						const int from = popLSB(quietPromotion);
 						const int to = forwardSquare<Color>(from);
 
-						callback(Move{from, to, MoveFlags::QueenPromotion});
-						callback(Move{from, to, MoveFlags::RookPromotion});
-						callback(Move{from, to, MoveFlags::KnightPromotion});
-						callback(Move{from, to, MoveFlags::BishopPromotion});
+						detail::emit(callback, Move{from, to, MoveFlags::QueenPromotion}, pawn, Piece::None);
+						detail::emit(callback, Move{from, to, MoveFlags::RookPromotion}, pawn, Piece::None);
+						detail::emit(callback, Move{from, to, MoveFlags::KnightPromotion}, pawn, Piece::None);
+						detail::emit(callback, Move{from, to, MoveFlags::BishopPromotion}, pawn, Piece::None);
 					}
 
 					while (leftCapturePromotion != 0) {
 						const int from = popLSB(leftCapturePromotion);
 						const int to = forwardSquare<Color>(from) - 1;
 
-						callback(Move{from, to, MoveFlags::QueenPromotionCapture});
-						callback(Move{from, to, MoveFlags::RookPromotionCapture});
-						callback(Move{from, to, MoveFlags::KnightPromotionCapture});
-						callback(Move{from, to, MoveFlags::BishopPromotionCapture});
+						detail::emit(callback, Move{from, to, MoveFlags::QueenPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::RookPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::KnightPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::BishopPromotionCapture}, pawn, board.pieceAt(to));
 					}
 
 					while (rightCapturePromotion != 0) {
 						const int from = popLSB(rightCapturePromotion);
 						const int to = forwardSquare<Color>(from) + 1;
 
-						callback(Move{from, to, MoveFlags::QueenPromotionCapture});
-						callback(Move{from, to, MoveFlags::RookPromotionCapture});
-						callback(Move{from, to, MoveFlags::KnightPromotionCapture});
-						callback(Move{from, to, MoveFlags::BishopPromotionCapture});
+						detail::emit(callback, Move{from, to, MoveFlags::QueenPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::RookPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::KnightPromotionCapture}, pawn, board.pieceAt(to));
+						detail::emit(callback, Move{from, to, MoveFlags::BishopPromotionCapture}, pawn, board.pieceAt(to));
 					}
 				}
 			}
@@ -437,7 +528,7 @@ namespace chess {
 							// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 							const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-							callback(Move{from, to, moveFlag});
+							detail::emit(callback, Move{from, to, moveFlag}, makePiece(PieceType::Knight, Color), board.pieceAt(to));
 						}
 					}
 				}
@@ -445,7 +536,7 @@ namespace chess {
 
 			// Generate legal bishop moves -- I have folded queens into this for extra optimization!
 			// This makes queen legal move generation add essentially zero overhead!
-			{
+			if constexpr (includes(Material, MaterialClass::Sliders)) {
 				// We can prune away the bishops that are pinned horizontally or vertically, as those can't really move
 				const Bitboard bishopsQueens = (bishops | queens) & ~pinHV;
 				Bitboard unpinnedBishops = bishopsQueens & ~pinD;
@@ -455,19 +546,22 @@ namespace chess {
 				while (unpinnedBishops != 0) {
 					const int from = popLSB(unpinnedBishops);
 
-					Bitboard legal = lookup::bishopAttack(from, board.occupied()) & moveable;
+					Bitboard legal = sliderAttacks.bishop(from, board.occupied()) & moveable;
 					
 					// ================== MOVE COUNT ==================
 					if constexpr (detail::isMoveCounter<Callback>) {
 						callback.count += popcount(legal);
 					} else {
+						// Queens are folded in, so the moving piece depends on the square
+						const Piece moved = ((queens >> from) & 1) ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Bishop, Color);
+
 						while (legal != 0) {
 							const int to = popLSB(legal);
 
 							// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 							const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-							callback(Move{from, to, moveFlag});
+							detail::emit(callback, Move{from, to, moveFlag}, moved, board.pieceAt(to));
 						}
 					}
 				}
@@ -476,26 +570,29 @@ namespace chess {
 					const int from = popLSB(pinnedBishops);
 
 					// Pinned bishops along diagonal can only move along the diagonal pinmask
-					Bitboard legal = lookup::bishopAttack(from, board.occupied()) & moveable & pinD;
+					Bitboard legal = sliderAttacks.bishop(from, board.occupied()) & moveable & pinD;
 					
 					// ================== MOVE COUNT ==================
 					if constexpr (detail::isMoveCounter<Callback>) {
 						callback.count += popcount(legal);
 					} else {
+						// Queens are folded in, so the moving piece depends on the square
+						const Piece moved = ((queens >> from) & 1) ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Bishop, Color);
+
 						while (legal != 0) {
 							const int to = popLSB(legal);
 
 							// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 							const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-							callback(Move{from, to, moveFlag});
+							detail::emit(callback, Move{from, to, moveFlag}, moved, board.pieceAt(to));
 						}
 					}
 				}
 			}
 
 			// Generate legal rook moves
-			{
+			if constexpr (includes(Material, MaterialClass::Sliders)) {
 				// We can prune away the rooks that are pinned diagonally since those cannot move
 				const Bitboard rooksQueens = (rooks | queens) & ~pinD;
 				Bitboard unpinnedRooks = rooksQueens & ~pinHV;
@@ -505,19 +602,22 @@ namespace chess {
 				while (unpinnedRooks != 0) {
 					const int from = popLSB(unpinnedRooks);
 
-					Bitboard legal = lookup::rookAttack(from, board.occupied()) & moveable;
+					Bitboard legal = sliderAttacks.rook(from, board.occupied()) & moveable;
 					
 					// ================== MOVE COUNT ==================
 					if constexpr (detail::isMoveCounter<Callback>) {
 						callback.count += popcount(legal);
 					} else {
+						// Queens are folded in, so the moving piece depends on the square
+						const Piece moved = ((queens >> from) & 1) ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Rook, Color);
+
 						while (legal != 0) {
 							const int to = popLSB(legal);
 
 							// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 							const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-							callback(Move{from, to, moveFlag});
+							detail::emit(callback, Move{from, to, moveFlag}, moved, board.pieceAt(to));
 						}
 					}
 				}
@@ -526,19 +626,22 @@ namespace chess {
 					const int from = popLSB(pinnedRooks);
 
 					// Horizontally or vertically pinned rooks can only move along the relevant pinmask
-					Bitboard legal = lookup::rookAttack(from, board.occupied()) & moveable & pinHV;
+					Bitboard legal = sliderAttacks.rook(from, board.occupied()) & moveable & pinHV;
 					
 					// ================== MOVE COUNT ==================
 					if constexpr (detail::isMoveCounter<Callback>) {
 						callback.count += popcount(legal);
 					} else {
+						// Queens are folded in, so the moving piece depends on the square
+						const Piece moved = ((queens >> from) & 1) ? makePiece(PieceType::Queen, Color) : makePiece(PieceType::Rook, Color);
+
 						while (legal != 0) {
 							const int to = popLSB(legal);
 
 							// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 							const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-							callback(Move{from, to, moveFlag});
+							detail::emit(callback, Move{from, to, moveFlag}, moved, board.pieceAt(to));
 						}
 					}
 				}
@@ -546,7 +649,7 @@ namespace chess {
 
 			// Generate legal king moves
 			{
-				const Bitboard banned = computeAttackedWithoutKing<Color>(game);
+				const Bitboard banned = computeAttackedWithoutKing<Color, Material>(game, sliderAttacks);
 
 				const int kingSquare = toSquare(king);
 				Bitboard kingMoves = ~banned & lookup::kingAttack(kingSquare) & ~board.occupancy<Color>();
@@ -574,26 +677,26 @@ namespace chess {
 					// our king, which makes (banned) good for use in castling attacked square detection.
 					//
 					// We can reduce all of the above to one operation: (banned & shouldNotAttacked)
-					if ((game.castlingRights() & kingsideCastleFlag<Color>()) != CastlingFlags::None &&
+					if (includes(Material, MaterialClass::Castling) && (game.castlingRights() & kingsideCastleFlag<Color>()) != CastlingFlags::None &&
 					    (shouldUnoccupiedKingside & board.occupied()) == 0 &&
 						(shouldNotAttackedKingside & banned) == 0)
 						++callback.count;
 					
-					if ((game.castlingRights() & queensideCastleFlag<Color>()) != CastlingFlags::None &&
+					if (includes(Material, MaterialClass::Castling) && (game.castlingRights() & queensideCastleFlag<Color>()) != CastlingFlags::None &&
 					    (shouldUnoccupiedQueenside & board.occupied()) == 0 &&
 						(shouldNotAttackedQueenside & banned) == 0)
 						++callback.count;
 				} else {
-					if ((game.castlingRights() & kingsideCastleFlag<Color>()) != CastlingFlags::None &&
+					if (includes(Material, MaterialClass::Castling) && (game.castlingRights() & kingsideCastleFlag<Color>()) != CastlingFlags::None &&
 					    (shouldUnoccupiedKingside & board.occupied()) == 0 &&
 						(shouldNotAttackedKingside & banned) == 0) {
-						callback(Move{kingSquare, kingSquare + 2, MoveFlags::KingCastle});
+						detail::emit(callback, Move{kingSquare, kingSquare + 2, MoveFlags::KingCastle}, makePiece(PieceType::King, Color), Piece::None);
 					}
 
-					if ((game.castlingRights() & queensideCastleFlag<Color>()) != CastlingFlags::None &&
+					if (includes(Material, MaterialClass::Castling) && (game.castlingRights() & queensideCastleFlag<Color>()) != CastlingFlags::None &&
 					    (shouldUnoccupiedQueenside & board.occupied()) == 0 &&
 						(shouldNotAttackedQueenside & banned) == 0) {
-						callback(Move{kingSquare, kingSquare - 2, MoveFlags::QueenCastle});
+						detail::emit(callback, Move{kingSquare, kingSquare - 2, MoveFlags::QueenCastle}, makePiece(PieceType::King, Color), Piece::None);
 					}
 
 					while (kingMoves != 0) {
@@ -602,12 +705,33 @@ namespace chess {
 						// Determine if the move is a capture or not, and compute the relevant move flag, completely branchless
 						const MoveFlags moveFlag = static_cast<MoveFlags>(((board.occupancy<~Color>() >> to) & 1ull) << 2);
 
-						callback(Move{kingSquare, to, moveFlag});
+						detail::emit(callback, Move{kingSquare, to, moveFlag}, makePiece(PieceType::King, Color), board.pieceAt(to));
 					}
 				}
 			}
 		}
 
+		/**
+		 * Like `legalMoves`, but generates with the variant specialized for the material class of the
+		 * position, leaving out the pawn, slider or castling code it has no use for. The class costs a
+		 * few bitboard ORs to find, which endgame positions more than win back.
+		 */
+		template <Color Color, typename Callback, typename SliderAttacks = detail::LookupSliderAttacks>
+		inline constexpr void legalMovesByMaterial(const Game& game, Callback&& callback, const SliderAttacks& sliderAttacks = { }) noexcept {
+			using enum MaterialClass;
+
+			switch (materialClass<Color>(game)) {
+				case None:                       return legalMoves<Color, None>(game, callback, sliderAttacks);
+				case Pawns:                      return legalMoves<Color, Pawns>(game, callback, sliderAttacks);
+				case Sliders:                    return legalMoves<Color, Sliders>(game, callback, sliderAttacks);
+				case PawnsSliders:               return legalMoves<Color, PawnsSliders>(game, callback, sliderAttacks);
+				case Castling:                   return legalMoves<Color, Castling>(game, callback, sliderAttacks);
+				case PawnsCastling:              return legalMoves<Color, PawnsCastling>(game, callback, sliderAttacks);
+				case SlidersCastling:            return legalMoves<Color, SlidersCastling>(game, callback, sliderAttacks);
+				case Any:                        return legalMoves<Color, Any>(game, callback, sliderAttacks);
+			}
+		}
+
 		template <Color Color>
 		inline constexpr uint64_t legalMoveCount(const Game& game) noexcept {
 			detail::MoveCounter moveCounter;
@@ -7,9 +7,9 @@
 #include <algorithm>
 
 namespace chess {
-	template <size_t MaxMoves>
+	template <size_t MaxMoves, typename MoveType = Move>
 	class StaticMoveList {
-		Move m_moves[MaxMoves];
+		MoveType m_moves[MaxMoves];
 		size_t m_count;
 
 	public:
@@ -19,11 +19,11 @@ namespace chess {
 			return m_count;
 		}
 
-		CHESS_ALWAYS_INLINE inline constexpr void add(Move move) noexcept {
+		CHESS_ALWAYS_INLINE inline constexpr void add(MoveType move) noexcept {
 			m_moves[m_count++] = move;
 		}
 
-		inline Move random() const noexcept {
+		inline MoveType random() const noexcept {
 			if (m_count == 0)
 				return { };
 
@@ -40,7 +40,7 @@ namespace chess {
 		}
 
 		// Support as callable
-		inline constexpr void operator()(Move move) noexcept {
+		inline constexpr void operator()(MoveType move) noexcept {
 			add(move);
 		}
 
@@ -50,39 +50,40 @@ namespace chess {
 		}
 
 		// Iterator support
-		inline constexpr Move* begin() noexcept {
+		inline constexpr MoveType* begin() noexcept {
 			return m_moves;
 		}
 
-		inline constexpr Move* end() noexcept {
+		inline constexpr MoveType* end() noexcept {
 			return m_moves + m_count;
 		}
 
-		inline constexpr const Move* begin() const noexcept {
+		inline constexpr const MoveType* begin() const noexcept {
 			return m_moves;
 		}
 
-		inline constexpr const Move* end() const noexcept {
+		inline constexpr const MoveType* end() const noexcept {
 			return m_moves + m_count;
 		}
 
-		inline constexpr const Move* cbegin() const noexcept {
+		inline constexpr const MoveType* cbegin() const noexcept {
 			return m_moves;
 		}
 
-		inline constexpr const Move* cend() const noexcept {
+		inline constexpr const MoveType* cend() const noexcept {
 			return m_moves + m_count;
 		}
 
 		// Indexing support
-		inline constexpr Move& operator[](size_t index) noexcept {
+		inline constexpr MoveType& operator[](size_t index) noexcept {
 			return m_moves[index];
 		}
 
-		inline constexpr const Move& operator[](size_t index) const noexcept {
+		inline constexpr const MoveType& operator[](size_t index) const noexcept {
 			return m_moves[index];
 		}
 	};
 
 	using MoveList = StaticMoveList<218>;
+	using WideMoveList = StaticMoveList<218, WideMove>;
 }
\ No newline at end of file
@@ -0,0 +1,414 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "game.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#	define CHESS_HAS_MMAP
+#else
+#	include <fstream>
+#endif
+
+/**
+ * @file Provides a compact fixed-size position encoding, and direct conversion of FEN and
+ *       EPD text into it (and into Zobrist keys) without setting up a Game.
+ *
+ * Setting up a Game means building the board, the incremental state, and the 512-entry
+ * history, which is wasted work for jobs that only need a key or a packed record per line,
+ * like deduplication and indexing. The functions here make one pass over the text instead.
+ */
+namespace chess {
+	namespace packed {
+		/**
+		 * A position in 32 bytes. The pieces are stored as 4-bit `Piece` values, in increasing
+		 * square order of the occupied squares (the low nibble first).
+		 */
+		struct Position {
+			Bitboard occupied;
+			uint8_t pieces[16];
+			uint8_t state;				/* CastlingFlags in bits 0-3, the side to move in bit 7 */
+			uint8_t enPassantSquare;	/* Square::None (64) if none */
+			uint16_t halfMoveCounter;
+			uint16_t fullMoveCount;
+			uint16_t reserved;
+
+			inline constexpr Color turn() const noexcept { return Color(state >> 7); }
+			inline constexpr CastlingFlags castlingRights() const noexcept { return CastlingFlags(state & 0b1111); }
+
+			inline constexpr Piece pieceAt(const size_t index) const noexcept {
+				return Piece((pieces[index >> 1] >> ((index & 1) * 4)) & 0b1111);
+			}
+
+			inline constexpr bool operator==(const Position&) const noexcept = default;
+		};
+		static_assert(sizeof(Position) == 32);
+
+		namespace detail {
+			inline constexpr Piece pieceFromChar(const char chr) noexcept {
+				switch (chr) {
+					case 'P': return Piece::WhitePawn;
+					case 'N': return Piece::WhiteKnight;
+					case 'B': return Piece::WhiteBishop;
+					case 'R': return Piece::WhiteRook;
+					case 'Q': return Piece::WhiteQueen;
+					case 'K': return Piece::WhiteKing;
+					case 'p': return Piece::BlackPawn;
+					case 'n': return Piece::BlackKnight;
+					case 'b': return Piece::BlackBishop;
+					case 'r': return Piece::BlackRook;
+					case 'q': return Piece::BlackQueen;
+					case 'k': return Piece::BlackKing;
+					default: return Piece::None;
+				}
+			}
+
+			inline constexpr char pieceToChar(const Piece piece) noexcept {
+				return "PNBRQK??pnbrqk"[(size_t)piece];
+			}
+
+			// Parses an unsigned number at `i`, if there is one.
+			inline constexpr bool parseNumber(const std::string_view text, size_t& i, uint16_t& number) noexcept {
+				if (i >= text.size() || text[i] < '0' || text[i] > '9')
+					return false;
+
+				number = 0;
+				for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i)
+					number = uint16_t(number * 10 + (text[i] - '0'));
+
+				return true;
+			}
+		}
+
+		/**
+		 * \param fen The FEN string, or an EPD line (whose missing clocks become 0 and 1). The
+		 *            position part must be valid.
+		 * \returns The packed position.
+		 *
+		 * Packs a FEN string in one pass over it.
+		 */
+		inline constexpr Position packFEN(const std::string_view fen) noexcept {
+			Position position{ };
+			Piece board[64]{ };
+			size_t i = 0;
+
+			// 1. Piece placement
+			for (int row = 7, col = 0; i < fen.size() && fen[i] != ' '; ++i) {
+				const char chr = fen[i];
+
+				if (chr == '/') {
+					col = 0;
+					--row;
+				} else if (chr >= '1' && chr <= '8') {
+					col += chr - '0';
+				} else {
+					const int square = col + row * 8;
+					board[square] = detail::pieceFromChar(chr);
+					position.occupied |= 1ull << square;
+					++col;
+				}
+			}
+			++i;
+
+			size_t count = 0;
+			for (Bitboard b = position.occupied; b && count < 32; ++count)
+				position.pieces[count >> 1] |= uint8_t((size_t)board[popLSB(b)] << ((count & 1) * 4));
+
+			// 2. Active color
+			if (i < fen.size() && fen[i] == 'b')
+				position.state |= 0b10000000;
+			i += 2;
+
+			// 3. Castling availability
+			for (; i < fen.size() && fen[i] != ' '; ++i) {
+				switch (fen[i]) {
+					case 'K': position.state |= (uint8_t)CastlingFlags::WhiteKingside; break;
+					case 'Q': position.state |= (uint8_t)CastlingFlags::WhiteQueenside; break;
+					case 'k': position.state |= (uint8_t)CastlingFlags::BlackKingside; break;
+					case 'q': position.state |= (uint8_t)CastlingFlags::BlackQueenside; break;
+				}
+			}
+			++i;
+
+			// 4. En-passant square
+			position.enPassantSquare = Square::None;
+			if (i + 1 < fen.size() && fen[i] != '-')
+				position.enPassantSquare = uint8_t((fen[i] - 'a') + (fen[i + 1] - '1') * 8);
+
+			while (i < fen.size() && fen[i] != ' ')
+				++i;
+			++i;
+
+			// 5. and 6. Clocks, which EPD does not have
+			position.fullMoveCount = 1;
+			if (detail::parseNumber(fen, i, position.halfMoveCounter) && ++i < fen.size())
+				detail::parseNumber(fen, i, position.fullMoveCount);
+
+			return position;
+		}
+
+		/**
+		 * \returns The FEN string of a packed position.
+		 */
+		inline std::string unpackFEN(const Position& position) {
+			Piece board[64];
+			std::fill(std::begin(board), std::end(board), Piece::None);
+
+			size_t count = 0;
+			for (Bitboard b = position.occupied; b; ++count)
+				board[popLSB(b)] = position.pieceAt(count);
+
+			std::string fen;
+			fen.reserve(90);
+
+			for (int row = 7; row >= 0; --row) {
+				int empty = 0;
+
+				for (int col = 0; col < 8; ++col) {
+					const Piece piece = board[col + row * 8];
+
+					if (piece == Piece::None) {
+						++empty;
+						continue;
+					}
+
+					if (empty)
+						fen += char('0' + empty), empty = 0;
+					fen += detail::pieceToChar(piece);
+				}
+
+				if (empty)
+					fen += char('0' + empty);
+				if (row)
+					fen += '/';
+			}
+
+			fen += position.turn() == Color::White ? " w " : " b ";
+
+			const CastlingFlags castlingRights = position.castlingRights();
+			if (castlingRights == CastlingFlags::None)
+				fen += '-';
+			if ((castlingRights & CastlingFlags::WhiteKingside) != CastlingFlags::None) fen += 'K';
+			if ((castlingRights & CastlingFlags::WhiteQueenside) != CastlingFlags::None) fen += 'Q';
+			if ((castlingRights & CastlingFlags::BlackKingside) != CastlingFlags::None) fen += 'k';
+			if ((castlingRights & CastlingFlags::BlackQueenside) != CastlingFlags::None) fen += 'q';
+
+			fen += ' ';
+			if (position.enPassantSquare == Square::None) {
+				fen += '-';
+			} else {
+				fen += char('a' + fileOf(position.enPassantSquare));
+				fen += char('1' + rankOf(position.enPassantSquare));
+			}
+
+			fen += ' ';
+			fen += std::to_string(position.halfMoveCounter);
+			fen += ' ';
+			fen += std::to_string(position.fullMoveCount);
+			return fen;
+		}
+
+		/**
+		 * \returns The packed position of a board and its state.
+		 */
+		inline constexpr Position pack(const Board& board, const Color turn, const CastlingFlags castlingRights, const int enPassantSquare,
+		                               const int halfMoveCounter = 0, const int fullMoveCount = 1) noexcept {
+			Position position{ };
+
+			position.occupied = board.occupied();
+
+			size_t count = 0;
+			for (Bitboard b = position.occupied; b; ++count)
+				position.pieces[count >> 1] |= uint8_t((size_t)board.pieceAt(popLSB(b)) << ((count & 1) * 4));
+
+			position.state = uint8_t((size_t)castlingRights | ((size_t)turn << 7));
+			position.enPassantSquare = uint8_t(enPassantSquare);
+			position.halfMoveCounter = uint16_t(halfMoveCounter);
+			position.fullMoveCount = uint16_t(fullMoveCount);
+			return position;
+		}
+
+		/**
+		 * \returns The packed position of a game.
+		 */
+		inline constexpr Position pack(const Game& game) noexcept {
+			return pack(game.board(), game.turn(), game.castlingRights(), game.enPassantSquare(),
+			            game.halfMoveCounter(), game.fullMoveCount());
+		}
+
+		/**
+		 * Sets up a game from a packed position, without going through FEN. This is the way to
+		 * reuse one Game for many positions.
+		 *
+		 * \note The full-move count is capped, since the game holds only 512 positions of history.
+		 */
+		inline constexpr void unpack(const Position& position, Game& game) noexcept {
+			Board board{ };
+
+			size_t count = 0;
+			for (Bitboard b = position.occupied; b; ++count)
+				board.putPiece(position.pieceAt(count), popLSB(b));
+
+			game.init(board, position.turn(), position.castlingRights(), position.enPassantSquare,
+			          position.halfMoveCounter, std::min<int>(position.fullMoveCount, 128));
+		}
+
+		/**
+		 * Calls `callback(std::string_view line)` on every non-empty line of a text, without the
+		 * line terminator.
+		 */
+		template <typename Callback>
+		inline constexpr void forEachLine(const std::string_view text, Callback&& callback) {
+			for (size_t begin = 0; begin < text.size();) {
+				size_t end = text.find('\n', begin);
+				if (end == std::string_view::npos)
+					end = text.size();
+
+				std::string_view line = text.substr(begin, end - begin);
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				if (!line.empty())
+					callback(line);
+
+				begin = end + 1;
+			}
+		}
+
+		/**
+		 * \param text The EPD or FEN text, one position per line.
+		 * \param convert Called as `T(std::string_view line)`.
+		 * \param threads The number of threads, 0 for the hardware concurrency.
+		 * \returns The converted lines, in order.
+		 *
+		 * Converts every line of a large text in parallel. The text is split into one range per
+		 * thread at line boundaries.
+		 */
+		template <typename T, typename Convert>
+		inline std::vector<T> convertLines(const std::string_view text, Convert&& convert, unsigned threads = 0) {
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			std::vector<std::string_view> ranges;
+			for (size_t begin = 0; begin < text.size();) {
+				size_t end = std::min(text.size(), begin + text.size() / threads + 1);
+				while (end < text.size() && text[end - 1] != '\n')
+					++end;
+
+				ranges.push_back(text.substr(begin, end - begin));
+				begin = end;
+			}
+
+			std::vector<std::vector<T>> results(ranges.size());
+			std::vector<std::thread> workers;
+
+			for (size_t t = 0; t < ranges.size(); ++t) {
+				workers.emplace_back([&, t]() {
+					forEachLine(ranges[t], [&](const std::string_view line) {
+						results[t].push_back(convert(line));
+					});
+				});
+			}
+
+			for (std::thread& worker : workers)
+				worker.join();
+
+			std::vector<T> out;
+			for (const std::vector<T>& result : results)
+				out.insert(out.end(), result.begin(), result.end());
+			return out;
+		}
+
+		/**
+		 * \returns The Zobrist key of every line of an EPD or FEN text, in order.
+		 */
+		inline std::vector<zobrist::Key> hashEPD(const std::string_view text, const unsigned threads = 0) {
+			return convertLines<zobrist::Key>(text, zobrist::hashFEN, threads);
+		}
+
+		/**
+		 * \returns The packed position of every line of an EPD or FEN text, in order.
+		 */
+		inline std::vector<Position> packEPD(const std::string_view text, const unsigned threads = 0) {
+			return convertLines<Position>(text, packFEN, threads);
+		}
+
+		/**
+		 * A read-only file mapped into memory, to run the batch functions over large EPD files
+		 * without copying them. On platforms without mmap the file is read into memory instead.
+		 */
+		class MappedFile {
+			const char* m_data = nullptr;
+			size_t m_size = 0;
+#ifndef CHESS_HAS_MMAP
+			std::string m_buffer;
+#endif
+
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			explicit MappedFile(const std::string& path) {
+				open(path);
+			}
+
+			~MappedFile() {
+				close();
+			}
+
+			inline bool open(const std::string& path) {
+				close();
+
+#ifdef CHESS_HAS_MMAP
+				const int fd = ::open(path.c_str(), O_RDONLY);
+				if (fd < 0)
+					return false;
+
+				struct stat st{ };
+				if (fstat(fd, &st) == 0 && st.st_size > 0) {
+					void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+					if (data != MAP_FAILED) {
+						madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+						m_data = static_cast<const char*>(data);
+						m_size = size_t(st.st_size);
+					}
+				}
+
+				::close(fd);
+				return m_data != nullptr || st.st_size == 0;
+#else
+				std::ifstream file(path, std::ios::binary);
+				if (!file)
+					return false;
+
+				m_buffer.assign(std::istreambuf_iterator<char>(file), { });
+				m_data = m_buffer.data();
+				m_size = m_buffer.size();
+				return true;
+#endif
+			}
+
+			inline void close() noexcept {
+#ifdef CHESS_HAS_MMAP
+				if (m_data)
+					munmap(const_cast<char*>(m_data), m_size);
+#else
+				m_buffer.clear();
+#endif
+				m_data = nullptr;
+				m_size = 0;
+			}
+
+			inline const char* data() const noexcept { return m_data; }
+			inline size_t size() const noexcept { return m_size; }
+			inline std::string_view text() const noexcept { return { m_data, m_size }; }
+		};
+	}
+}
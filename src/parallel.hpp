@@ -0,0 +1,127 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "pool.hpp"
+#include "search.hpp"
+#include <memory>
+#include <vector>
+
+/**
+ * @file Provides parallel searches of one position with three algorithms, for comparing them on
+ *       the same search core and transposition table.
+ *
+ * Lazy SMP runs the full iterative deepening on every thread. The threads only share the table,
+ * and helpers on odd indices start one depth deeper so that the threads do not walk the same tree
+ * in lockstep. ABDADA runs the same iterations, but marks the positions being searched in the
+ * table: a thread meeting a position another thread is searching puts the move off until its
+ * other moves are searched, by which time the result is usually in the table. YBWC (young
+ * brothers wait) runs the iterations on the main thread only; once the first move of a node is
+ * searched, its remaining moves become a split point that the idle helpers join, taking one move
+ * at a time, and a cutoff stops all of them.
+ *
+ * The result is the main thread's. With several threads, searches are not deterministic.
+ */
+namespace chess {
+	namespace search {
+		class ParallelSearcher {
+			TranspositionTable& m_table;
+			Algorithm m_algorithm;
+			ThreadPool m_pool;
+			detail::SharedSearch m_shared;
+			std::vector<std::unique_ptr<Searcher>> m_searchers;
+			std::vector<std::unique_ptr<Game>> m_games;		/* the helpers' positions */
+
+		public:
+			/**
+			 * \param threads The number of searching threads, the calling thread included. 0 for the
+			 *        hardware concurrency.
+			 */
+			inline ParallelSearcher(TranspositionTable& table, const Algorithm algorithm, const unsigned threads = 0) :
+				m_table{ table }, m_algorithm{ algorithm }, m_pool{ threads }
+			{
+				for (unsigned index = 0; index < m_pool.size(); ++index) {
+					Searcher& searcher = *m_searchers.emplace_back(std::make_unique<Searcher>(table));
+					searcher.m_shared = &m_shared;
+					searcher.m_algorithm = algorithm;
+					searcher.m_main = index == 0;
+
+					if (algorithm == Algorithm::YBWC)
+						searcher.m_splitPoints = std::make_unique<detail::SplitPoint[]>(detail::MaxSplitPoints);
+					if (index > 0)
+						m_games.push_back(std::make_unique<Game>());
+				}
+			}
+
+			ParallelSearcher(const ParallelSearcher&) = delete;
+			ParallelSearcher& operator=(const ParallelSearcher&) = delete;
+
+			inline unsigned threads() const noexcept {
+				return m_pool.size();
+			}
+
+			inline Algorithm algorithm() const noexcept {
+				return m_algorithm;
+			}
+
+			/**
+			 * Searches the position on all threads, calling `onIteration(const Result&)` on the
+			 * calling thread after every iteration of the main thread; its node count is that of
+			 * all threads, give or take 1024 per thread. Starts a new table generation.
+			 *
+			 * \returns The result of the main thread's last completed iteration. The node limit
+			 *          counts the nodes of all threads.
+			 */
+			template <typename OnIteration>
+			inline Result search(Game& game, const Limits& limits, OnIteration&& onIteration) {
+				m_table.newSearch();
+				m_shared.stop.store(false, std::memory_order_relaxed);
+				m_shared.nodes.store(0, std::memory_order_relaxed);
+				m_shared.splitPoints.clear();
+				m_shared.openSplitPoints.store(0, std::memory_order_relaxed);
+				m_shared.idle.store(0, std::memory_order_relaxed);
+
+				for (std::unique_ptr<Game>& helperGame : m_games)
+					helperGame->copyFrom(game);
+				for (std::unique_ptr<Searcher>& searcher : m_searchers)
+					searcher->reset();
+
+				Result result;
+				m_pool.run([&](const unsigned index) {
+					Searcher& searcher = *m_searchers[index];
+
+					if (index == 0) {
+						result = searcher.iterate(game, limits, 1, [&](const Result& iteration) {
+							Result total = iteration;
+							total.nodes = m_shared.nodes.load(std::memory_order_relaxed) + searcher.m_nodes - searcher.m_reportedNodes;
+							onIteration(std::as_const(total));
+						});
+
+						m_shared.stop.store(true, std::memory_order_relaxed);
+						return;
+					}
+
+					Game& helperGame = *m_games[index - 1];
+					if (m_algorithm == Algorithm::YBWC) {
+						searcher.help(helperGame);
+						return;
+					}
+
+					// The helpers search until the main thread is done; with Lazy SMP, half of them a depth ahead
+					const Limits helperLimits{ .depth = MaxPly - 1, .nodes = limits.nodes };
+					searcher.iterate(helperGame, helperLimits, m_algorithm == Algorithm::LazySMP ? 1 + int(index & 1) : 1, [](const Result&) { });
+				});
+
+				result.nodes = 0;
+				for (const std::unique_ptr<Searcher>& searcher : m_searchers)
+					result.nodes += searcher->m_nodes;
+
+				return result;
+			}
+
+			inline Result search(Game& game, const Limits& limits) {
+				return search(game, limits, [](const Result&) { });
+			}
+		};
+	}
+}
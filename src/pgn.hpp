@@ -0,0 +1,391 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "helper.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file Provides a small streaming PGN reader along with SAN move conversion.
+ */
+namespace chess {
+	namespace pgn {
+		struct Tag {
+			std::string name;
+			std::string value;
+		};
+
+		/**
+		 * Represents a single game read from PGN text. Comments, variations and NAGs
+		 * are skipped; only the tag pairs, the mainline SAN moves and the result are kept.
+		 */
+		struct GameRecord {
+			std::vector<Tag> tags;
+			std::vector<std::string> moves;
+			std::string result = "*";
+
+			/**
+			 * \returns The value of the given tag, or an empty view if the tag does not exist.
+			 */
+			inline std::string_view tag(const std::string_view name) const noexcept {
+				for (const Tag& tag : tags)
+					if (tag.name == name)
+						return tag.value;
+
+				return { };
+			}
+
+			inline void clear() noexcept {
+				tags.clear();
+				moves.clear();
+				result = "*";
+			}
+		};
+
+		/**
+		 * Reads games one after another out of a PGN buffer. The buffer is not copied, so
+		 * it must outlive the reader. This works nicely over a memory-mapped file.
+		 */
+		class Reader {
+			std::string_view m_text;
+			size_t m_pos = 0;
+
+			inline void skipWhitespace() noexcept {
+				while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' ||
+				       m_text[m_pos] == '\n' || m_text[m_pos] == '\r'))
+					++m_pos;
+			}
+
+			inline void skipLine() noexcept {
+				while (m_pos < m_text.size() && m_text[m_pos] != '\n')
+					++m_pos;
+			}
+
+			// Skips a brace comment or a (possibly nested) variation. Assumes m_pos is at the opening character.
+			inline void skipBlock() noexcept {
+				int depth = 0;
+
+				for (; m_pos < m_text.size(); ++m_pos) {
+					const char chr = m_text[m_pos];
+
+					if (chr == '{') {
+						// Comments do not nest, and may contain parentheses
+						while (m_pos < m_text.size() && m_text[m_pos] != '}')
+							++m_pos;
+					} else if (chr == '(') {
+						++depth;
+					} else if (chr == ')') {
+						if (--depth == 0)
+							break;
+					}
+
+					if (depth == 0)
+						break;
+				}
+
+				++m_pos;
+			}
+
+			inline bool readTag(GameRecord& record) {
+				// Assumes m_pos is at '['
+				++m_pos;
+				skipWhitespace();
+
+				const size_t nameStart = m_pos;
+				while (m_pos < m_text.size() && m_text[m_pos] != ' ' && m_text[m_pos] != '"' && m_text[m_pos] != ']')
+					++m_pos;
+
+				Tag tag{ std::string(m_text.substr(nameStart, m_pos - nameStart)), { } };
+
+				skipWhitespace();
+				if (m_pos < m_text.size() && m_text[m_pos] == '"') {
+					for (++m_pos; m_pos < m_text.size() && m_text[m_pos] != '"'; ++m_pos) {
+						if (m_text[m_pos] == '\\' && m_pos + 1 < m_text.size())
+							++m_pos;
+
+						tag.value += m_text[m_pos];
+					}
+				}
+
+				while (m_pos < m_text.size() && m_text[m_pos] != ']')
+					++m_pos;
+				++m_pos;
+
+				record.tags.push_back(std::move(tag));
+				return true;
+			}
+
+		public:
+			explicit Reader(const std::string_view text) noexcept : m_text{text} { }
+
+			/**
+			 * \param record The record to fill. It is cleared first.
+			 * \returns True if a game was read, false if the end of the buffer was reached.
+			 */
+			inline bool next(GameRecord& record) {
+				record.clear();
+
+				// Tag pair section
+				for (skipWhitespace(); m_pos < m_text.size(); skipWhitespace()) {
+					if (m_text[m_pos] == '[')
+						readTag(record);
+					else if (m_text[m_pos] == ';' || m_text[m_pos] == '%')
+						skipLine();
+					else
+						break;
+				}
+
+				if (m_pos >= m_text.size())
+					return !record.tags.empty();
+
+				// Movetext section
+				for (skipWhitespace(); m_pos < m_text.size(); skipWhitespace()) {
+					const char chr = m_text[m_pos];
+
+					if (chr == '{' || chr == '(') {
+						skipBlock();
+						continue;
+					}
+
+					if (chr == ';') {
+						skipLine();
+						continue;
+					}
+
+					// A new tag section without a terminating result, be lenient
+					if (chr == '[')
+						return true;
+
+					const size_t tokenStart = m_pos;
+					while (m_pos < m_text.size() && m_text[m_pos] != ' ' && m_text[m_pos] != '\n' &&
+					       m_text[m_pos] != '\r' && m_text[m_pos] != '\t' && m_text[m_pos] != '{' &&
+					       m_text[m_pos] != '(' && m_text[m_pos] != ')' && m_text[m_pos] != ';')
+						++m_pos;
+
+					std::string_view token = m_text.substr(tokenStart, m_pos - tokenStart);
+					if (token.empty()) {
+						// Stray closing parenthesis
+						++m_pos;
+						continue;
+					}
+
+					if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+						record.result = token;
+						return true;
+					}
+
+					// NAGs
+					if (token[0] == '$')
+						continue;
+
+					// Move numbers, possibly glued to the move itself (like "12.e4" or "12...Nf6")
+					if (token[0] >= '0' && token[0] <= '9' && token.find('.') != std::string_view::npos) {
+						token.remove_prefix(token.find_last_of('.') + 1);
+						if (token.empty())
+							continue;
+					}
+
+					record.moves.emplace_back(token);
+				}
+
+				return true;
+			}
+		};
+
+		/**
+		 * \tparam Color The current turn.
+		 * \param game The game context of the move.
+		 * \param san The move in standard algebraic notation, for instance, Nbd7 or exd8=Q+.
+		 * \returns The resulting Move object, null move if invalid or ambiguous.
+		 *
+		 * Converts a SAN move string into a Move object. Unlike `convertToMove`, the resulting
+		 * move is always legal, since it is matched against the legal move list.
+		 */
+		template <Color Color>
+		inline Move convertSANToMove(const Game& game, std::string_view san) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			// Strip check, mate and annotation suffixes
+			while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+				san.remove_suffix(1);
+
+			if (san.size() < 2)
+				return Move::null();
+
+			// Castling
+			if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+				const bool kingside = san.size() == 3;
+				Move result = Move::null();
+
+				movegen::legalMoves<Color>(game, [&](const Move move) {
+					if (kingside ? move.isKingsideCastle() : move.isQueensideCastle())
+						result = move;
+				});
+
+				return result;
+			}
+
+			// Piece type (pawn moves have no letter)
+			PieceType pieceType = PieceType::Pawn;
+			switch (san.front()) {
+				case 'N': pieceType = PieceType::Knight; san.remove_prefix(1); break;
+				case 'B': pieceType = PieceType::Bishop; san.remove_prefix(1); break;
+				case 'R': pieceType = PieceType::Rook; san.remove_prefix(1); break;
+				case 'Q': pieceType = PieceType::Queen; san.remove_prefix(1); break;
+				case 'K': pieceType = PieceType::King; san.remove_prefix(1); break;
+			}
+
+			// Promotion, either "e8=Q" or "e8Q"
+			bool isPromotion = false;
+			PieceType promotion = PieceType::NoPromotion;
+			if (!san.empty()) {
+				switch (san.back()) {
+					case 'N': promotion = PieceType::Knight; isPromotion = true; break;
+					case 'B': promotion = PieceType::Bishop; isPromotion = true; break;
+					case 'R': promotion = PieceType::Rook; isPromotion = true; break;
+					case 'Q': promotion = PieceType::Queen; isPromotion = true; break;
+				}
+
+				if (isPromotion) {
+					san.remove_suffix(1);
+					if (!san.empty() && san.back() == '=')
+						san.remove_suffix(1);
+				}
+			}
+
+			if (san.size() < 2)
+				return Move::null();
+
+			const int to = convertToSquare(san.substr(san.size() - 2));
+			if (to == Square::None)
+				return Move::null();
+			san.remove_suffix(2);
+
+			// Whatever remains is disambiguation, possibly with a capture marker
+			int fromFile = -1, fromRank = -1;
+			for (const char chr : san) {
+				if (chr >= 'a' && chr <= 'h') fromFile = chr - 'a';
+				else if (chr >= '1' && chr <= '8') fromRank = chr - '1';
+				else if (chr != 'x' && chr != ':') return Move::null();
+			}
+
+			const Board& board = game.board();
+			Move result = Move::null();
+			int matches = 0;
+
+			movegen::legalMoves<Color>(game, [&](const Move move) {
+				if (move.getTo() != to || move.isCastle())
+					return;
+
+				const int from = move.getFrom();
+				if (getPieceType(board.pieceAt(from)) != pieceType)
+					return;
+
+				if ((fromFile != -1 && fileOf(from) != fromFile) || (fromRank != -1 && rankOf(from) != fromRank))
+					return;
+
+				if (move.isPromotion() != isPromotion || (isPromotion && move.promotionPieceType() != promotion))
+					return;
+
+				result = move;
+				++matches;
+			});
+
+			return matches == 1 ? result : Move::null();
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \param game The game context of the move. It is left unchanged.
+		 * \param move A legal move.
+		 * \returns The move in standard algebraic notation, with the check or mate suffix.
+		 */
+		template <Color Color>
+		inline std::string convertMoveToSAN(Game& game, const Move move) {
+			CHESS_ASSERT_COLOR;
+
+			std::string san;
+			const Board& board = game.board();
+			const int from = move.getFrom(), to = move.getTo();
+			const PieceType pieceType = getPieceType(board.pieceAt(from));
+
+			if (move.isKingsideCastle()) {
+				san = "O-O";
+			} else if (move.isQueensideCastle()) {
+				san = "O-O-O";
+			} else {
+				if (pieceType == PieceType::Pawn) {
+					if (move.isCapture())
+						san += getSquareName(from).letter;
+				} else {
+					san += "PNBRQK"[(size_t)pieceType];
+
+					// Disambiguate from the other pieces of the same type that can reach the square
+					bool ambiguous = false, sameFile = false, sameRank = false;
+					movegen::legalMoves<Color>(game, [&](const Move other) {
+						if (other.getTo() != to || other.getFrom() == from || getPieceType(board.pieceAt(other.getFrom())) != pieceType)
+							return;
+
+						ambiguous = true;
+						sameFile |= fileOf(other.getFrom()) == fileOf(from);
+						sameRank |= rankOf(other.getFrom()) == rankOf(from);
+					});
+
+					if (ambiguous && (!sameFile || sameRank))
+						san += getSquareName(from).letter;
+					if (ambiguous && sameFile)
+						san += getSquareName(from).number;
+				}
+
+				if (move.isCapture())
+					san += 'x';
+
+				san += getSquareName(to).letter;
+				san += getSquareName(to).number;
+
+				if (move.isPromotion()) {
+					san += '=';
+					san += "PNBRQK"[(size_t)move.promotionPieceType()];
+				}
+			}
+
+			const UndoInfo undoInfo = game.make<Color>(move);
+			if (movegen::isCheck<~Color>(game)) {
+				movegen::detail::MoveCounter counter;
+				movegen::legalMoves<~Color>(game, counter);
+				san += counter.count ? '+' : '#';
+			}
+			game.unmake<Color>(move, undoInfo);
+
+			return san;
+		}
+
+		/**
+		 * \returns The move for the side to move in standard algebraic notation.
+		 */
+		inline std::string moveToSAN(Game& game, const Move move) {
+			return dispatchRuntimeColor(game, []<Color Color>(Game& game, const Move move) {
+				return convertMoveToSAN<Color>(game, move);
+			}, move);
+		}
+
+		/**
+		 * \param game The game to play the move in.
+		 * \param san The move in standard algebraic notation.
+		 * \returns The played move, or the null move if it could not be converted (nothing is played then).
+		 *
+		 * Converts a SAN move for the side to move, and plays it.
+		 */
+		inline Move playSAN(Game& game, const std::string_view san) noexcept {
+			return dispatchRuntimeColor(game, []<Color Color>(Game& game, const std::string_view san) {
+				const Move move = convertSANToMove<Color>(game, san);
+				if (!move.isNull())
+					game.make<Color>(move);
+
+				return move;
+			}, san);
+		}
+	}
+}
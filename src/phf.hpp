@@ -0,0 +1,344 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "zobrist.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @file Provides minimal perfect hash maps over static sets of positions, such as opening books,
+ *       puzzle sets or ECO tables, serialized to a file that can be memory-mapped and used as is.
+ *
+ * The hash function is built the PTHash way. Keys are split into buckets of about five, a few
+ * large buckets taking most of the keys. Then, largest bucket first, each bucket gets a "pilot":
+ * the first small number that, mixed into the hashes of its keys, sends all of them to free slots.
+ * A lookup reads the bucket's pilot and then the slot, so a hit or a miss costs two cache misses.
+ * The table has about 2% more slots than keys; keys landing past the end are sent back to the
+ * free slots below it through a small remap array, a third access for those few keys.
+ *
+ * Slots only hold a fingerprint of the key and the payload, instead of the key, which makes the
+ * map much smaller than a sorted array of keys. A key outside the set is rejected unless its
+ * fingerprint happens to match, with a probability of 2^-32 for the default 32-bit fingerprints.
+ * Use `zobrist::Key` fingerprints for exact answers.
+ *
+ * \cond The file layout. Integers, fingerprints and payloads are stored in the native byte order, as
+ *       they are in memory, so a map is built on a machine of the same byte order as the readers:
+ *
+ *       Header     (see phf::Header)
+ *       Pilots     uint16_t[bucketCount]
+ *       Remap      uint32_t[tableSize - count], the slot of each position past the end
+ *       Slots      { Fingerprint, Payload }[count], packed
+ */
+namespace chess {
+	namespace phf {
+		inline constexpr char magic[4] = { 'C', 'P', 'H', 'F' };
+		inline constexpr uint32_t version = 1;
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint64_t count;
+			uint64_t bucketCount;
+			uint64_t tableSize;
+			uint64_t seed;
+			uint32_t fingerprintSize;
+			uint32_t payloadSize;
+			uint64_t pilotsOffset;
+			uint64_t remapOffset;
+			uint64_t slotsOffset;
+		};
+		static_assert(sizeof(Header) == 72);
+
+		namespace detail {
+			inline constexpr size_t BucketSize = 5;				/* the average number of keys per bucket */
+			inline constexpr double LoadFactor = 0.98;
+
+			// The murmur3 finalizer
+			inline constexpr uint64_t mix(uint64_t x) noexcept {
+				x = (x ^ (x >> 33)) * 0xFF51AFD7ED558CCDull;
+				x = (x ^ (x >> 33)) * 0xC4CEB9FE1A85EC53ull;
+				return x ^ (x >> 33);
+			}
+
+			// Maps a uniform 64-bit value into [0, n) without a division
+			inline constexpr uint64_t fastRange(const uint64_t x, const uint64_t n) noexcept {
+				return uint64_t((unsigned __int128)x * n >> 64);
+			}
+
+			// Sixty percent of the keys go to the first thirty percent of the buckets
+			inline constexpr uint64_t bucketOf(const uint64_t hash, const uint64_t bucketCount) noexcept {
+				const uint64_t dense = std::max<uint64_t>(1, bucketCount * 3 / 10);
+
+				if ((hash & 0xFFFFFFFF) < uint64_t(0.6 * 4294967296.0) || dense == bucketCount)
+					return fastRange(hash >> 32 << 32, dense);
+				return dense + fastRange(hash >> 32 << 32, bucketCount - dense);
+			}
+
+			inline constexpr uint64_t positionOf(const uint64_t hash, const uint16_t pilot, const uint64_t tableSize) noexcept {
+				return fastRange(mix(hash ^ mix(pilot + 1)), tableSize);
+			}
+
+			template <typename T>
+			inline void writeRaw(std::vector<uint8_t>& out, const size_t offset, const T& value) {
+				std::memcpy(out.data() + offset, &value, sizeof(T));
+			}
+
+			template <typename T>
+			inline T readRaw(const uint8_t* ptr) noexcept {
+				T value;
+				std::memcpy(&value, ptr, sizeof(T));
+				return value;
+			}
+		}
+
+		/**
+		 * Builds a map out of key and payload pairs.
+		 *
+		 * \tparam Payload A trivially copyable type.
+		 * \tparam Fingerprint An unsigned integer type, stored in each slot to reject keys outside the set.
+		 */
+		template <typename Payload, typename Fingerprint = uint32_t>
+			requires std::is_trivially_copyable_v<Payload> && std::is_unsigned_v<Fingerprint>
+		class Builder {
+			struct Entry {
+				zobrist::Key key;
+				Payload payload;
+			};
+
+			std::vector<Entry> m_entries;
+
+		public:
+			inline void add(const zobrist::Key key, const Payload& payload) {
+				m_entries.push_back({ key, payload });
+			}
+
+			inline size_t size() const noexcept { return m_entries.size(); }
+
+			/**
+			 * \param seed Retried with the next seeds if a bucket finds no pilot, which is very unlikely.
+			 * \returns The serialized map. If a key was added several times, the first payload wins.
+			 */
+			inline std::vector<uint8_t> finish(uint64_t seed = 0) const {
+				std::vector<Entry> entries = m_entries;
+				std::stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+					return lhs.key < rhs.key;
+				});
+				entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+					return lhs.key == rhs.key;
+				}), entries.end());
+
+				const uint64_t count = entries.size();
+				const uint64_t bucketCount = std::max<uint64_t>(1, (count + detail::BucketSize - 1) / detail::BucketSize);
+				const uint64_t tableSize = std::max<uint64_t>(count, uint64_t(double(count) / detail::LoadFactor) + 1);
+
+				std::vector<uint64_t> hashes(count);
+				std::vector<uint16_t> pilots(bucketCount);
+				std::vector<uint32_t> order(count);				/* key indices, grouped by bucket */
+				std::vector<uint32_t> bucketStarts(bucketCount + 1);
+				std::vector<uint64_t> taken((tableSize + 63) / 64);
+				std::vector<uint64_t> positions;
+
+				for (;; ++seed) {
+					// Group the keys by bucket, with a counting sort
+					std::fill(bucketStarts.begin(), bucketStarts.end(), 0);
+					for (uint64_t i = 0; i < count; ++i) {
+						hashes[i] = detail::mix(entries[i].key ^ detail::mix(seed));
+						++bucketStarts[detail::bucketOf(hashes[i], bucketCount) + 1];
+					}
+					for (uint64_t b = 0; b < bucketCount; ++b)
+						bucketStarts[b + 1] += bucketStarts[b];
+
+					std::vector<uint32_t> cursor(bucketStarts.begin(), bucketStarts.end() - 1);
+					for (uint64_t i = 0; i < count; ++i)
+						order[cursor[detail::bucketOf(hashes[i], bucketCount)]++] = uint32_t(i);
+
+					// Largest buckets first, since they are the hardest to place
+					std::vector<uint32_t> buckets(bucketCount);
+					for (uint64_t b = 0; b < bucketCount; ++b)
+						buckets[b] = uint32_t(b);
+					std::stable_sort(buckets.begin(), buckets.end(), [&](const uint32_t lhs, const uint32_t rhs) {
+						return bucketStarts[lhs + 1] - bucketStarts[lhs] > bucketStarts[rhs + 1] - bucketStarts[rhs];
+					});
+
+					std::fill(taken.begin(), taken.end(), 0);
+					bool placed = true;
+
+					for (const uint32_t bucket : buckets) {
+						const uint32_t begin = bucketStarts[bucket], end = bucketStarts[bucket + 1];
+						if (begin == end)
+							break;
+
+						bool found = false;
+						for (uint32_t pilot = 0; pilot <= UINT16_MAX && !found; ++pilot) {
+							positions.clear();
+							found = true;
+
+							for (uint32_t i = begin; i < end && found; ++i) {
+								const uint64_t position = detail::positionOf(hashes[order[i]], uint16_t(pilot), tableSize);
+								found = !(taken[position / 64] >> (position % 64) & 1) &&
+								        std::find(positions.begin(), positions.end(), position) == positions.end();
+								positions.push_back(position);
+							}
+
+							if (found) {
+								pilots[bucket] = uint16_t(pilot);
+								for (const uint64_t position : positions)
+									taken[position / 64] |= 1ull << (position % 64);
+							}
+						}
+
+						if (!found) {
+							placed = false;
+							break;
+						}
+					}
+
+					if (placed)
+						break;
+				}
+
+				// Send the positions past the end to the free slots below it
+				std::vector<uint32_t> remap(tableSize - count);
+				for (uint64_t position = count, free = 0; position < tableSize; ++position) {
+					if (!(taken[position / 64] >> (position % 64) & 1))
+						continue;
+
+					while (taken[free / 64] >> (free % 64) & 1)
+						++free;
+					remap[position - count] = uint32_t(free++);
+				}
+
+				constexpr size_t SlotSize = sizeof(Fingerprint) + sizeof(Payload);
+
+				Header header{ };
+				std::memcpy(header.magic, magic, sizeof(magic));
+				header.version = version;
+				header.count = count;
+				header.bucketCount = bucketCount;
+				header.tableSize = tableSize;
+				header.seed = seed;
+				header.fingerprintSize = sizeof(Fingerprint);
+				header.payloadSize = sizeof(Payload);
+				header.pilotsOffset = sizeof(Header);
+				header.remapOffset = header.pilotsOffset + bucketCount * sizeof(uint16_t);
+				header.slotsOffset = header.remapOffset + remap.size() * sizeof(uint32_t);
+
+				std::vector<uint8_t> out(header.slotsOffset + count * SlotSize);
+				detail::writeRaw(out, 0, header);
+				std::memcpy(out.data() + header.pilotsOffset, pilots.data(), pilots.size() * sizeof(uint16_t));
+				std::memcpy(out.data() + header.remapOffset, remap.data(), remap.size() * sizeof(uint32_t));
+
+				for (uint64_t i = 0; i < count; ++i) {
+					uint64_t position = detail::positionOf(hashes[i], pilots[detail::bucketOf(hashes[i], bucketCount)], tableSize);
+					if (position >= count)
+						position = remap[position - count];
+
+					const size_t offset = header.slotsOffset + position * SlotSize;
+					detail::writeRaw(out, offset, Fingerprint(entries[i].key));
+					detail::writeRaw(out, offset + sizeof(Fingerprint), entries[i].payload);
+				}
+
+				return out;
+			}
+
+			inline bool save(const std::string& path, const uint64_t seed = 0) const {
+				const std::vector<uint8_t> bytes = finish(seed);
+				std::ofstream file(path, std::ios::binary);
+				file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+				return bool(file);
+			}
+		};
+
+		/**
+		 * A read-only view over a serialized map. The bytes are not copied, so they must outlive the
+		 * view. They can come from a memory-mapped file (see `packed::MappedFile`).
+		 */
+		template <typename Payload, typename Fingerprint = uint32_t>
+			requires std::is_trivially_copyable_v<Payload> && std::is_unsigned_v<Fingerprint>
+		class MapView {
+			static constexpr size_t SlotSize = sizeof(Fingerprint) + sizeof(Payload);
+
+			const uint8_t* m_data = nullptr;
+			Header m_header{ };
+			uint64_t m_hashSeed = 0;
+
+			inline bool fail() noexcept {
+				*this = { };
+				return false;
+			}
+
+		public:
+			MapView() = default;
+
+			/**
+			 * \returns True if the bytes hold a map with this payload and fingerprint size, false if not.
+			 *          The header, the sections and the remap array are checked, which reads the remap
+			 *          array once, so that lookups stay in bounds.
+			 */
+			inline bool open(const uint8_t* data, const size_t size) noexcept {
+				if (size < sizeof(Header))
+					return fail();
+
+				std::memcpy(&m_header, data, sizeof(Header));
+				if (std::memcmp(m_header.magic, magic, sizeof(magic)) != 0 || m_header.version != version ||
+				    m_header.fingerprintSize != sizeof(Fingerprint) || m_header.payloadSize != sizeof(Payload))
+					return fail();
+
+				// Every section must be in bounds; the sizes are divided instead of the counts multiplied,
+				// so that nothing can overflow
+				const uint64_t remapSize = m_header.tableSize - m_header.count;
+				if (m_header.bucketCount == 0 || m_header.tableSize < m_header.count ||
+				    m_header.pilotsOffset < sizeof(Header) || m_header.pilotsOffset > size ||
+				    (size - m_header.pilotsOffset) / sizeof(uint16_t) < m_header.bucketCount ||
+				    m_header.remapOffset < sizeof(Header) || m_header.remapOffset > size ||
+				    (size - m_header.remapOffset) / sizeof(uint32_t) < remapSize ||
+				    m_header.slotsOffset < sizeof(Header) || m_header.slotsOffset > size ||
+				    (size - m_header.slotsOffset) / SlotSize < m_header.count)
+					return fail();
+
+				// The positions past the end must be sent back to slots (an empty map is never looked up)
+				for (uint64_t i = 0; i < remapSize && m_header.count > 0; ++i)
+					if (detail::readRaw<uint32_t>(data + m_header.remapOffset + i * sizeof(uint32_t)) >= m_header.count)
+						return fail();
+
+				m_data = data;
+				m_hashSeed = detail::mix(m_header.seed);
+				return true;
+			}
+
+			inline size_t size() const noexcept { return m_header.count; }
+
+			/**
+			 * \returns True if the key is in the map, in which case the payload is set.
+			 */
+			inline bool find(const zobrist::Key key, Payload& payload) const noexcept {
+				if (m_header.count == 0)
+					return false;
+
+				const uint64_t hash = detail::mix(key ^ m_hashSeed);
+				const uint64_t bucket = detail::bucketOf(hash, m_header.bucketCount);
+				const uint16_t pilot = detail::readRaw<uint16_t>(m_data + m_header.pilotsOffset + bucket * sizeof(uint16_t));
+
+				uint64_t position = detail::positionOf(hash, pilot, m_header.tableSize);
+				if (position >= m_header.count)
+					position = detail::readRaw<uint32_t>(m_data + m_header.remapOffset + (position - m_header.count) * sizeof(uint32_t));
+
+				const uint8_t* slot = m_data + m_header.slotsOffset + position * SlotSize;
+				if (detail::readRaw<Fingerprint>(slot) != Fingerprint(key))
+					return false;
+
+				payload = detail::readRaw<Payload>(slot + sizeof(Fingerprint));
+				return true;
+			}
+
+			inline bool contains(const zobrist::Key key) const noexcept {
+				Payload payload;
+				return find(key, payload);
+			}
+		};
+	}
+}
@@ -0,0 +1,88 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "game.hpp"
+
+/**
+ * @file Provides neural network input planes built from a position.
+ */
+namespace chess {
+	namespace nn {
+		/**
+		 * Flips a bitboard vertically, so that rank 1 becomes rank 8 and vice versa.
+		 */
+		CHESS_ALWAYS_INLINE inline constexpr Bitboard flipVertical(const Bitboard bitboard) noexcept {
+			return __builtin_bswap64(bitboard);
+		}
+
+		/**
+		 * The input planes of a position, always from the perspective of the side to move.
+		 * That is, if Black is to move, the board is flipped vertically and the colors are
+		 * swapped, so the network only ever sees "us" moving up the board.
+		 *
+		 * \cond The planes, in order, are:
+		 *         0 -  5   our pawns, knights, bishops, rooks, queens, king
+		 *         6 - 11   their pawns, knights, bishops, rooks, queens, king
+		 *        12        en-passant square
+		 *        13 - 16   our kingside, our queenside, their kingside, their queenside castling (filled planes)
+		 *        17        all ones (lets the network detect the board edge through padding)
+		 */
+		struct InputPlanes {
+			static constexpr size_t Count = 18;
+
+			Bitboard planes[Count];
+
+			/**
+			 * Expands the bitboards into `Count * 64` floats (planes-major), which is what
+			 * most inference backends want.
+			 */
+			inline void toFloats(float* out) const noexcept {
+				for (size_t plane = 0; plane < Count; ++plane)
+					for (int square = 0; square < 64; ++square)
+						*out++ = float((planes[plane] >> square) & 1);
+			}
+		};
+
+		template <Color Color>
+		inline constexpr InputPlanes makeInputPlanes(const Game& game) noexcept {
+			CHESS_ASSERT_COLOR;
+
+			const Board& board = game.board();
+			constexpr auto orient = [](const Bitboard bitboard) constexpr {
+				return Color == Color::White ? bitboard : flipVertical(bitboard);
+			};
+
+			const CastlingFlags castling = game.castlingRights();
+			const auto castlingPlane = [&](const CastlingFlags flag) constexpr {
+				return (castling & flag) != CastlingFlags::None ? ~Bitboard(0) : Bitboard(0);
+			};
+
+			const int epSquare = game.enPassantSquare();
+
+			return { {
+				orient(board.pawns<Color>()), orient(board.knights<Color>()), orient(board.bishops<Color>()),
+				orient(board.rooks<Color>()), orient(board.queens<Color>()), orient(board.kings<Color>()),
+				orient(board.pawns<~Color>()), orient(board.knights<~Color>()), orient(board.bishops<~Color>()),
+				orient(board.rooks<~Color>()), orient(board.queens<~Color>()), orient(board.kings<~Color>()),
+				epSquare != Square::None ? orient(1ull << epSquare) : 0,
+				castlingPlane(kingsideCastleFlag<Color>()), castlingPlane(queensideCastleFlag<Color>()),
+				castlingPlane(kingsideCastleFlag<~Color>()), castlingPlane(queensideCastleFlag<~Color>()),
+				~Bitboard(0)
+			} };
+		}
+
+		/**
+		 * Maps a move to its index in a from-to policy head (64 * 64 outputs), from the
+		 * perspective of the side to move. Underpromotions share the index of the queen
+		 * promotion.
+		 */
+		template <Color Color>
+		inline constexpr int policyIndex(const Move move) noexcept {
+			constexpr int flip = Color == Color::White ? 0 : 56;
+			return ((move.getFrom() ^ flip) << 6) | (move.getTo() ^ flip);
+		}
+
+		inline constexpr size_t PolicySize = 64 * 64;
+	}
+}
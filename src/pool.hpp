@@ -0,0 +1,196 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "defs.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/**
+ * @file Provides a thread pool for parallel search, built for a low latency from `go` to the
+ *       first node on every thread.
+ *
+ * Waking threads parked on a condition variable costs tens of microseconds, which matters at
+ * bullet time controls. Idle helpers here spin on a padded epoch counter for a configurable
+ * window, then park on the counter itself with `std::atomic::wait` (a futex on Linux). Starting a
+ * job bumps the epoch, which a spinning helper sees within nanoseconds; the wake system call is
+ * only made when some helper is parked. Calling `prepare` when the position arrives, ahead of
+ * `go`, puts the helpers back to spinning.
+ *
+ * With `CHESS_METRICS` defined, the time from `run` to the start of the job on each helper is
+ * recorded as the "wakeup" operation.
+ */
+namespace chess {
+	namespace search {
+		namespace detail {
+			CHESS_ALWAYS_INLINE inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+#elif defined(__aarch64__)
+				asm volatile("yield");
+#else
+				std::this_thread::yield();
+#endif
+			}
+		}
+
+		class ThreadPool {
+			using Clock = std::chrono::steady_clock;
+
+			// The epoch gets its own cache line, since every spinning helper reads it
+			struct alignas(64) Epoch {
+				std::atomic<uint64_t> value{ 0 };
+			};
+
+			struct alignas(64) Counters {
+				std::atomic<unsigned> parked{ 0 };
+				std::atomic<unsigned> pending{ 0 };
+				std::atomic<int64_t> slowestStart{ 0 };		/* in nanoseconds, for the last job */
+			};
+
+			Epoch m_epoch;
+			Counters m_counters;
+
+			// The current job, written before the epoch is bumped to its epoch
+			void (*m_invoke)(void* job, unsigned index) = nullptr;
+			void* m_job = nullptr;
+			Clock::time_point m_start;
+			std::atomic<uint64_t> m_jobEpoch{ 0 };
+			std::atomic<bool> m_stop{ false };
+
+			std::chrono::nanoseconds m_spinWindow;
+			std::vector<std::thread> m_helpers;
+
+			// Spins on the epoch for the spin window, then parks on it. Returns the new epoch.
+			inline uint64_t awaitEpoch(const uint64_t seen) noexcept {
+				const Clock::time_point deadline = Clock::now() + m_spinWindow;
+
+				for (unsigned spin = 1;; ++spin) {
+					const uint64_t epoch = m_epoch.value.load(std::memory_order_acquire);
+					if (epoch != seen)
+						return epoch;
+
+					detail::cpuRelax();
+					if (spin % 64 == 0 && Clock::now() >= deadline)
+						break;
+				}
+
+				m_counters.parked.fetch_add(1, std::memory_order_seq_cst);
+				m_epoch.value.wait(seen, std::memory_order_seq_cst);
+				m_counters.parked.fetch_sub(1, std::memory_order_relaxed);
+
+				return m_epoch.value.load(std::memory_order_acquire);
+			}
+
+			inline void work(const unsigned index) noexcept {
+				for (uint64_t seen = 0;;) {
+					seen = awaitEpoch(seen);
+					if (m_stop.load(std::memory_order_relaxed))
+						return;
+
+					// Epochs bumped by `prepare` carry no job
+					if (seen != m_jobEpoch.load(std::memory_order_relaxed))
+						continue;
+
+					const std::chrono::nanoseconds latency = Clock::now() - m_start;
+					CHESS_METRIC_RECORD(Wakeup, latency);
+
+					int64_t slowest = m_counters.slowestStart.load(std::memory_order_relaxed);
+					while (latency.count() > slowest && !m_counters.slowestStart.compare_exchange_weak(slowest, latency.count(), std::memory_order_relaxed));
+
+					m_invoke(m_job, index);
+
+					if (m_counters.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						m_counters.pending.notify_one();
+				}
+			}
+
+			inline void bump() noexcept {
+				m_epoch.value.fetch_add(1, std::memory_order_seq_cst);
+				if (m_counters.parked.load(std::memory_order_seq_cst))
+					m_epoch.value.notify_all();
+			}
+
+		public:
+			/**
+			 * \param threads The number of threads of a job, the calling thread included. 0 for the
+			 *        hardware concurrency.
+			 * \param spinWindow How long idle helpers spin before parking.
+			 */
+			inline explicit ThreadPool(unsigned threads = 0, const std::chrono::nanoseconds spinWindow = std::chrono::microseconds(500)) :
+				m_spinWindow{ spinWindow }
+			{
+				if (threads == 0)
+					threads = std::max(1u, std::thread::hardware_concurrency());
+
+				for (unsigned index = 1; index < threads; ++index)
+					m_helpers.emplace_back([this, index]() { work(index); });
+			}
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			inline ~ThreadPool() {
+				m_stop.store(true, std::memory_order_relaxed);
+				bump();
+
+				for (std::thread& helper : m_helpers)
+					helper.join();
+			}
+
+			/**
+			 * \returns The number of threads of a job, the calling thread included.
+			 */
+			inline unsigned size() const noexcept {
+				return unsigned(m_helpers.size()) + 1;
+			}
+
+			/**
+			 * Wakes parked helpers to spin for another window, without a job. Call this when a job is
+			 * about to come, like on the UCI `position` command. Not while a job runs.
+			 */
+			inline void prepare() noexcept {
+				bump();
+			}
+
+			/**
+			 * Runs `job(unsigned index)` on every thread, the calling thread being index 0, and
+			 * returns when all of them are done. Not reentrant.
+			 */
+			template <typename Job>
+			inline void run(Job&& job) {
+				m_invoke = [](void* job, const unsigned index) {
+					(*static_cast<std::remove_reference_t<Job>*>(job))(index);
+				};
+				m_job = const_cast<void*>(static_cast<const void*>(&job));
+				m_start = Clock::now();
+				m_counters.slowestStart.store(0, std::memory_order_relaxed);
+				m_counters.pending.store(unsigned(m_helpers.size()), std::memory_order_relaxed);
+				m_jobEpoch.store(m_epoch.value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+				bump();
+				job(0u);
+
+				// The helpers usually finish around the same time, so spin briefly before parking
+				for (int spin = 0; spin < 4096; ++spin) {
+					if (m_counters.pending.load(std::memory_order_acquire) == 0)
+						return;
+					detail::cpuRelax();
+				}
+
+				for (unsigned pending; (pending = m_counters.pending.load(std::memory_order_acquire)) != 0;)
+					m_counters.pending.wait(pending, std::memory_order_acquire);
+			}
+
+			/**
+			 * \returns The time from the start of the last job to the start of its slowest helper.
+			 */
+			inline std::chrono::nanoseconds lastWakeup() const noexcept {
+				return std::chrono::nanoseconds(m_counters.slowestStart.load(std::memory_order_relaxed));
+			}
+		};
+	}
+}
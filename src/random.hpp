@@ -0,0 +1,243 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "movegen.hpp"
+#include "packed.hpp"
+#include <atomic>
+#include <bit>
+#include <string_view>
+
+/**
+ * @file Provides a generator of uniformly random legal positions with a given material, for
+ *       benchmarks, tablebase tests and fuzzing.
+ *
+ * Pawns are placed first on the second to seventh ranks, then the other pieces on the remaining
+ * squares, each one on a random free square. Since the number of free squares at each step does
+ * not depend on the earlier choices, every placement is equally likely. Positions where the side
+ * not to move is in check are rejected, which keeps the result uniform over the legal positions.
+ * Generated positions have no castling rights and no en-passant square.
+ */
+namespace chess {
+	namespace random {
+		/**
+		 * A material signature: the number of pieces of each kind, kings included.
+		 */
+		struct Material {
+			uint8_t counts[16] = { };		/* indexed by Piece */
+
+			inline constexpr int count(const Piece piece) const noexcept {
+				return counts[(size_t)piece];
+			}
+
+			/**
+			 * \returns Whether each side has exactly one king, at most 8 pawns and at most 16 pieces.
+			 */
+			inline constexpr bool valid() const noexcept {
+				for (const Color color : { Color::White, Color::Black }) {
+					int pieces = 0;
+					for (size_t pieceType = 0; pieceType < 6; ++pieceType)
+						pieces += count(makePiece(PieceType(pieceType), color));
+
+					if (count(makePiece(PieceType::King, color)) != 1 || count(makePiece(PieceType::Pawn, color)) > 8 || pieces > 16)
+						return false;
+				}
+
+				return true;
+			}
+
+			/**
+			 * \param signature Such as "KRPvKR": White's pieces, a 'v', then Black's pieces.
+			 * \returns Whether the signature is valid. If not, the material is left empty.
+			 */
+			inline constexpr bool parse(const std::string_view signature) noexcept {
+				*this = { };
+
+				Color color = Color::White;
+				for (const char chr : signature) {
+					if (chr == 'v' && color == Color::White) {
+						color = Color::Black;
+						continue;
+					}
+
+					const Piece piece = packed::detail::pieceFromChar(chr);
+					if (piece == Piece::None || getPieceColor(piece) != Color::White) {
+						*this = { };
+						return false;
+					}
+
+					++counts[(size_t)makePiece(getPieceType(piece), color)];
+				}
+
+				if (color != Color::Black || !valid()) {
+					*this = { };
+					return false;
+				}
+
+				return true;
+			}
+		};
+
+		namespace detail {
+			// xoshiro256**, seeded through splitmix64
+			class Random {
+				uint64_t m_state[4];
+
+			public:
+				explicit constexpr Random(uint64_t seed) noexcept : m_state{ } {
+					for (uint64_t& state : m_state) {
+						seed += 0x9E3779B97F4A7C15ull;
+
+						uint64_t z = seed;
+						z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+						z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+						state = z ^ (z >> 31);
+					}
+				}
+
+				inline constexpr uint64_t next() noexcept {
+					const uint64_t result = std::rotl(m_state[1] * 5, 7) * 9;
+					const uint64_t t = m_state[1] << 17;
+
+					m_state[2] ^= m_state[0];
+					m_state[3] ^= m_state[1];
+					m_state[1] ^= m_state[2];
+					m_state[0] ^= m_state[3];
+					m_state[2] ^= t;
+					m_state[3] = std::rotl(m_state[3], 45);
+
+					return result;
+				}
+
+				// Uniform in [0, bound), by multiplication instead of division
+				inline constexpr uint32_t below(const uint32_t bound) noexcept {
+					return uint32_t(((next() >> 32) * bound) >> 32);
+				}
+			};
+
+			// The square of the index-th set bit of the mask
+			CHESS_ALWAYS_INLINE inline int nthSquare(Bitboard mask, int index) noexcept {
+#ifdef CHESS_MULTIVERSION
+				// Without a fast PDEP, clear the lower bits one by one
+				if (!lookup::usePext) {
+					for (; index > 0; --index)
+						mask &= mask - 1;
+					return toSquare(mask & -mask);
+				}
+#endif
+				return toSquare(lookup::detail::pdep(1ull << index, mask));
+			}
+
+			inline constexpr Board EmptyBoard{ };
+			inline constexpr Piece PlacementOrder[] = {
+				Piece::WhiteKing, Piece::BlackKing,
+				Piece::WhiteQueen, Piece::BlackQueen, Piece::WhiteRook, Piece::BlackRook,
+				Piece::WhiteBishop, Piece::BlackBishop, Piece::WhiteKnight, Piece::BlackKnight
+			};
+		}
+
+		/**
+		 * Generates random legal positions with a given material, with either side to move. One per
+		 * thread; the positions only depend on the seed.
+		 */
+		class Generator {
+			Material m_material;
+			detail::Random m_random;
+			Board m_board;
+			Color m_turn = Color::White;
+
+			inline void place(const Piece piece, Bitboard& free) noexcept {
+				for (int i = 0; i < m_material.count(piece); ++i) {
+					const int square = detail::nthSquare(free, int(m_random.below(uint32_t(popcount(free)))));
+
+					free ^= 1ull << square;
+					m_board.putPiece(piece, square);
+				}
+			}
+
+			inline bool legal() const noexcept {
+				if (m_turn == Color::White)
+					return !movegen::squareAttacked<Color::Black>(m_board, toSquare(m_board.kings<Color::Black>()));
+				return !movegen::squareAttacked<Color::White>(m_board, toSquare(m_board.kings<Color::White>()));
+			}
+
+			inline void generate() noexcept {
+				do {
+					m_board = detail::EmptyBoard;
+					m_turn = Color(m_random.next() & 1);
+
+					Bitboard free = ~(RankMask::Rank1 | RankMask::Rank8);
+					place(Piece::WhitePawn, free);
+					place(Piece::BlackPawn, free);
+
+					free = ~m_board.occupied();
+					for (const Piece piece : detail::PlacementOrder)
+						place(piece, free);
+				} while (!legal());
+			}
+
+		public:
+			// Material must be valid.
+			inline Generator(const Material& material, const uint64_t seed) noexcept :
+				m_material{ material }, m_random{ seed }
+			{
+				lookup::init();
+			}
+
+			/**
+			 * Sets up the game with the next position.
+			 */
+			inline void next(Game& game) noexcept {
+				generate();
+				game.init(m_board, m_turn, CastlingFlags::None, Square::None);
+			}
+
+			/**
+			 * \returns The next position, packed.
+			 */
+			inline packed::Position nextPacked() noexcept {
+				generate();
+				return packed::pack(m_board, m_turn, CastlingFlags::None, Square::None);
+			}
+		};
+
+		/**
+		 * \param material Must be valid.
+		 * \param count The number of positions.
+		 * \param seed The same seed gives the same positions, whatever the number of threads.
+		 * \param threads The number of worker threads, 0 for the hardware concurrency.
+		 * \returns Random legal positions, packed.
+		 */
+		inline std::vector<packed::Position> generate(const Material& material, const size_t count, const uint64_t seed = 0, unsigned threads = 0) {
+			constexpr size_t BlockSize = 4096;
+
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			// The lookup tables must be initialized before the workers construct their generators
+			lookup::init();
+
+			std::vector<packed::Position> positions(count);
+			std::atomic<size_t> next = 0;
+			std::vector<std::thread> workers;
+
+			for (unsigned t = 0; t < threads; ++t) {
+				workers.emplace_back([&]() {
+					for (size_t begin; (begin = next.fetch_add(BlockSize, std::memory_order_relaxed)) < count;) {
+						// Each block has its own stream, so the output does not depend on the scheduling
+						Generator generator(material, seed ^ (begin / BlockSize) * 0xD1B54A32D192ED03ull);
+
+						const size_t end = std::min(count, begin + BlockSize);
+						for (size_t i = begin; i < end; ++i)
+							positions[i] = generator.nextPacked();
+					}
+				});
+			}
+
+			for (std::thread& worker : workers)
+				worker.join();
+
+			return positions;
+		}
+	}
+}
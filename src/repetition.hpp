@@ -0,0 +1,86 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "zobrist.hpp"
+
+/**
+ * @file Provides a table counting how many times each position of a game occurs, so that
+ *       repetitions are found in constant time instead of by scanning the history.
+ */
+namespace chess {
+	/**
+	 * An open-addressing table from Zobrist keys to occurrence counts, with linear probing.
+	 *
+	 * Keys must be removed in the reverse order they were added, which is the order of make and
+	 * unmake. Removing the most recent key then restores the exact earlier state of the table, so
+	 * an emptied slot never breaks a probe sequence and no tombstones are needed.
+	 *
+	 * Clearing is constant-time: it bumps a generation, and slots of older generations are empty.
+	 */
+	class RepetitionTable {
+	public:
+		static constexpr size_t Size = 1024;		/* twice the positions a Game holds */
+
+	private:
+		struct Slot {
+			zobrist::Key key;
+			uint16_t count;
+			uint16_t generation;
+		};
+
+		Slot m_slots[Size];
+		uint16_t m_generation;
+
+		inline constexpr bool occupied(const Slot& slot) const noexcept {
+			return slot.generation == m_generation && slot.count;
+		}
+
+		// The slot holding the key, or the empty slot where it would go
+		inline constexpr size_t find(const zobrist::Key key) const noexcept {
+			size_t index = key & (Size - 1);
+			while (occupied(m_slots[index]) && m_slots[index].key != key)
+				index = (index + 1) & (Size - 1);
+
+			return index;
+		}
+
+	public:
+		inline constexpr RepetitionTable() noexcept : m_slots{ }, m_generation{ 1 } { }
+
+		inline constexpr void clear() noexcept {
+			// Generation 0 marks the slots as empty on wrap-around
+			if (++m_generation == 0) {
+				for (Slot& slot : m_slots)
+					slot.generation = 0;
+				m_generation = 1;
+			}
+		}
+
+		inline constexpr void add(const zobrist::Key key) noexcept {
+			Slot& slot = m_slots[find(key)];
+
+			if (occupied(slot)) {
+				++slot.count;
+			} else {
+				slot = { key, 1, m_generation };
+			}
+		}
+
+		// The key must be the most recently added one still in the table.
+		inline constexpr void remove(const zobrist::Key key) noexcept {
+			Slot& slot = m_slots[find(key)];
+
+			CHESS_ASSERT(occupied(slot));
+			--slot.count;
+		}
+
+		/**
+		 * \returns How many times the key occurs.
+		 */
+		inline constexpr int count(const zobrist::Key key) const noexcept {
+			const Slot& slot = m_slots[find(key)];
+			return occupied(slot) ? slot.count : 0;
+		}
+	};
+}
@@ -0,0 +1,742 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "eval.hpp"
+#include "helper.hpp"
+#include "movegen.hpp"
+#include "pool.hpp"
+#include "treetrace.hpp"
+#include "tt.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @file Provides the search building blocks: quiescence search, move ordering and principal
+ *       variations, and a single-threaded alpha-beta search on top of them.
+ *
+ * With `CHESS_TREE_TRACE` defined, every node the search finishes is recorded, see treetrace.hpp.
+ */
+namespace chess {
+	namespace search {
+		inline constexpr int MaxPly = 128;
+		inline constexpr int Infinity = 32000;
+		inline constexpr int MateScore = 31000;		/* mate in n plies scores MateScore - n */
+
+		/**
+		 * A principal variation.
+		 */
+		struct Line {
+			Move moves[MaxPly];
+			int length = 0;
+
+			inline constexpr void clear() noexcept { length = 0; }
+
+			// Sets this line to the move followed by the child line.
+			inline constexpr void update(const Move move, const Line& child) noexcept {
+				moves[0] = move;
+				std::copy(child.moves, child.moves + child.length, moves + 1);
+				length = child.length + 1;
+			}
+		};
+
+		/**
+		 * \returns The MVV-LVA score of a capture: the most valuable victim first, then the
+		 *          least valuable attacker.
+		 */
+		inline constexpr int captureScore(const WideMove move) noexcept {
+			int score = move.isCapture() ? eval::pieceValue(getPieceType(move.capturedPiece())) * 8 - eval::pieceValue(getPieceType(move.movedPiece())) / 100 : 0;
+			if (move.isPromotion())
+				score += eval::pieceValue(move.move().promotionPieceType());
+
+			return score;
+		}
+
+		/**
+		 * \returns The MVV-LVA score of a capture, looking the pieces up on the board.
+		 */
+		template <Color Color>
+		inline constexpr int captureScore(const Board& board, const Move move) noexcept {
+			return captureScore(board.widen<Color>(move));
+		}
+
+		/**
+		 * \tparam Color The current turn.
+		 * \param alpha The lower bound of the window.
+		 * \param beta The upper bound of the window.
+		 * \param ply The distance from the root, for mate scores.
+		 * \param pv Set to the principal variation. Its last position is the quiet leaf.
+		 * \param nodes Incremented for every visited position.
+		 * \returns The score from the side to move's point of view.
+		 *
+		 * Searches captures and queen promotions until the position is quiet, with stand pat,
+		 * MVV-LVA ordering, delta pruning and pruning of captures that likely lose material. In check, every evasion is searched instead, so
+		 * checkmates are scored.
+		 */
+		template <Color Color>
+		inline int quiescence(Game& game, int alpha, const int beta, const int ply, Line& pv, uint64_t& nodes) noexcept {
+			++nodes;
+			pv.clear();
+
+			[[maybe_unused]] const int originalAlpha = alpha;
+			[[maybe_unused]] treetrace::Counts counts;
+
+			const bool inCheck = movegen::isCheck<Color>(game);
+			const int standPat = eval::evaluate<Color>(game);
+
+			// Also a leaf once the game's 512 positions of history are full, whatever the distance from the root
+			if (ply >= MaxPly - 1 || game.ply() >= 511) {
+				CHESS_TREE_NODE(game.zobristHash(), 0, ply, alpha, beta, standPat, Move{ }, treetrace::Reason::MaxPly);
+				return standPat;
+			}
+
+			if (!inCheck) {
+				if (standPat >= beta) {
+					CHESS_TREE_NODE(game.zobristHash(), 0, ply, alpha, beta, standPat, Move{ }, treetrace::Reason::StandPat);
+					return standPat;
+				}
+				alpha = std::max(alpha, standPat);
+			}
+
+			WideMoveList moves;
+			movegen::legalMovesByMaterial<Color>(game, moves);
+
+			if (moves.size() == 0) {
+				const int score = inCheck ? -MateScore + ply : 0;
+				CHESS_TREE_NODE(game.zobristHash(), 0, ply, originalAlpha, beta, score, Move{ }, treetrace::Reason::Terminal);
+				return score;
+			}
+			counts.moves = uint8_t(moves.size());
+
+			const Board& board = game.board();
+
+			// Out of check, only the captures and queen promotions that could raise alpha are searched
+			WideMoveList captures;
+			if (!inCheck) {
+				for (const WideMove move : moves) {
+					if (move.isPromotion() ? move.move().promotionPieceType() != PieceType::Queen : !move.isCapture())
+						continue;
+
+					if (!move.isPromotion()) {
+						const int victim = eval::pieceValue(getPieceType(move.capturedPiece()));
+						const int attacker = eval::pieceValue(getPieceType(move.movedPiece()));
+
+						// Delta pruning, and captures of defended pieces by more valuable ones
+						if (standPat + victim + 200 <= alpha || (attacker > victim && movegen::squareAttacked<Color>(board, move.getTo()))) {
+							++counts.pruned;
+							continue;
+						}
+					}
+
+					captures.add(move);
+				}
+			}
+
+			WideMoveList& candidates = inCheck ? moves : captures;
+			candidates.sort([](const WideMove lhs, const WideMove rhs) {
+				return captureScore(lhs) > captureScore(rhs);
+			});
+
+			int best = inCheck ? -Infinity : standPat;
+			Line child;
+
+			for (const WideMove move : candidates) {
+				++counts.searched;
+
+				const UndoInfo undoInfo = game.make<Color>(move);
+				const int score = -quiescence<~Color>(game, -beta, -alpha, ply + 1, child, nodes);
+				game.unmake<Color>(move, undoInfo);
+
+				if (score > best) {
+					best = score;
+
+					if (score > alpha) {
+						alpha = score;
+						pv.update(move.move(), child);
+
+						if (score >= beta)
+							break;
+					}
+				}
+			}
+
+			CHESS_TREE_NODE(game.zobristHash(), 0, ply, originalAlpha, beta, best, pv.length ? pv.moves[0] : Move{ }, treetrace::Reason::Searched, counts);
+			return best;
+		}
+
+		/**
+		 * Mate scores are stored relative to the position, and returned relative to the root.
+		 */
+		inline constexpr int scoreToTable(const int score, const int ply) noexcept {
+			return score >= MateScore - MaxPly ? score + ply : score <= -MateScore + MaxPly ? score - ply : score;
+		}
+
+		inline constexpr int scoreFromTable(const int score, const int ply) noexcept {
+			return score >= MateScore - MaxPly ? score - ply : score <= -MateScore + MaxPly ? score + ply : score;
+		}
+
+		/**
+		 * When to stop a search. The search ends at whichever comes first.
+		 */
+		struct Limits {
+			int depth = MaxPly - 1;
+			uint64_t nodes = UINT64_MAX;
+		};
+
+		struct Result {
+			Line pv;				/* empty if the position is checkmate or stalemate */
+			int score = 0;			/* from the side to move's point of view */
+			int depth = 0;			/* of the last completed iteration */
+			uint64_t nodes = 0;
+
+			inline constexpr Move bestMove() const noexcept {
+				return pv.length ? pv.moves[0] : Move{ };
+			}
+		};
+
+		/**
+		 * The parallel search algorithms, see `ParallelSearcher` in parallel.hpp.
+		 */
+		enum class Algorithm : uint8_t {
+			LazySMP,		/* independent searches of the whole tree, sharing the table */
+			ABDADA,			/* the same iterations, moves that other threads are searching put off */
+			YBWC			/* young brothers wait: the moves after the first shared out at split points */
+		};
+
+		class ParallelSearcher;
+
+		namespace detail {
+			// Shallower nodes are neither marked nor put off (ABDADA), nor split (YBWC)
+			inline constexpr int AbdadaMinDepth = 3;
+			inline constexpr int SplitMinDepth = 4;
+			inline constexpr int MaxSplitPoints = 8;		/* nested split points per thread */
+
+			/**
+			 * A YBWC split point: a node whose remaining moves idle threads can join in searching.
+			 */
+			struct SplitPoint {
+				std::mutex mutex;
+				SplitPoint* parent;			/* the split point the owner was working under */
+				Game game;					/* the position, for the helpers to copy */
+				WideMoveList moves;			/* the moves after the first */
+				size_t next;				/* the next move to hand out */
+				int alpha, beta, best, depth, ply;
+				bool inCheck;
+				Move bestMove;
+				WideMove cutoffMove;
+				Line pv;
+				std::atomic<int> workers;	/* the helpers working here, the owner not included */
+				std::atomic<bool> cutoff;
+			};
+
+			/**
+			 * What the threads of a parallel search share.
+			 */
+			struct SharedSearch {
+				std::atomic<bool> stop{ false };		/* the search is over, or out of nodes */
+				std::atomic<uint64_t> nodes{ 0 };		/* behind by up to 1024 nodes per thread */
+
+				// YBWC
+				std::mutex splitMutex;
+				std::vector<SplitPoint*> splitPoints;	/* the open ones */
+				std::atomic<int> openSplitPoints{ 0 };
+				std::atomic<int> idle{ 0 };				/* helpers looking for a split point */
+			};
+
+			// Marks a position as being searched while it lives, for ABDADA
+			struct SearchingMark {
+				TranspositionTable* table;
+				zobrist::Key key;
+
+				inline SearchingMark(TranspositionTable* table, const zobrist::Key key) noexcept : table{ table }, key{ key } {
+					if (table)
+						table->startSearching(key);
+				}
+
+				inline ~SearchingMark() {
+					if (table)
+						table->finishSearching(key);
+				}
+			};
+
+			inline bool cutoffAbove(const SplitPoint* splitPoint) noexcept {
+				for (; splitPoint; splitPoint = splitPoint->parent)
+					if (splitPoint->cutoff.load(std::memory_order_relaxed))
+						return true;
+
+				return false;
+			}
+		}
+
+		/**
+		 * A single-threaded iterative deepening alpha-beta search: principal variation search with
+		 * a transposition table, check extensions, late move reductions, killer moves and a history
+		 * heuristic, ending in the quiescence search. Any number of searchers can share a table.
+		 * One per thread. It is also the core of the parallel searches of parallel.hpp.
+		 */
+		class Searcher {
+			friend class ParallelSearcher;
+
+			// Returned by searchMove for a move put off by ABDADA
+			static constexpr int Deferred = Infinity + 1;
+
+			TranspositionTable& m_table;
+			Move m_killers[MaxPly][2];
+			int m_history[2][64][64];
+			uint64_t m_nodes = 0;
+			uint64_t m_nodeLimit = UINT64_MAX;
+			bool m_aborted = false;
+
+			// Parallel search state, unused by single-threaded searches
+			detail::SharedSearch* m_shared = nullptr;
+			Algorithm m_algorithm = Algorithm::LazySMP;
+			bool m_main = true;								/* the thread whose result counts, and which applies the node limit */
+			uint64_t m_reportedNodes = 0;					/* the nodes already added to the shared count */
+			detail::SplitPoint* m_splitPoint = nullptr;		/* the innermost split point this thread works under */
+			std::unique_ptr<detail::SplitPoint[]> m_splitPoints;
+			int m_splitPointCount = 0;
+
+			// Move ordering: the table move, winning captures and promotions, killers, then quiet moves by history
+			template <Color Color>
+			inline int orderScore(const WideMove move, const Move tableMove, const int ply) const noexcept {
+				if (move.move() == tableMove)
+					return 1 << 30;
+				if (move.isCapture() || move.isPromotion())
+					return (1 << 29) + captureScore(move);
+				if (move.move() == m_killers[ply][0])
+					return (1 << 28) + 1;
+				if (move.move() == m_killers[ply][1])
+					return 1 << 28;
+
+				return m_history[(size_t)Color][move.getFrom()][move.getTo()];
+			}
+
+			// Called at every node: the node limit, and in parallel searches, the shared stop flag and
+			// the cutoffs at the split points this thread works under
+			inline bool shouldStop() noexcept {
+				if (m_shared == nullptr)
+					return m_nodes >= m_nodeLimit;
+
+				if (m_nodes - m_reportedNodes >= 1024) {
+					const uint64_t total = m_shared->nodes.fetch_add(m_nodes - m_reportedNodes, std::memory_order_relaxed) + (m_nodes - m_reportedNodes);
+					m_reportedNodes = m_nodes;
+
+					if (m_main && total >= m_nodeLimit)
+						m_shared->stop.store(true, std::memory_order_relaxed);
+				}
+
+				return m_shared->stop.load(std::memory_order_relaxed) || (m_splitPoint && detail::cutoffAbove(m_splitPoint));
+			}
+
+			template <Color Color>
+			inline void updateQuietHistory(const WideMove move, const int depth, const int ply) noexcept {
+				if (move.isCapture() || move.isPromotion())
+					return;
+
+				if (m_killers[ply][0] != move.move()) {
+					m_killers[ply][1] = m_killers[ply][0];
+					m_killers[ply][0] = move.move();
+				}
+
+				m_history[(size_t)Color][move.getFrom()][move.getTo()] += depth * depth;
+			}
+
+			// Searches a move of a node: the first one with the full window, the others with a null
+			// window first, reduced if quiet and late. With mayDefer, returns Deferred instead when
+			// another thread is searching the position after the move (ABDADA).
+			template <Color Color>
+			inline int searchMove(Game& game, const WideMove move, const size_t index, const int alpha, const int beta, const int depth,
+			                      const int ply, const bool inCheck, Line& child, treetrace::Counts& counts, const bool mayDefer) noexcept {
+				const bool quiet = !move.isCapture() && !move.isPromotion();
+				const UndoInfo undoInfo = game.make<Color>(move);
+
+				if (mayDefer && m_table.isSearching(game.zobristHash())) {
+					game.unmake<Color>(move, undoInfo);
+					return Deferred;
+				}
+				++counts.searched;
+
+				int score;
+				if (index == 0) {
+					score = -negamax<~Color>(game, -beta, -alpha, depth - 1, ply + 1, child);
+				} else {
+					// Late quiet moves are searched shallower first, and all of them with a null window
+					const int reduction = (quiet && !inCheck && depth >= 3 && index >= 3) ? 1 + (index >= 8) : 0;
+
+					score = -negamax<~Color>(game, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1, child);
+					counts.reduced += reduction != 0;
+
+					if (score > alpha && (reduction || score < beta)) {
+						++counts.researched;
+						score = -negamax<~Color>(game, -beta, -alpha, depth - 1, ply + 1, child);
+					}
+				}
+
+				game.unmake<Color>(move, undoInfo);
+				return score;
+			}
+
+			inline bool canSplit(const int depth) const noexcept {
+				return m_algorithm == Algorithm::YBWC && m_shared && depth >= detail::SplitMinDepth &&
+				       m_splitPointCount < detail::MaxSplitPoints && m_shared->idle.load(std::memory_order_relaxed) > 0;
+			}
+
+			// Searches the moves of a split point until none are left or one fails high. Run by the
+			// owner and the helpers, each on its own copy of the position.
+			template <Color Color>
+			inline void searchSplitPoint(Game& game, detail::SplitPoint& splitPoint) noexcept {
+				detail::SplitPoint* const previous = m_splitPoint;
+				m_splitPoint = &splitPoint;
+
+				Line child;
+				treetrace::Counts counts;
+
+				for (;;) {
+					size_t index;
+					int alpha;
+					{
+						const std::lock_guard lock(splitPoint.mutex);
+						if (splitPoint.cutoff.load(std::memory_order_relaxed) || splitPoint.next == splitPoint.moves.size())
+							break;
+
+						index = splitPoint.next++;
+						alpha = splitPoint.alpha;
+					}
+
+					const WideMove move = splitPoint.moves[index];
+					const int score = searchMove<Color>(game, move, index + 1, alpha, splitPoint.beta, splitPoint.depth, splitPoint.ply,
+					                                    splitPoint.inCheck, child, counts, false);
+					if (m_aborted)
+						break;
+
+					const std::lock_guard lock(splitPoint.mutex);
+					if (score > splitPoint.best) {
+						splitPoint.best = score;
+						splitPoint.bestMove = move.move();
+
+						if (score > splitPoint.alpha) {
+							splitPoint.alpha = score;
+							splitPoint.pv.update(move.move(), child);
+
+							if (score >= splitPoint.beta) {
+								splitPoint.cutoffMove = move;
+								splitPoint.cutoff.store(true, std::memory_order_relaxed);
+							}
+						}
+					}
+				}
+
+				m_splitPoint = previous;
+			}
+
+			// Shares out the moves after the first with the idle threads (YBWC) and searches them
+			// along with them. Returns whether one of them fails high.
+			template <Color Color>
+			inline bool split(Game& game, WideMoveList& moves, int* scores, int& alpha, const int beta, const int depth, const int ply,
+			                  const bool inCheck, int& best, Move& bestMove, Line& pv, treetrace::Counts& counts) noexcept {
+				detail::SplitPoint& splitPoint = m_splitPoints[m_splitPointCount++];
+
+				// The moves after the first, in order
+				splitPoint.moves.clear();
+				for (size_t i = 1; i < moves.size(); ++i) {
+					size_t next = i;
+					for (size_t j = i + 1; j < moves.size(); ++j)
+						if (scores[j] > scores[next])
+							next = j;
+					std::swap(moves[i], moves[next]);
+					std::swap(scores[i], scores[next]);
+
+					splitPoint.moves.add(moves[i]);
+				}
+
+				splitPoint.parent = m_splitPoint;
+				splitPoint.game.copyFrom(game);
+				splitPoint.next = 0;
+				splitPoint.alpha = alpha;
+				splitPoint.beta = beta;
+				splitPoint.best = best;
+				splitPoint.depth = depth;
+				splitPoint.ply = ply;
+				splitPoint.inCheck = inCheck;
+				splitPoint.bestMove = bestMove;
+				splitPoint.pv = pv;
+				splitPoint.workers.store(0, std::memory_order_relaxed);
+				splitPoint.cutoff.store(false, std::memory_order_relaxed);
+
+				{
+					const std::lock_guard lock(m_shared->splitMutex);
+					m_shared->splitPoints.push_back(&splitPoint);
+					m_shared->openSplitPoints.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				searchSplitPoint<Color>(game, splitPoint);
+
+				{
+					const std::lock_guard lock(m_shared->splitMutex);
+					std::erase(m_shared->splitPoints, &splitPoint);
+					m_shared->openSplitPoints.fetch_sub(1, std::memory_order_relaxed);
+				}
+
+				// The helpers finish their moves, which a cutoff here cuts short
+				for (unsigned spin = 1; splitPoint.workers.load(std::memory_order_acquire) != 0; ++spin) {
+					detail::cpuRelax();
+					if (spin % 64 == 0)
+						std::this_thread::yield();
+				}
+
+				--m_splitPointCount;
+
+				// A cutoff here stops the moves of this split point only
+				m_aborted = m_shared->stop.load(std::memory_order_relaxed) || detail::cutoffAbove(m_splitPoint);
+
+				alpha = splitPoint.alpha;
+				best = splitPoint.best;
+				bestMove = splitPoint.bestMove;
+				pv = splitPoint.pv;
+				counts.searched = uint8_t(counts.searched + splitPoint.next);
+
+				if (!splitPoint.cutoff.load(std::memory_order_relaxed))
+					return false;
+
+				updateQuietHistory<Color>(splitPoint.cutoffMove, depth, ply);
+				return true;
+			}
+
+			template <Color Color>
+			inline int negamax(Game& game, int alpha, const int beta, int depth, const int ply, Line& pv) noexcept {
+				pv.clear();
+
+				if (depth <= 0)
+					return quiescence<Color>(game, alpha, beta, ply, pv, m_nodes);
+
+				++m_nodes;
+				if (shouldStop()) {
+					m_aborted = true;
+					return 0;
+				}
+
+				const bool root = ply == 0;
+				if (!root && (game.isRepetition() || game.draw50MoveRule())) {
+					CHESS_TREE_NODE(game.zobristHash(), depth, ply, alpha, beta, 0, Move{ }, treetrace::Reason::Draw);
+					return 0;
+				}
+
+				// Also a leaf once the game's 512 positions of history are full, whatever the distance from the root
+				if (ply >= MaxPly - 1 || game.ply() >= 511) {
+					const int score = eval::evaluate<Color>(game);
+					CHESS_TREE_NODE(game.zobristHash(), depth, ply, alpha, beta, score, Move{ }, treetrace::Reason::MaxPly);
+					return score;
+				}
+
+				const bool pvNode = beta - alpha > 1;
+				const zobrist::Key key = game.zobristHash();
+
+				TranspositionTable::Entry entry;
+				Move tableMove;
+				if (m_table.probe(key, entry)) {
+					tableMove = entry.move;
+
+					// Entries that only count the threads searching the position (ABDADA) have no bound
+					const int score = scoreFromTable(entry.score, ply);
+					if (!pvNode && !root && entry.depth >= depth && entry.bound != Bound::None &&
+					    (entry.bound == Bound::Exact || (entry.bound == Bound::Lower ? score >= beta : score <= alpha))) {
+						CHESS_TREE_NODE(key, depth, ply, alpha, beta, score, entry.move, treetrace::Reason::TableCutoff);
+						return score;
+					}
+				}
+
+				const bool inCheck = movegen::isCheck<Color>(game);
+				if (inCheck)
+					++depth;
+
+				WideMoveList moves;
+				movegen::legalMovesByMaterial<Color>(game, moves);
+
+				if (moves.size() == 0) {
+					const int score = inCheck ? -MateScore + ply : 0;
+					CHESS_TREE_NODE(key, depth, ply, alpha, beta, score, Move{ }, treetrace::Reason::Terminal);
+					return score;
+				}
+
+				int scores[218];
+				for (size_t i = 0; i < moves.size(); ++i)
+					scores[i] = orderScore<Color>(moves[i], tableMove, ply);
+
+				const int originalAlpha = alpha;
+				int best = -Infinity;
+				Move bestMove;
+				Line child;
+				treetrace::Counts counts{ .moves = uint8_t(moves.size()) };
+
+				// Updates the best score with a searched move. Returns whether it fails high.
+				const auto consider = [&](const WideMove move, const int score) {
+					if (score <= best)
+						return false;
+
+					best = score;
+					bestMove = move.move();
+					if (score <= alpha)
+						return false;
+
+					alpha = score;
+					pv.update(move.move(), child);
+					if (score < beta)
+						return false;
+
+					updateQuietHistory<Color>(move, depth, ply);
+					return true;
+				};
+
+				// With ABDADA, the position is marked as being searched, and the moves after the first
+				// leading to positions other threads are searching are put off to a second pass
+				const bool abdada = m_algorithm == Algorithm::ABDADA && m_shared && depth >= detail::AbdadaMinDepth;
+				const detail::SearchingMark mark(abdada ? &m_table : nullptr, key);
+				uint8_t deferred[218];
+				size_t deferredCount = 0;
+				bool cutoff = false;
+
+				for (size_t i = 0; i < moves.size() && !cutoff; ++i) {
+					// Selection sort, since a cutoff usually comes within the first few moves
+					size_t next = i;
+					for (size_t j = i + 1; j < moves.size(); ++j)
+						if (scores[j] > scores[next])
+							next = j;
+					std::swap(moves[i], moves[next]);
+					std::swap(scores[i], scores[next]);
+
+					const int score = searchMove<Color>(game, moves[i], i, alpha, beta, depth, ply, inCheck, child, counts,
+					                                    abdada && i > 0 && depth > detail::AbdadaMinDepth);
+					if (score == Deferred) {
+						deferred[deferredCount++] = uint8_t(i);
+						continue;
+					}
+
+					if (m_aborted)
+						return 0;
+
+					cutoff = consider(moves[i], score);
+
+					// With YBWC, once the eldest brother is searched, the younger ones can be shared out
+					if (!cutoff && i == 0 && moves.size() > 2 && canSplit(depth)) {
+						cutoff = split<Color>(game, moves, scores, alpha, beta, depth, ply, inCheck, best, bestMove, pv, counts);
+						if (m_aborted)
+							return 0;
+						break;
+					}
+				}
+
+				for (size_t d = 0; d < deferredCount && !cutoff; ++d) {
+					const size_t i = deferred[d];
+					const int score = searchMove<Color>(game, moves[i], i, alpha, beta, depth, ply, inCheck, child, counts, false);
+					if (m_aborted)
+						return 0;
+
+					cutoff = consider(moves[i], score);
+				}
+
+				const Bound bound = best >= beta ? Bound::Lower : best > originalAlpha ? Bound::Exact : Bound::Upper;
+				m_table.store(key, bestMove, scoreToTable(best, ply), depth, bound);
+
+				CHESS_TREE_NODE(key, depth, ply, originalAlpha, beta, best, bestMove, treetrace::Reason::Searched, counts);
+				return best;
+			}
+
+			inline void reset() noexcept {
+				std::fill(&m_killers[0][0], &m_killers[0][0] + MaxPly * 2, Move{ });
+				std::fill(&m_history[0][0][0], &m_history[0][0][0] + 2 * 64 * 64, 0);
+
+				m_nodes = 0;
+				m_reportedNodes = 0;
+				m_nodeLimit = UINT64_MAX;
+				m_aborted = false;
+			}
+
+			// Iterative deepening from the first depth, calling `onIteration(const Result&)` after
+			// every completed iteration
+			template <typename OnIteration>
+			inline Result iterate(Game& game, const Limits& limits, const int firstDepth, OnIteration&& onIteration) noexcept {
+				Result result;
+				Line pv;
+
+				for (int depth = firstDepth; depth <= std::min(limits.depth, MaxPly - 1); ++depth) {
+					const int score = CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, {
+						return negamax<Color>(game, -Infinity, Infinity, depth, 0, pv);
+					});
+
+					if (m_aborted)
+						break;
+
+					result.pv = pv;
+					result.score = score;
+					result.depth = depth;
+					result.nodes = m_nodes;
+					onIteration(std::as_const(result));
+
+					// There is nothing to search in a checkmate or a stalemate
+					if (pv.length == 0)
+						break;
+
+					m_nodeLimit = limits.nodes;
+				}
+
+				result.nodes = m_nodes;
+				return result;
+			}
+
+			// The helper loop of YBWC: joins split points with moves left, until the search is over
+			inline void help(Game& game) noexcept {
+				detail::SharedSearch& shared = *m_shared;
+				shared.idle.fetch_add(1, std::memory_order_relaxed);
+
+				for (unsigned spin = 1; !shared.stop.load(std::memory_order_relaxed); ++spin) {
+					detail::SplitPoint* joined = nullptr;
+
+					if (shared.openSplitPoints.load(std::memory_order_relaxed) > 0) {
+						const std::lock_guard lock(shared.splitMutex);
+
+						for (detail::SplitPoint* splitPoint : shared.splitPoints) {
+							const std::lock_guard splitLock(splitPoint->mutex);
+
+							if (!splitPoint->cutoff.load(std::memory_order_relaxed) && splitPoint->next < splitPoint->moves.size()) {
+								splitPoint->workers.fetch_add(1, std::memory_order_relaxed);
+								joined = splitPoint;
+								break;
+							}
+						}
+					}
+
+					if (joined == nullptr) {
+						detail::cpuRelax();
+						if (spin % 64 == 0)
+							std::this_thread::yield();
+						continue;
+					}
+
+					shared.idle.fetch_sub(1, std::memory_order_relaxed);
+
+					game.copyFrom(joined->game);
+					CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { searchSplitPoint<Color>(game, *joined); });
+					m_aborted = false;
+
+					joined->workers.fetch_sub(1, std::memory_order_release);
+					shared.idle.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				shared.idle.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+		public:
+			inline explicit Searcher(TranspositionTable& table) noexcept : m_table{ table } { }
+
+			/**
+			 * \returns The result of the last completed iteration. The first iteration always
+			 *          completes, whatever the node limit.
+			 */
+			inline Result search(Game& game, const Limits& limits) noexcept {
+				reset();
+				return iterate(game, limits, 1, [](const Result&) { });
+			}
+		};
+	}
+}
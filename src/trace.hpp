@@ -0,0 +1,244 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "helper.hpp"
+#include "movegen.hpp"
+#include "packed.hpp"
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+
+/**
+ * @file Records the library calls of a real workload, such as a search, and replays them, so that
+ *       changes to the library can be benchmarked on the exact call sequence an engine makes.
+ *
+ * Build the workload with `CHESS_TRACE` defined and construct a Recorder on the thread to trace.
+ * The replay does not need `CHESS_TRACE`, so the same trace can be replayed against any build.
+ *
+ * A trace starts with the bytes "CHTR", a 16-bit version and 16 reserved bits, followed by one
+ * record per call. Each record is an Event byte, then:
+ *
+ *     Position      the packed::Position of the game (32 bytes)
+ *     LegalMoves    1 if the moves were only counted, else 0 (1 byte)
+ *     Make          the move (2 bytes)
+ *     Unmake        the move (2 bytes)
+ *     Hash          nothing
+ *
+ * Integers are little-endian.
+ */
+namespace chess {
+	namespace trace {
+		inline constexpr char Magic[4] = { 'C', 'H', 'T', 'R' };
+		inline constexpr uint16_t Version = 1;
+
+		/**
+		 * Records the library calls made on the current thread while it lives. Recorders nest; the
+		 * innermost one receives the calls.
+		 *
+		 * \note Start recording before the game is set up, or pass the game to the constructor, so
+		 *       that the trace starts with a position.
+		 */
+		class Recorder final : public Sink {
+			std::vector<uint8_t> m_data;
+			Sink* m_previous;
+
+			inline void put(const uint8_t byte) {
+				m_data.push_back(byte);
+			}
+
+			inline void put16(const uint16_t value) {
+				m_data.push_back(uint8_t(value));
+				m_data.push_back(uint8_t(value >> 8));
+			}
+
+			inline void putPosition(const Game& game) {
+				put(uint8_t(Event::Position));
+
+				const packed::Position position = packed::pack(game);
+				const size_t size = m_data.size();
+				m_data.resize(size + sizeof(position));
+				std::memcpy(m_data.data() + size, &position, sizeof(position));
+			}
+
+		public:
+			inline Recorder() : m_previous{ detail::sink } {
+				for (const char chr : Magic)
+					put(uint8_t(chr));
+				put16(Version);
+				put16(0);
+
+				detail::sink = this;
+			}
+
+			// Starts the trace with the game's current position.
+			inline explicit Recorder(const Game& game) : Recorder() {
+				putPosition(game);
+			}
+
+			inline ~Recorder() {
+				detail::sink = m_previous;
+			}
+
+			Recorder(const Recorder&) = delete;
+			Recorder& operator=(const Recorder&) = delete;
+
+			inline void record(const Event event, const Game& game, const uint16_t data) override {
+				switch (event) {
+					case Event::Position:
+						putPosition(game);
+						break;
+					case Event::LegalMoves:
+						put(uint8_t(event));
+						put(uint8_t(data));
+						break;
+					case Event::Make:
+					case Event::Unmake:
+						put(uint8_t(event));
+						put16(data);
+						break;
+					case Event::Hash:
+						put(uint8_t(event));
+						break;
+				}
+			}
+
+			inline std::span<const uint8_t> data() const noexcept {
+				return m_data;
+			}
+
+			/**
+			 * \returns Whether the trace was written.
+			 */
+			inline bool save(const char* path) const {
+				std::FILE* file = std::fopen(path, "wb");
+				if (file == nullptr)
+					return false;
+
+				const bool written = std::fwrite(m_data.data(), 1, m_data.size(), file) == m_data.size();
+				return std::fclose(file) == 0 && written;
+			}
+		};
+
+		/**
+		 * \returns The contents of a trace file, empty if it cannot be read.
+		 */
+		inline std::vector<uint8_t> load(const char* path) {
+			std::vector<uint8_t> data;
+
+			std::FILE* file = std::fopen(path, "rb");
+			if (file == nullptr)
+				return data;
+
+			uint8_t buffer[1 << 16];
+			for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+				data.insert(data.end(), buffer, buffer + read);
+
+			std::fclose(file);
+			return data;
+		}
+
+		struct ReplayResult {
+			uint64_t events = 0;
+			uint64_t checksum = 0;		/* of the move counts and hashes, equal across correct builds */
+			bool ok = false;			/* false if the trace is malformed */
+		};
+
+		/**
+		 * \param trace A recorded trace.
+		 * \param game Used for the replay, left in the last position.
+		 * \returns The number of replayed calls and a checksum of their results.
+		 *
+		 * Makes the recorded calls again, in order. The result of every call feeds the checksum,
+		 * so that the compiler cannot drop any of them and so that builds can be compared.
+		 */
+		inline ReplayResult replay(const std::span<const uint8_t> trace, Game& game) {
+			ReplayResult result;
+
+			if (trace.size() < 8 || std::memcmp(trace.data(), Magic, sizeof(Magic)) != 0 || (trace[4] | trace[5] << 8) != Version)
+				return result;
+
+			const auto mix = [&result](const uint64_t value) {
+				result.checksum = (result.checksum ^ value) * 0x100000001B3ull;
+			};
+
+			std::vector<UndoInfo> undo;
+			undo.reserve(512);
+
+			bool positioned = false;
+			MoveList moves;
+
+			for (size_t i = 8; i < trace.size(); ++result.events) {
+				const Event event = Event(trace[i++]);
+				const size_t left = trace.size() - i;
+
+				switch (event) {
+					case Event::Position: {
+						if (left < sizeof(packed::Position))
+							return result;
+
+						packed::Position position;
+						std::memcpy(&position, trace.data() + i, sizeof(position));
+						i += sizeof(position);
+
+						packed::unpack(position, game);
+						undo.clear();
+						positioned = true;
+						break;
+					}
+					case Event::LegalMoves: {
+						if (left < 1 || !positioned)
+							return result;
+
+						if (trace[i++]) {
+							movegen::detail::MoveCounter counter;
+							CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { movegen::legalMoves<Color>(game, counter); });
+							mix(counter.count);
+						} else {
+							moves.clear();
+							CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { movegen::legalMoves<Color>(game, moves); });
+							mix(moves.size());
+						}
+						break;
+					}
+					case Event::Make:
+					case Event::Unmake: {
+						if (left < 2 || !positioned)
+							return result;
+
+						const Move move = std::bit_cast<Move>(uint16_t(trace[i] | trace[i + 1] << 8));
+						i += 2;
+
+						if (event == Event::Make) {
+							// The game holds 512 positions of history
+							if (game.ply() >= 511)
+								return result;
+
+							CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { undo.push_back(game.make<Color>(move)); });
+						} else {
+							if (undo.empty())
+								return result;
+
+							CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { game.unmake<~Color>(move, undo.back()); });
+							undo.pop_back();
+						}
+						break;
+					}
+					case Event::Hash:
+						if (!positioned)
+							return result;
+
+						mix(game.zobristHash());
+						break;
+					default:
+						return result;
+				}
+			}
+
+			result.ok = true;
+			return result;
+		}
+	}
+}
@@ -0,0 +1,317 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "move.hpp"
+#include "packed.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * @file Records the nodes a search visits, for offline analysis of its cutoffs and pruning, and
+ *       summarizes the recordings.
+ *
+ * Build the search with `CHESS_TREE_TRACE` defined and construct a Recorder on each searching
+ * thread. Every node the search finishes then appends a 32-byte NodeRecord to the thread's ring
+ * file, a memory-mapped file of a fixed number of records in which the newest records overwrite
+ * the oldest. An append is a copy into mapped memory, without a system call or any formatting, so
+ * the traced search runs close to full speed and searches under a time limit still take the
+ * decisions they take untraced. Without `CHESS_TREE_TRACE`, the hooks compile to nothing.
+ *
+ * A ring file is a Header, then `capacity` records; the record with sequence number i is at
+ * index i % capacity. The header is kept up to date after every record, so the file of a killed
+ * process can be read too. Integers are stored in the native byte order.
+ */
+namespace chess {
+	namespace treetrace {
+		inline constexpr char Magic[4] = { 'C', 'H', 'S', 'T' };
+		inline constexpr uint32_t Version = 1;
+
+		enum class NodeType : uint8_t {
+			PV,			/* alpha < score < beta */
+			Cut,		/* score >= beta */
+			All			/* score <= alpha */
+		};
+
+		// Why a node returned
+		enum class Reason : uint8_t {
+			Searched,		/* its moves were searched */
+			TableCutoff,	/* a transposition table cutoff */
+			Draw,			/* a repetition or the 50-move rule */
+			Terminal,		/* checkmate or stalemate */
+			MaxPly,			/* too far from the root, or the history of the game is full, evaluated */
+			StandPat		/* the quiescence evaluation was at least beta */
+		};
+		inline constexpr size_t ReasonCount = 6;
+
+		struct NodeRecord {
+			zobrist::Key key;
+			int16_t alpha;			/* the window the node was called with */
+			int16_t beta;
+			int16_t score;
+			uint16_t move;			/* the best move, or the move that caused the cutoff */
+			uint8_t depth;			/* 0 for quiescence nodes */
+			uint8_t ply;
+			NodeType type;
+			Reason reason;
+			uint8_t moves;			/* the legal moves */
+			uint8_t searched;		/* the moves searched, the cutoff move included */
+			uint8_t reduced;		/* the moves searched with a late move reduction */
+			uint8_t researched;		/* the moves searched again, after failing high on a reduced or null window */
+			uint8_t pruned;			/* the captures skipped by quiescence pruning */
+			uint8_t reserved[7];
+		};
+		static_assert(sizeof(NodeRecord) == 32);
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint32_t recordSize;
+			uint32_t reserved;
+			uint64_t capacity;		/* a power of two */
+			uint64_t written;		/* the records appended, including the overwritten ones */
+		};
+		static_assert(sizeof(Header) == 32);
+
+		/**
+		 * The move counts of a node, kept by the search as it goes.
+		 */
+		struct Counts {
+			uint8_t moves = 0, searched = 0, reduced = 0, researched = 0, pruned = 0;
+		};
+
+		/**
+		 * \param alpha The window the node was called with; the node type is derived from it.
+		 */
+		inline NodeRecord makeRecord(const zobrist::Key key, const int depth, const int ply, const int alpha, const int beta,
+		                             const int score, const Move move, const Reason reason, const Counts& counts = { }) noexcept {
+			NodeRecord record{ };
+			record.key = key;
+			record.alpha = int16_t(alpha);
+			record.beta = int16_t(beta);
+			record.score = int16_t(score);
+			record.move = move.data();
+			record.depth = uint8_t(std::max(depth, 0));
+			record.ply = uint8_t(ply);
+			record.type = score >= beta ? NodeType::Cut : score <= alpha ? NodeType::All : NodeType::PV;
+			record.reason = reason;
+			record.moves = counts.moves;
+			record.searched = counts.searched;
+			record.reduced = counts.reduced;
+			record.researched = counts.researched;
+			record.pruned = counts.pruned;
+			return record;
+		}
+
+		class Recorder;
+
+		namespace detail {
+			inline thread_local Recorder* recorder = nullptr;
+		}
+
+		/**
+		 * Records the search nodes finished on the current thread into a ring file while it lives.
+		 * Recorders nest; the innermost one receives the nodes.
+		 */
+		class Recorder {
+			uint8_t* m_mapping = nullptr;
+			size_t m_mappingSize = 0;
+			Header* m_header = nullptr;
+			NodeRecord* m_records = nullptr;
+			uint64_t m_mask = 0;
+			uint64_t m_written = 0;
+			Recorder* m_previous;
+#ifndef CHESS_HAS_MMAP
+			std::vector<uint8_t> m_buffer;
+			std::string m_path;
+#endif
+
+		public:
+			/**
+			 * Creates or truncates the ring file. If that fails, nothing is recorded.
+			 *
+			 * \param capacity The number of records kept, rounded up to a power of two.
+			 */
+			inline explicit Recorder(const std::string& path, const size_t capacity = 1 << 20) : m_previous{ detail::recorder } {
+				const uint64_t records = std::bit_ceil(std::max<uint64_t>(capacity, 1));
+				const size_t size = sizeof(Header) + records * sizeof(NodeRecord);
+
+#ifdef CHESS_HAS_MMAP
+				const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+				if (fd < 0)
+					return;
+
+				if (ftruncate(fd, off_t(size)) == 0) {
+					void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+					if (data != MAP_FAILED) {
+						m_mapping = static_cast<uint8_t*>(data);
+						m_mappingSize = size;
+					}
+				}
+
+				::close(fd);
+				if (m_mapping == nullptr)
+					return;
+#else
+				m_buffer.resize(size);
+				m_mapping = m_buffer.data();
+				m_mappingSize = size;
+				m_path = path;
+#endif
+
+				m_header = new (m_mapping) Header{ { Magic[0], Magic[1], Magic[2], Magic[3] }, Version, sizeof(NodeRecord), 0, records, 0 };
+				m_records = reinterpret_cast<NodeRecord*>(m_mapping + sizeof(Header));
+				m_mask = records - 1;
+
+				detail::recorder = this;
+			}
+
+			inline ~Recorder() {
+				if (m_mapping == nullptr)
+					return;
+
+				detail::recorder = m_previous;
+
+#ifdef CHESS_HAS_MMAP
+				munmap(m_mapping, m_mappingSize);
+#else
+				if (std::FILE* file = std::fopen(m_path.c_str(), "wb")) {
+					std::fwrite(m_buffer.data(), 1, m_buffer.size(), file);
+					std::fclose(file);
+				}
+#endif
+			}
+
+			Recorder(const Recorder&) = delete;
+			Recorder& operator=(const Recorder&) = delete;
+
+			inline bool isOpen() const noexcept {
+				return m_mapping != nullptr;
+			}
+
+			inline void append(const NodeRecord& record) noexcept {
+				m_records[m_written & m_mask] = record;
+				m_header->written = ++m_written;
+			}
+
+			inline uint64_t written() const noexcept {
+				return m_written;
+			}
+		};
+
+		/**
+		 * A read-only view over the bytes of a ring file, which must outlive it. They can come from
+		 * a memory-mapped file (see `packed::MappedFile`).
+		 */
+		class RingView {
+			const uint8_t* m_data = nullptr;
+			Header m_header{ };
+			size_t m_size = 0;
+
+		public:
+			/**
+			 * \returns True if the bytes hold a ring file, false if not.
+			 */
+			inline bool open(const uint8_t* data, const size_t size) noexcept {
+				if (size < sizeof(Header))
+					return false;
+
+				std::memcpy(&m_header, data, sizeof(Header));
+				if (std::memcmp(m_header.magic, Magic, sizeof(Magic)) != 0 || m_header.version != Version ||
+				    m_header.recordSize != sizeof(NodeRecord) || !std::has_single_bit(m_header.capacity) ||
+				    (size - sizeof(Header)) / sizeof(NodeRecord) < m_header.capacity)
+					return false;
+
+				m_data = data + sizeof(Header);
+				m_size = size_t(std::min(m_header.written, m_header.capacity));
+				return true;
+			}
+
+			/**
+			 * \returns The number of records held, at most the capacity.
+			 */
+			inline size_t size() const noexcept { return m_size; }
+
+			/**
+			 * \returns The number of records overwritten by newer ones.
+			 */
+			inline uint64_t overwritten() const noexcept { return m_header.written - m_size; }
+
+			/**
+			 * \returns The records held, from the oldest to the newest.
+			 */
+			inline NodeRecord operator[](const size_t index) const noexcept {
+				const uint64_t slot = (m_header.written - m_size + index) & (m_header.capacity - 1);
+
+				NodeRecord record;
+				std::memcpy(&record, m_data + slot * sizeof(NodeRecord), sizeof(NodeRecord));
+				return record;
+			}
+		};
+
+		struct DepthSummary {
+			uint64_t nodes = 0;
+			uint64_t types[3] = { };				/* by NodeType */
+			uint64_t reasons[ReasonCount] = { };	/* by Reason */
+			uint64_t searchedCutoffs = 0;			/* cut nodes whose moves were searched */
+			uint64_t firstMoveCutoffs = 0;			/* of which by the first move */
+			uint64_t cutoffMoves = 0;				/* the moves searched up to their cutoff, summed */
+			uint64_t moves = 0, searched = 0, reduced = 0, researched = 0, pruned = 0;
+		};
+
+		struct Summary {
+			uint64_t records = 0;
+			uint64_t overwritten = 0;
+			std::vector<DepthSummary> depths;		/* by remaining depth, 0 for quiescence nodes */
+		};
+
+		/**
+		 * Adds the records of a ring to the summary, so that the rings of several threads can be
+		 * summarized together.
+		 */
+		inline void summarize(const RingView& ring, Summary& summary) {
+			summary.records += ring.size();
+			summary.overwritten += ring.overwritten();
+
+			for (size_t i = 0; i < ring.size(); ++i) {
+				const NodeRecord record = ring[i];
+				if (record.depth >= summary.depths.size())
+					summary.depths.resize(record.depth + 1);
+
+				DepthSummary& depth = summary.depths[record.depth];
+				++depth.nodes;
+				++depth.types[std::min<size_t>(size_t(record.type), 2)];
+				++depth.reasons[std::min<size_t>(size_t(record.reason), ReasonCount - 1)];
+
+				if (record.type == NodeType::Cut && record.searched) {
+					++depth.searchedCutoffs;
+					depth.firstMoveCutoffs += record.searched == 1;
+					depth.cutoffMoves += record.searched;
+				}
+
+				depth.moves += record.moves;
+				depth.searched += record.searched;
+				depth.reduced += record.reduced;
+				depth.researched += record.researched;
+				depth.pruned += record.pruned;
+			}
+		}
+	}
+}
+
+// With CHESS_TREE_TRACE, the search appends every node it finishes to the thread's Recorder
+#ifdef CHESS_TREE_TRACE
+#	define CHESS_TREE_NODE(...)                                                                                       \
+		do {                                                                                                         \
+			if (::chess::treetrace::detail::recorder)                                                                \
+				::chess::treetrace::detail::recorder->append(::chess::treetrace::makeRecord(__VA_ARGS__));           \
+		} while (false)
+#else
+#	define CHESS_TREE_NODE(...)
+#endif
@@ -0,0 +1,287 @@
+/**
+ * A fast chess library for C++
+ */
+#pragma once
+#include "move.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+
+/**
+ * @file Provides a transposition table that many searches can share without locks.
+ */
+namespace chess {
+	namespace search {
+		enum class Bound : uint8_t {
+			None = 0,
+			Upper = 1,		/* the score is at most this (fail low) */
+			Lower = 2,		/* the score is at least this (fail high) */
+			Exact = 3
+		};
+
+		/**
+		 * A fixed-size transposition table, shared by any number of threads.
+		 *
+		 * \cond Each entry is two 64-bit words: the data, and the key XOR the data. Both words are
+		 *       written and read without locks; a torn entry, with words from two different
+		 *       stores, fails the key check and reads as a miss (Hyatt's lockless hashing). Entries
+		 *       are grouped in 64-byte buckets of four. A store goes to the entry of the same key,
+		 *       else replaces the shallowest entry, counting entries of older searches as
+		 *       shallower.
+		 *
+		 *       For ABDADA, an entry also counts the threads searching its position. The counts
+		 *       are updated without locks too, so a race can lose an update; a count that is too
+		 *       high only makes other threads put off the position, and counts from earlier
+		 *       searches are ignored. The count has a generation of its own, so counting does not
+		 *       make an old result look new, and a position without an entry is only counted in
+		 *       an empty slot or one of an earlier search, never at the cost of a current result.
+		 */
+		class TranspositionTable {
+		public:
+			struct Entry {
+				Move move;
+				int16_t score;
+				uint8_t depth;
+				Bound bound;
+				uint8_t searching;		/* the threads searching the position, for ABDADA */
+			};
+
+		private:
+			static constexpr size_t Ways = 4;
+			static constexpr int GenerationBits = 6;
+
+			struct Slot {
+				std::atomic<uint64_t> check;	/* the key XOR the data */
+				std::atomic<uint64_t> data;
+			};
+
+			struct alignas(64) Bucket {
+				Slot slots[Ways];
+			};
+
+			std::unique_ptr<Bucket[]> m_buckets;
+			size_t m_mask = 0;
+			std::atomic<uint8_t> m_generation = 0;
+
+			// Data layout: move (16 bits), score (16), depth (8), bound (2), generation (6), searching (8),
+			// searching generation (6)
+			static inline constexpr uint64_t pack(const Move move, const int score, const int depth, const Bound bound, const uint8_t generation,
+			                                      const uint8_t searching = 0, const uint8_t searchingGeneration = 0) noexcept {
+				return uint64_t(move.data()) | uint64_t(uint16_t(score)) << 16 | uint64_t(uint8_t(depth)) << 32 |
+				       uint64_t(bound) << 40 | uint64_t(generation) << 42 | uint64_t(searching) << 48 |
+				       uint64_t(searchingGeneration) << 56;
+			}
+
+			static inline constexpr Entry unpack(const uint64_t data) noexcept {
+				return { std::bit_cast<Move>(uint16_t(data)), int16_t(data >> 16), uint8_t(data >> 32), Bound((data >> 40) & 3), uint8_t(data >> 48) };
+			}
+
+			static inline constexpr uint8_t generationOf(const uint64_t data) noexcept {
+				return uint8_t(data >> 42) & ((1 << GenerationBits) - 1);
+			}
+
+			// The search that last counted a thread searching the position
+			static inline constexpr uint8_t searchingGenerationOf(const uint64_t data) noexcept {
+				return uint8_t(data >> 56) & ((1 << GenerationBits) - 1);
+			}
+
+			inline uint8_t currentGeneration() const noexcept {
+				return m_generation.load(std::memory_order_relaxed) & ((1 << GenerationBits) - 1);
+			}
+
+			inline Bucket& bucketFor(const zobrist::Key key) const noexcept {
+				return m_buckets[key & m_mask];
+			}
+
+			inline Slot* find(const zobrist::Key key) const noexcept {
+				for (Slot& slot : bucketFor(key).slots) {
+					const uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+					if ((slot.check.load(std::memory_order_relaxed) ^ data) == key && data)
+						return &slot;
+				}
+
+				return nullptr;
+			}
+
+			static inline void write(Slot& slot, const zobrist::Key key, const uint64_t data) noexcept {
+				slot.data.store(data, std::memory_order_relaxed);
+				slot.check.store(key ^ data, std::memory_order_relaxed);
+			}
+
+			// The slot a new entry of the bucket goes to. With `olderOnly`, only empty slots and those
+			// of earlier searches qualify, and there may be none.
+			inline Slot* victimFor(Bucket& bucket, const uint8_t generation, const bool olderOnly = false) const noexcept {
+				Slot* victim = nullptr;
+				int victimWorth = INT32_MAX;
+
+				for (Slot& slot : bucket.slots) {
+					const uint64_t data = slot.data.load(std::memory_order_relaxed);
+					if (olderOnly && data && generationOf(data) == generation)
+						continue;
+
+					// Older searches count as 8 plies per generation shallower
+					const int age = (generation - generationOf(data)) & ((1 << GenerationBits) - 1);
+					const int worth = data ? unpack(data).depth - 8 * age : -1;
+
+					if (victim == nullptr || worth < victimWorth) {
+						victim = &slot;
+						victimWorth = worth;
+					}
+				}
+
+				return victim;
+			}
+
+		public:
+			/**
+			 * \param megabytes The size, rounded down to a power of two, at least 64 KB.
+			 */
+			inline explicit TranspositionTable(const size_t megabytes = 64) {
+				resize(megabytes);
+			}
+
+			/**
+			 * Reallocates and clears the table. Not thread-safe.
+			 */
+			inline void resize(const size_t megabytes) {
+				const size_t buckets = std::bit_floor(std::max<size_t>(megabytes << 20, 64 << 10) / sizeof(Bucket));
+
+				m_buckets = std::make_unique<Bucket[]>(buckets);
+				m_mask = buckets - 1;
+				m_generation.store(0, std::memory_order_relaxed);
+			}
+
+			/**
+			 * Empties the table. Not thread-safe.
+			 */
+			inline void clear() noexcept {
+				for (size_t i = 0; i <= m_mask; ++i) {
+					for (Slot& slot : m_buckets[i].slots) {
+						slot.check.store(0, std::memory_order_relaxed);
+						slot.data.store(0, std::memory_order_relaxed);
+					}
+				}
+			}
+
+			/**
+			 * Starts a new search, so that the entries of earlier ones are replaced first. Entries
+			 * stay usable, which is what lets the searches of consecutive positions help each other.
+			 * Thread-safe.
+			 */
+			inline void newSearch() noexcept {
+				m_generation.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \returns Whether the key was found, in which case the entry is set.
+			 */
+			inline bool probe(const zobrist::Key key, Entry& entry) const noexcept {
+				for (const Slot& slot : bucketFor(key).slots) {
+					const uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+					if ((slot.check.load(std::memory_order_relaxed) ^ data) == key && data) {
+						entry = unpack(data);
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			/**
+			 * Stores a search result. A null move keeps the move already stored for the key.
+			 */
+			inline void store(const zobrist::Key key, Move move, const int score, const int depth, const Bound bound) noexcept {
+				const uint8_t generation = currentGeneration();
+				uint8_t searching = 0, searchingGeneration = 0;
+
+				Slot* slot = find(key);
+				if (slot) {
+					const uint64_t data = slot->data.load(std::memory_order_relaxed);
+					const Entry old = unpack(data);
+
+					// Keep deeper results of this search, unless the new one is exact
+					if (bound != Bound::Exact && depth + 2 < old.depth && generationOf(data) == generation)
+						return;
+
+					if (move.isNull())
+						move = old.move;
+					if (searchingGenerationOf(data) == generation) {
+						searching = old.searching;
+						searchingGeneration = generation;
+					}
+				} else {
+					slot = victimFor(bucketFor(key), generation);
+				}
+
+				write(*slot, key, pack(move, score, depth, bound, generation, searching, searchingGeneration));
+			}
+
+			/**
+			 * Counts one more thread searching the position, keeping the age of its result. Without
+			 * an entry, adds one without a result (`Bound::None`) in an empty slot or one of an
+			 * earlier search; if the bucket has neither, the position is not counted.
+			 */
+			inline void startSearching(const zobrist::Key key) noexcept {
+				const uint8_t generation = currentGeneration();
+
+				if (Slot* slot = find(key)) {
+					const uint64_t data = slot->data.load(std::memory_order_relaxed);
+					const Entry old = unpack(data);
+					const int searching = searchingGenerationOf(data) == generation ? old.searching : 0;
+
+					write(*slot, key, pack(old.move, old.score, old.depth, old.bound, generationOf(data),
+					                       uint8_t(std::min(searching + 1, 255)), generation));
+				} else if (Slot* victim = victimFor(bucketFor(key), generation, true)) {
+					write(*victim, key, pack(Move{ }, 0, 0, Bound::None, generation, 1, generation));
+				}
+			}
+
+			/**
+			 * Counts one thread less searching the position.
+			 */
+			inline void finishSearching(const zobrist::Key key) noexcept {
+				if (Slot* slot = find(key)) {
+					const uint64_t data = slot->data.load(std::memory_order_relaxed);
+					const Entry old = unpack(data);
+
+					if (old.searching)
+						write(*slot, key, pack(old.move, old.score, old.depth, old.bound, generationOf(data), old.searching - 1,
+						                       searchingGenerationOf(data)));
+				}
+			}
+
+			/**
+			 * \returns Whether some thread is searching the position, in the current search.
+			 */
+			inline bool isSearching(const zobrist::Key key) const noexcept {
+				const Slot* slot = find(key);
+				if (slot == nullptr)
+					return false;
+
+				const uint64_t data = slot->data.load(std::memory_order_relaxed);
+				return unpack(data).searching && searchingGenerationOf(data) == currentGeneration();
+			}
+
+			/**
+			 * \returns The permille of sampled entries written by the current search.
+			 */
+			inline int hashfull() const noexcept {
+				const uint8_t generation = currentGeneration();
+
+				int used = 0;
+				for (size_t i = 0; i < 250 && i <= m_mask; ++i) {
+					for (const Slot& slot : m_buckets[i].slots) {
+						const uint64_t data = slot.data.load(std::memory_order_relaxed);
+						used += data && generationOf(data) == generation;
+					}
+				}
+
+				return int(used * 1000 / (std::min<size_t>(250, m_mask + 1) * Ways));
+			}
+		};
+	}
+}
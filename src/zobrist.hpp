@@ -33,40 +33,118 @@ namespace chess {
 
 	namespace zobrist {
 		typedef uint64_t Key;
-		
-		inline uint64_t pieceSquareTable[16][64];
-		inline uint64_t enPassantTable[8];
-		inline uint64_t castlingTable[16];
-		inline uint64_t side, noPawns;
-		inline bool initialized = false;
+
+		namespace detail {
+			struct Tables {
+				Key pieceSquare[16][64];
+				Key enPassant[8];
+				Key castling[16];
+				Key side, noPawns;
+			};
+
+			// Generated at compile time, so there is nothing to initialize and no global state
+			// shared between threads. The order of generation fixes the values of the keys.
+			inline constexpr Tables tables = ([]() constexpr {
+				Tables tables{ };
+				PRNG rng(1070372);
+
+				for (Piece piece : {
+					Piece::WhitePawn, Piece::WhiteKnight, Piece::WhiteBishop,
+					Piece::WhiteRook, Piece::WhiteQueen, Piece::WhiteKing,
+					Piece::BlackPawn, Piece::BlackKnight, Piece::BlackBishop,
+					Piece::BlackRook, Piece::BlackQueen, Piece::BlackKing
+				})
+					for (int square = Square::A1; square <= Square::H8; ++square)
+						tables.pieceSquare[(size_t)piece][square] = rng.rand64();
+
+				for (int file = 0; file < 8; ++file)
+					tables.enPassant[file] = rng.rand64();
+
+				for (int cr = 0; cr < 16; ++cr)
+					tables.castling[cr] = rng.rand64();
+
+				tables.side = rng.rand64();
+				tables.noPawns = rng.rand64();
+
+				return tables;
+			})();
+		}
+
+		inline constexpr const Key (&pieceSquareTable)[16][64] = detail::tables.pieceSquare;
+		inline constexpr const Key (&enPassantTable)[8] = detail::tables.enPassant;
+		inline constexpr const Key (&castlingTable)[16] = detail::tables.castling;
+		inline constexpr Key side = detail::tables.side;
+		inline constexpr Key noPawns = detail::tables.noPawns;
+
+		/**
+		 * The keys are generated at compile time, so there is nothing to initialize. Kept so that
+		 * code calling it still compiles.
+		 */
+		[[deprecated("The zobrist keys are generated at compile time; calling init() is no longer needed.")]]
+		inline constexpr void init() noexcept { }
 
 		/**
-		 * Precompute Zobrist-related global information. This can safely be called multiple times.
+		 * \param fen The FEN string. It must be valid.
+		 * \returns The Zobrist hash of the position, the same as `Game::zobristHash` would give.
+		 *
+		 * Computes the Zobrist hash of a FEN string in one pass, without setting up a Game. This
+		 * can be evaluated at compile time, for instance, for static opening book tables or to
+		 * switch on a position.
 		 */
-		inline constexpr void init() noexcept {
-			if (initialized) return;
-
-			PRNG rng(1070372);
-
-			for (Piece piece : {
-				Piece::WhitePawn, Piece::WhiteKnight, Piece::WhiteBishop,
-				Piece::WhiteRook, Piece::WhiteQueen, Piece::WhiteKing,
-				Piece::BlackPawn, Piece::BlackKnight, Piece::BlackBishop,
-				Piece::BlackRook, Piece::BlackQueen, Piece::BlackKing
-			})
-				for (int square = Square::A1; square <= Square::H8; ++square)
-					pieceSquareTable[(size_t)piece][square] = rng.rand64();
-			
-			for (int file = 0; file < 8; ++file)
-				enPassantTable[file] = rng.rand64();
-			
-			for (int cr = 0; cr < 16; ++cr)
-				castlingTable[cr] = rng.rand64();
-			
-			side = rng.rand64();
-			noPawns = rng.rand64();
-
-			initialized = true;
+		inline constexpr Key hashFEN(const std::string_view fen) noexcept {
+			Key hash = 0;
+			size_t i = 0;
+
+			// 1. Piece placement
+			for (int row = 7, col = 0; i < fen.size() && fen[i] != ' '; ++i) {
+				const char chr = fen[i];
+				Piece piece = Piece::None;
+
+				switch (chr) {
+					case '/': col = 0; --row; continue;
+					case 'P': piece = Piece::WhitePawn; break;
+					case 'N': piece = Piece::WhiteKnight; break;
+					case 'B': piece = Piece::WhiteBishop; break;
+					case 'R': piece = Piece::WhiteRook; break;
+					case 'Q': piece = Piece::WhiteQueen; break;
+					case 'K': piece = Piece::WhiteKing; break;
+					case 'p': piece = Piece::BlackPawn; break;
+					case 'n': piece = Piece::BlackKnight; break;
+					case 'b': piece = Piece::BlackBishop; break;
+					case 'r': piece = Piece::BlackRook; break;
+					case 'q': piece = Piece::BlackQueen; break;
+					case 'k': piece = Piece::BlackKing; break;
+					default: col += chr - '0'; continue;
+				}
+
+				hash ^= pieceSquareTable[(size_t)piece][col + row * 8];
+				++col;
+			}
+			++i;
+
+			// 2. Active color
+			if (i < fen.size() && fen[i] == 'b')
+				hash ^= side;
+			i += 2;
+
+			// 3. Castling availability
+			CastlingFlags castlingRights = CastlingFlags::None;
+			for (; i < fen.size() && fen[i] != ' '; ++i) {
+				switch (fen[i]) {
+					case 'K': castlingRights |= CastlingFlags::WhiteKingside; break;
+					case 'Q': castlingRights |= CastlingFlags::WhiteQueenside; break;
+					case 'k': castlingRights |= CastlingFlags::BlackKingside; break;
+					case 'q': castlingRights |= CastlingFlags::BlackQueenside; break;
+				}
+			}
+			hash ^= castlingTable[(size_t)castlingRights];
+			++i;
+
+			// 4. En-passant square (the clocks do not take part in the hash)
+			if (i < fen.size() && fen[i] != '-')
+				hash ^= enPassantTable[fen[i] - 'a'];
+
+			return hash;
 		}
 	}
-}
\ No newline at end of file
+}
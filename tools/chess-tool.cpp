@@ -0,0 +1,806 @@
+/**
+ * A fast chess library for C++
+ *
+ * chess-tool: streams positions and games from stdin to stdout, for shell pipelines.
+ *
+ *     chess-tool legal    [-t threads]           FEN lines  ->  UCI move lists
+ *     chess-tool perft    [-t threads] <depth>   FEN lines  ->  node counts
+ *     chess-tool validate [-t threads]           FEN lines  ->  "ok", or "invalid: <reason>"
+ *     chess-tool fen2bin  [-t threads]           FEN lines  ->  32-byte packed::Position records
+ *     chess-tool bin2fen  [-t threads]           records    ->  FEN lines
+ *     chess-tool pgn2uci  [-t threads]           PGN games  ->  "position startpos moves ..." lines
+ *     chess-tool annotate [-t threads] [-d depth] [-n nodes] [-H megabytes]
+ *                                                PGN games  ->  PGN games with evaluations and accuracy
+ *     chess-tool replay   [-r repeats] <trace>   replays a trace.hpp trace, prints its speed and checksum
+ *     chess-tool tree     <ring>...              summarizes treetrace.hpp ring files, by depth
+ *     chess-tool parallel [-d depth] [-H megabytes] [-T threads,...] [-a algorithms,...]
+ *                                                EPD lines  ->  time to depth and nodes to solution of
+ *                                                               the parallel search algorithms, and
+ *                                                               their speedup over one thread
+ *
+ * Input is read in large blocks and cut at the last complete line, record or game. Each block
+ * is split between the threads, and their outputs are written in input order, so the output
+ * does not depend on the thread count. Only stdio is used. Invalid FEN lines, blank ones included,
+ * produce an empty output line (none for fen2bin) and a message on stderr.
+ *
+ * Build: g++ -std=c++20 -O3 -march=native -pthread tools/chess-tool.cpp -o chess-tool
+ */
+#include "../src/annotate.hpp"
+#include "../src/dispatch.hpp"
+#include "../src/packed.hpp"
+#include "../src/parallel.hpp"
+#include "../src/pgn.hpp"
+#include "../src/trace.hpp"
+#include "../src/treetrace.hpp"
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifdef _WIN32
+#	include <fcntl.h>
+#	include <io.h>
+#endif
+
+using namespace chess;
+
+namespace {
+	constexpr size_t BlockSize = 8 << 20;
+
+	enum class Framing {
+		Lines,		/* newline-terminated text */
+		Records,	/* fixed-size packed::Position records */
+		Games		/* PGN games, starting at a tag section after a blank line */
+	};
+
+	struct Worker {
+		Game game;
+		std::string out;
+		std::string err;
+	};
+
+	/**
+	 * \returns The end of the last complete unit in the text, 0 if there is none.
+	 */
+	size_t lastBoundary(const std::string_view text, const Framing framing) noexcept {
+		switch (framing) {
+			case Framing::Lines: {
+				const size_t end = text.rfind('\n');
+				return end == std::string_view::npos ? 0 : end + 1;
+			}
+
+			case Framing::Records:
+				return text.size() - text.size() % sizeof(packed::Position);
+
+			case Framing::Games: {
+				const size_t lf = text.rfind("\n\n[");
+				const size_t crlf = text.rfind("\n\r\n[");
+				const size_t a = lf == std::string_view::npos ? 0 : lf + 2;
+				const size_t b = crlf == std::string_view::npos ? 0 : crlf + 3;
+				return std::max(a, b);
+			}
+		}
+
+		return 0;
+	}
+
+	bool write(std::FILE* file, const std::string& data) noexcept {
+		return data.empty() || std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	}
+
+	/**
+	 * Reads stdin block by block, runs `process(Worker&, std::string_view)` over contiguous
+	 * ranges of complete units on every thread, and writes the outputs in order. `beforeBlock()`
+	 * is called on the calling thread before the threads start on each block.
+	 */
+	template <typename Process, typename BeforeBlock>
+	bool run(const Framing framing, const unsigned threads, Process&& process, BeforeBlock&& beforeBlock) {
+		std::vector<std::unique_ptr<Worker>> workers;
+		for (unsigned t = 0; t < threads; ++t)
+			workers.push_back(std::make_unique<Worker>());
+
+		std::vector<char> buffer;
+		size_t size = 0;
+		bool eof = false;
+
+		while (!eof || size > 0) {
+			if (!eof) {
+				buffer.resize(size + BlockSize);
+				const size_t read = std::fread(buffer.data() + size, 1, BlockSize, stdin);
+				size += read;
+				eof = read < BlockSize;
+			}
+
+			const std::string_view text(buffer.data(), size);
+			const size_t cut = eof ? size : lastBoundary(text, framing);
+			if (cut == 0)
+				continue;
+
+			// Split the complete units between the threads
+			std::vector<size_t> splits{ 0 };
+			for (unsigned t = 1; t < threads; ++t)
+				splits.push_back(std::max(splits.back(), lastBoundary(text.substr(0, cut * t / threads), framing)));
+			splits.push_back(cut);
+
+			beforeBlock();
+
+			std::vector<std::thread> pool;
+			for (unsigned t = 0; t < threads; ++t) {
+				workers[t]->out.clear();
+				workers[t]->err.clear();
+
+				if (splits[t] < splits[t + 1])
+					pool.emplace_back([&, t]() { process(*workers[t], text.substr(splits[t], splits[t + 1] - splits[t])); });
+			}
+
+			for (std::thread& thread : pool)
+				thread.join();
+
+			for (const std::unique_ptr<Worker>& worker : workers) {
+				if (!write(stdout, worker->out))
+					return false;
+				write(stderr, worker->err);
+			}
+
+			std::memmove(buffer.data(), buffer.data() + cut, size - cut);
+			size -= cut;
+		}
+
+		return std::fflush(stdout) == 0;
+	}
+
+	template <typename Process>
+	bool run(const Framing framing, const unsigned threads, Process&& process) {
+		return run(framing, threads, std::forward<Process>(process), []() { });
+	}
+
+	/**
+	 * Calls `callback(std::string_view)` with every line of the text, without the line ending.
+	 * Unlike `packed::forEachLine`, blank lines are kept, so that every input line has its
+	 * output line.
+	 */
+	template <typename Callback>
+	void forEachInputLine(const std::string_view text, Callback&& callback) {
+		for (size_t begin = 0; begin < text.size();) {
+			const size_t end = std::min(text.find('\n', begin), text.size());
+
+			std::string_view line = text.substr(begin, end - begin);
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			callback(line);
+
+			begin = end + 1;
+		}
+	}
+
+	void appendUCI(std::string& out, const Move move) {
+		const SquareNameInfo from = getSquareName(move.getFrom());
+		const SquareNameInfo to = getSquareName(move.getTo());
+		const char uci[4] = { from.letter, from.number, to.letter, to.number };
+		out.append(uci, 4);
+
+		if (move.isPromotion())
+			out += "pnbrqk"[(size_t)move.promotionPieceType()];
+	}
+
+	void appendNumber(std::string& out, const uint64_t number) {
+		char digits[24];
+		const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+		out.append(digits, result.ptr);
+	}
+
+	/**
+	 * \param fen The FEN string. The clocks may be missing, as in EPD.
+	 * \param normalized Set to the position with a full-move counter of 1, ready for `Game::init`.
+	 * \returns The reason the FEN is invalid, nullptr if it is valid.
+	 *
+	 * Checks everything `Game::init` and move generation rely on.
+	 */
+	const char* validateFEN(const std::string_view fen, std::string& normalized) {
+		if (fen.empty())
+			return "empty line";
+
+		Board board{ };
+		size_t i = 0;
+		int row = 7, col = 0;
+
+		// 1. Piece placement
+		for (; i < fen.size() && fen[i] != ' '; ++i) {
+			const char chr = fen[i];
+
+			if (chr == '/') {
+				if (col != 8 || row == 0)
+					return "bad piece placement";
+				col = 0;
+				--row;
+			} else if (chr >= '1' && chr <= '8') {
+				col += chr - '0';
+				if (col > 8)
+					return "bad piece placement";
+			} else {
+				const Piece piece = packed::detail::pieceFromChar(chr);
+				if (piece == Piece::None)
+					return "unknown piece";
+				if (col >= 8)
+					return "bad piece placement";
+				board.putPiece(piece, col + row * 8);
+				++col;
+			}
+		}
+
+		if (row != 0 || col != 8)
+			return "bad piece placement";
+
+		// Remaining fields
+		std::string_view fields[5];
+		size_t count = 0;
+		while (count < 5) {
+			while (i < fen.size() && (fen[i] == ' ' || fen[i] == '\t'))
+				++i;
+			if (i >= fen.size())
+				break;
+
+			const size_t start = i;
+			while (i < fen.size() && fen[i] != ' ' && fen[i] != '\t')
+				++i;
+			fields[count++] = fen.substr(start, i - start);
+		}
+
+		if (count < 3)
+			return "missing fields";
+
+		// 2. Active color
+		if (fields[0] != "w" && fields[0] != "b")
+			return "bad active color";
+		const Color turn = fields[0] == "w" ? Color::White : Color::Black;
+
+		// 3. Castling availability
+		CastlingFlags castlingRights = CastlingFlags::None;
+		if (fields[1] != "-") {
+			for (const char chr : fields[1]) {
+				CastlingFlags right;
+				switch (chr) {
+					case 'K': right = CastlingFlags::WhiteKingside; break;
+					case 'Q': right = CastlingFlags::WhiteQueenside; break;
+					case 'k': right = CastlingFlags::BlackKingside; break;
+					case 'q': right = CastlingFlags::BlackQueenside; break;
+					default: return "bad castling availability";
+				}
+
+				if ((castlingRights & right) != CastlingFlags::None)
+					return "bad castling availability";
+				castlingRights |= right;
+			}
+		}
+
+		// 4. En-passant square
+		const int enPassantSquare = fields[2] == "-" ? int(Square::None) : convertToSquare(fields[2]);
+		if (enPassantSquare == Square::None && fields[2] != "-")
+			return "bad en-passant square";
+
+		// 5. and 6. Clocks, skipped if absent (or if they are EPD operations)
+		std::string_view halfMoveCounter = "0";
+		if (count >= 4 && fields[3].find_first_not_of("0123456789") == std::string_view::npos) {
+			if (fields[3].size() > 4)
+				return "bad half-move clock";
+			halfMoveCounter = fields[3];
+		}
+
+		// The pieces themselves
+		const auto checkSide = [&]<Color Color>() -> const char* {
+			if (popcount(board.kings<Color>()) != 1)
+				return "there must be one king of each color";
+			if (popcount(board.pawns<Color>()) > 8 || popcount(board.occupancy<Color>()) > 16)
+				return "too many pieces";
+
+			constexpr Piece rook = makePiece(PieceType::Rook, Color);
+			constexpr CastlingFlags kingside = Color == Color::White ? CastlingFlags::WhiteKingside : CastlingFlags::BlackKingside;
+			constexpr CastlingFlags queenside = Color == Color::White ? CastlingFlags::WhiteQueenside : CastlingFlags::BlackQueenside;
+
+			if ((castlingRights & (kingside | queenside)) != CastlingFlags::None &&
+			    board.pieceAt(initialKingSquare<Color>()) != makePiece(PieceType::King, Color))
+				return "castling availability without the king on its square";
+			if ((castlingRights & kingside) != CastlingFlags::None && board.pieceAt(kingsideCastleRookFromSquare<Color>()) != rook)
+				return "castling availability without the rook on its square";
+			if ((castlingRights & queenside) != CastlingFlags::None && board.pieceAt(queensideCastleRookFromSquare<Color>()) != rook)
+				return "castling availability without the rook on its square";
+
+			return nullptr;
+		};
+
+		if (const char* error = checkSide.template operator()<Color::White>())
+			return error;
+		if (const char* error = checkSide.template operator()<Color::Black>())
+			return error;
+
+		if ((board.pawns<Color::White>() | board.pawns<Color::Black>()) & (RankMask::Rank1 | RankMask::Rank8))
+			return "pawn on the first or last rank";
+
+		if (enPassantSquare != Square::None) {
+			// The square a double push skipped, with the pushed pawn in front of it and nothing behind it
+			const int rank = turn == Color::White ? Rank::Rank6 : Rank::Rank3;
+			const int pawnSquare = turn == Color::White ? enPassantSquare - 8 : enPassantSquare + 8;
+			const int originSquare = turn == Color::White ? enPassantSquare + 8 : enPassantSquare - 8;
+
+			if (rankOf(enPassantSquare) != rank || board.isSquareOccupied(enPassantSquare) || board.isSquareOccupied(originSquare) ||
+			    board.pieceAt(pawnSquare) != makePiece(PieceType::Pawn, ~turn))
+				return "bad en-passant square";
+		}
+
+		const bool opponentInCheck = turn == Color::White ?
+			movegen::squareAttacked<Color::Black>(board, toSquare(board.kings<Color::Black>())) :
+			movegen::squareAttacked<Color::White>(board, toSquare(board.kings<Color::White>()));
+		if (opponentInCheck)
+			return "the side not to move is in check";
+
+		normalized.assign(fen.substr(0, fields[2].data() + fields[2].size() - fen.data()));
+		normalized += ' ';
+		normalized += halfMoveCounter;
+		normalized += " 1";
+		return nullptr;
+	}
+
+	// Validates a FEN line and sets up the game, or reports the error.
+	bool setup(Worker& worker, const std::string_view line, std::string& normalized) {
+		if (const char* error = validateFEN(line, normalized)) {
+			worker.err += "chess-tool: invalid FEN (";
+			worker.err += error;
+			worker.err += "): ";
+			worker.err += line;
+			worker.err += '\n';
+			return false;
+		}
+
+		worker.game.init(normalized);
+		return true;
+	}
+
+	std::vector<std::string_view> split(const std::string_view text, const char separator) {
+		std::vector<std::string_view> parts;
+		for (size_t start = 0; start <= text.size();) {
+			const size_t end = std::min(text.find(separator, start), text.size());
+			if (end > start)
+				parts.push_back(text.substr(start, end - start));
+			start = end + 1;
+		}
+
+		return parts;
+	}
+
+	/**
+	 * \returns The moves of the "bm" operation of an EPD line, in SAN, played in the game's position.
+	 *          Empty if there is none, or if one of them is illegal.
+	 */
+	std::vector<Move> bestMoves(const Game& game, const std::string_view line) {
+		std::vector<Move> moves;
+
+		const size_t operation = line.find(" bm ");
+		if (operation == std::string_view::npos)
+			return moves;
+
+		const std::string_view operands = line.substr(operation + 4, line.find(';', operation) - operation - 4);
+		for (const std::string_view san : split(operands, ' ')) {
+			const Move move = CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(game, { return pgn::convertSANToMove<Color>(game, san); });
+			if (move.isNull())
+				return { };
+			moves.push_back(move);
+		}
+
+		return moves;
+	}
+
+	int usage() {
+		std::fputs(
+			"usage: chess-tool <command> [-t threads] [args]\n"
+			"\n"
+			"  legal              FEN lines to UCI move lists\n"
+			"  perft <depth>      FEN lines to perft node counts\n"
+			"  validate           FEN lines to \"ok\" or \"invalid: <reason>\"\n"
+			"  fen2bin            FEN lines to 32-byte packed positions\n"
+			"  bin2fen            32-byte packed positions to FEN lines\n"
+			"  pgn2uci            PGN games to \"position ... moves ...\" lines\n"
+			"  annotate           PGN games to annotated PGN games, searched to -d depth\n"
+			"                     (default 8) or -n nodes per position, with -H MB of hash\n"
+			"  replay <trace>     replays a recorded trace, -r times\n"
+			"  tree <ring>...     cutoff and pruning statistics of search tree ring files\n"
+			"  parallel           benchmarks the parallel searches on EPD lines, to -d depth\n"
+			"                     (default 10) with -H MB of hash, at -T thread counts (default\n"
+			"                     1,4,16,64) with -a algorithms (default lazysmp,abdada,ybwc);\n"
+			"                     1 thread is always run, as the baseline of the speedups\n",
+			stderr);
+		return 2;
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2)
+		return usage();
+
+	const std::string_view command = argv[1];
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	int depth = -1;
+	int repeats = 1;
+	search::Limits limits{ .depth = 0 };
+	size_t hashMegabytes = 64;
+	const char* tracePath = nullptr;
+	std::vector<const char*> ringPaths;
+	std::vector<unsigned> threadCounts;
+	std::vector<search::Algorithm> algorithms;
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+
+		if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+			threads = std::max(1, std::atoi(argv[++i]));
+		} else if (command == "perft" && depth < 0 && std::isdigit((unsigned char)arg[0])) {
+			depth = std::atoi(argv[i]);
+		} else if ((command == "annotate" || command == "parallel") && arg == "-d" && i + 1 < argc) {
+			limits.depth = std::clamp(std::atoi(argv[++i]), 1, search::MaxPly - 1);
+		} else if (command == "annotate" && arg == "-n" && i + 1 < argc) {
+			limits.nodes = std::max(1ll, std::atoll(argv[++i]));
+		} else if ((command == "annotate" || command == "parallel") && arg == "-H" && i + 1 < argc) {
+			hashMegabytes = size_t(std::max(1, std::atoi(argv[++i])));
+		} else if (command == "replay" && (arg == "-r" || arg == "--repeats") && i + 1 < argc) {
+			repeats = std::max(1, std::atoi(argv[++i]));
+		} else if (command == "replay" && tracePath == nullptr) {
+			tracePath = argv[i];
+		} else if (command == "tree") {
+			ringPaths.push_back(argv[i]);
+		} else if (command == "parallel" && arg == "-T" && i + 1 < argc) {
+			for (const std::string_view count : split(argv[++i], ','))
+				threadCounts.push_back(unsigned(std::max(1, std::atoi(std::string(count).c_str()))));
+		} else if (command == "parallel" && arg == "-a" && i + 1 < argc) {
+			for (const std::string_view name : split(argv[++i], ',')) {
+				if (name == "lazysmp")
+					algorithms.push_back(search::Algorithm::LazySMP);
+				else if (name == "abdada")
+					algorithms.push_back(search::Algorithm::ABDADA);
+				else if (name == "ybwc")
+					algorithms.push_back(search::Algorithm::YBWC);
+				else
+					return usage();
+			}
+		} else {
+			return usage();
+		}
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	std::setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+
+	bool ok;
+
+	if (command == "legal") {
+		ok = run(Framing::Lines, threads, [](Worker& worker, const std::string_view text) {
+			std::string fen;
+			MoveList moves;
+
+			forEachInputLine(text, [&](const std::string_view line) {
+				if (setup(worker, line, fen)) {
+					moves.clear();
+					CHESS_DISPATCH_RUNTIME_COLOR_PARAMETERLESS(worker.game, { movegen::legalMoves<Color>(worker.game, moves); });
+
+					for (size_t i = 0; i < moves.size(); ++i) {
+						if (i)
+							worker.out += ' ';
+						appendUCI(worker.out, moves[i]);
+					}
+				}
+
+				worker.out += '\n';
+			});
+		});
+	} else if (command == "perft") {
+		// The game holds 512 positions of history
+		if (depth < 0 || depth > 500)
+			return usage();
+
+		// Compiled for the best instruction set of this CPU, with CHESS_MULTIVERSION
+		const dispatch::Kernels& kernels = dispatch::kernels();
+
+		ok = run(Framing::Lines, threads, [depth, &kernels](Worker& worker, const std::string_view text) {
+			std::string fen;
+
+			forEachInputLine(text, [&](const std::string_view line) {
+				if (setup(worker, line, fen))
+					appendNumber(worker.out, kernels.perft(worker.game, depth));
+
+				worker.out += '\n';
+			});
+		});
+	} else if (command == "validate") {
+		ok = run(Framing::Lines, threads, [](Worker& worker, const std::string_view text) {
+			std::string fen;
+
+			forEachInputLine(text, [&](const std::string_view line) {
+				if (const char* error = validateFEN(line, fen)) {
+					worker.out += "invalid: ";
+					worker.out += error;
+				} else {
+					worker.out += "ok";
+				}
+
+				worker.out += '\n';
+			});
+		});
+	} else if (command == "fen2bin") {
+		ok = run(Framing::Lines, threads, [](Worker& worker, const std::string_view text) {
+			std::string fen;
+
+			forEachInputLine(text, [&](const std::string_view line) {
+				if (const char* error = validateFEN(line, fen)) {
+					worker.err += "chess-tool: invalid FEN (";
+					worker.err += error;
+					worker.err += "): ";
+					worker.err += line;
+					worker.err += '\n';
+					return;
+				}
+
+				const packed::Position position = packed::packFEN(line);
+				worker.out.append(reinterpret_cast<const char*>(&position), sizeof(position));
+			});
+		});
+	} else if (command == "bin2fen") {
+		ok = run(Framing::Records, threads, [](Worker& worker, const std::string_view text) {
+			for (size_t i = 0; i + sizeof(packed::Position) <= text.size(); i += sizeof(packed::Position)) {
+				packed::Position position;
+				std::memcpy(&position, text.data() + i, sizeof(position));
+
+				worker.out += packed::unpackFEN(position);
+				worker.out += '\n';
+			}
+
+			if (text.size() % sizeof(packed::Position))
+				worker.err += "chess-tool: truncated record at the end of the input\n";
+		});
+	} else if (command == "pgn2uci") {
+		ok = run(Framing::Games, threads, [](Worker& worker, const std::string_view text) {
+			pgn::Reader reader(text);
+			pgn::GameRecord record;
+			std::string fen;
+
+			while (reader.next(record)) {
+				const std::string_view startFEN = record.tag("FEN");
+
+				if (startFEN.empty()) {
+					worker.game.init(QuickFEN::start);
+					worker.out += "position startpos";
+				} else if (setup(worker, startFEN, fen)) {
+					worker.out += "position fen ";
+					worker.out += startFEN;
+				} else {
+					worker.out += '\n';
+					continue;
+				}
+
+				// Game holds up to 512 positions of history
+				const size_t plies = std::min(record.moves.size(), size_t(511 - worker.game.ply()));
+				for (size_t i = 0; i < plies; ++i) {
+					const Move move = pgn::playSAN(worker.game, record.moves[i]);
+
+					if (move.isNull()) {
+						worker.err += "chess-tool: illegal or ambiguous move ";
+						worker.err += record.moves[i];
+						worker.err += ", the game is cut short\n";
+						break;
+					}
+
+					worker.out += i ? " " : " moves ";
+					appendUCI(worker.out, move);
+				}
+
+				worker.out += '\n';
+			}
+		});
+	} else if (command == "annotate") {
+		// With a node budget and no depth, the depth is unlimited
+		if (limits.depth == 0)
+			limits.depth = limits.nodes == UINT64_MAX ? 8 : search::MaxPly - 1;
+
+		// Shared by all the threads, and kept from block to block
+		search::TranspositionTable table(hashMegabytes);
+
+		ok = run(Framing::Games, threads, [&](Worker& worker, const std::string_view text) {
+			annotate::Annotator annotator(table, limits);
+			pgn::Reader reader(text);
+			pgn::GameRecord record;
+			std::string fen;
+
+			while (reader.next(record)) {
+				const std::string_view startFEN = record.tag("FEN");
+
+				// The annotator needs the clocks of the FEN
+				if (!startFEN.empty() && (validateFEN(startFEN, fen) || std::count(startFEN.begin(), startFEN.end(), ' ') < 5)) {
+					worker.err += "chess-tool: invalid or incomplete FEN tag, the game is skipped: ";
+					worker.err += startFEN;
+					worker.err += '\n';
+					continue;
+				}
+
+				if (!annotator.annotate(record, worker.out))
+					worker.err += "chess-tool: illegal, ambiguous or too many moves, the game is only partly annotated\n";
+			}
+		}, [&]() {
+			// One table generation per block of games
+			table.newSearch();
+		});
+	} else if (command == "replay") {
+		if (tracePath == nullptr)
+			return usage();
+
+		const std::vector<uint8_t> data = trace::load(tracePath);
+		lookup::init();
+
+		Game game;
+		trace::ReplayResult result;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repeats; ++i)
+			result = trace::replay(data, game);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (!result.ok) {
+			std::fprintf(stderr, "chess-tool: %s is not a valid trace\n", tracePath);
+			return 1;
+		}
+
+		std::printf("events: %llu, checksum: %016llx, %.1f M events/s\n", (unsigned long long)result.events,
+		            (unsigned long long)result.checksum, double(result.events) * repeats / seconds / 1e6);
+		ok = std::fflush(stdout) == 0;
+	} else if (command == "tree") {
+		if (ringPaths.empty())
+			return usage();
+
+		treetrace::Summary summary;
+		for (const char* path : ringPaths) {
+			const packed::MappedFile file(path);
+			treetrace::RingView ring;
+
+			if (!ring.open(reinterpret_cast<const uint8_t*>(file.data()), file.size())) {
+				std::fprintf(stderr, "chess-tool: %s is not a ring file\n", path);
+				return 1;
+			}
+			treetrace::summarize(ring, summary);
+		}
+
+		const auto percent = [](const uint64_t count, const uint64_t total) {
+			return total ? 100.0 * double(count) / double(total) : 0.0;
+		};
+		const auto ratio = [](const uint64_t count, const uint64_t total) {
+			return total ? double(count) / double(total) : 0.0;
+		};
+
+		std::printf("nodes: %llu, overwritten: %llu\n\n", (unsigned long long)summary.records, (unsigned long long)summary.overwritten);
+		std::printf("depth       nodes    pv%%   cut%%   all%%  table%%  draw%%  term%%  stand%%  first-cut%%  cut-move  lmr/node  re-search%%  pruned/node\n");
+
+		for (size_t d = summary.depths.size(); d-- > 0;) {
+			const treetrace::DepthSummary& depth = summary.depths[d];
+			if (depth.nodes == 0)
+				continue;
+
+			const auto reason = [&](const treetrace::Reason reason) {
+				return percent(depth.reasons[size_t(reason)], depth.nodes);
+			};
+
+			char label[8];
+			std::snprintf(label, sizeof(label), d ? "%zu" : "q", d);
+			std::printf("%5s %11llu %6.1f %6.1f %6.1f %7.1f %6.1f %6.1f %7.1f %11.1f %9.2f %9.2f %11.1f %12.2f\n", label,
+			            (unsigned long long)depth.nodes, percent(depth.types[0], depth.nodes), percent(depth.types[1], depth.nodes),
+			            percent(depth.types[2], depth.nodes), reason(treetrace::Reason::TableCutoff), reason(treetrace::Reason::Draw),
+			            reason(treetrace::Reason::Terminal), reason(treetrace::Reason::StandPat),
+			            percent(depth.firstMoveCutoffs, depth.searchedCutoffs), ratio(depth.cutoffMoves, depth.searchedCutoffs),
+			            ratio(depth.reduced, depth.nodes), percent(depth.researched, depth.reduced), ratio(depth.pruned, depth.nodes));
+		}
+
+		ok = std::fflush(stdout) == 0;
+	} else if (command == "parallel") {
+		if (limits.depth == 0)
+			limits.depth = 10;
+		if (threadCounts.empty())
+			threadCounts = { 1, 4, 16, 64 };
+
+		// The speedups are over one thread, which is always measured first
+		std::erase(threadCounts, 1u);
+		threadCounts.insert(threadCounts.begin(), 1u);
+		if (algorithms.empty())
+			algorithms = { search::Algorithm::LazySMP, search::Algorithm::ABDADA, search::Algorithm::YBWC };
+
+		std::string input;
+		char block[1 << 16];
+		for (size_t read; (read = std::fread(block, 1, sizeof(block), stdin)) > 0;)
+			input.append(block, read);
+
+		struct Position {
+			std::string fen;
+			std::vector<Move> solutions;
+		};
+
+		lookup::init();
+		std::vector<Position> positions;
+		Game game;
+
+		packed::forEachLine(input, [&](const std::string_view line) {
+			Position position;
+			if (const char* error = validateFEN(line, position.fen)) {
+				std::fprintf(stderr, "chess-tool: invalid EPD (%s): %.*s\n", error, int(line.size()), line.data());
+				return;
+			}
+
+			game.init(position.fen);
+			position.solutions = bestMoves(game, line);
+			positions.push_back(std::move(position));
+		});
+
+		const size_t withSolutions = size_t(std::count_if(positions.begin(), positions.end(), [](const Position& position) {
+			return !position.solutions.empty();
+		}));
+
+		std::printf("positions: %zu, with a best move: %zu, depth: %d\n\n", positions.size(), withSolutions, limits.depth);
+		std::printf("algorithm  threads  time-to-depth  speedup        nodes     Mnps   solved  nodes-to-solution\n");
+
+		search::TranspositionTable table(hashMegabytes);
+		static constexpr const char* Names[] = { "lazysmp", "abdada", "ybwc" };
+
+		for (const search::Algorithm algorithm : algorithms) {
+			double baseline = 0;
+
+			for (const unsigned threadCount : threadCounts) {
+				search::ParallelSearcher searcher(table, algorithm, threadCount);
+				uint64_t nodes = 0;
+				size_t solved = 0;
+				double logNodesToSolution = 0;
+				double seconds = 0;
+
+				for (const Position& position : positions) {
+					table.clear();
+					game.init(position.fen);
+
+					// The nodes at the first iteration from which the best move stays a solution
+					uint64_t solutionNodes = 0;
+					const auto onIteration = [&](const search::Result& iteration) {
+						if (std::find(position.solutions.begin(), position.solutions.end(), iteration.bestMove()) == position.solutions.end())
+							solutionNodes = 0;
+						else if (solutionNodes == 0)
+							solutionNodes = std::max<uint64_t>(iteration.nodes, 1);
+					};
+
+					const auto start = std::chrono::steady_clock::now();
+					const search::Result result = searcher.search(game, limits, onIteration);
+					seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					nodes += result.nodes;
+
+					if (solutionNodes) {
+						++solved;
+						logNodesToSolution += std::log(double(solutionNodes));
+					}
+				}
+
+				if (threadCount == 1)
+					baseline = seconds;
+
+				std::printf("%-9s %8u %13.3fs %8.2f %12llu %8.2f %8zu %18.0f\n", Names[size_t(algorithm)], threadCount, seconds, baseline / seconds,
+				            (unsigned long long)nodes, double(nodes) / seconds / 1e6, solved, solved ? std::exp(logNodesToSolution / double(solved)) : 0.0);
+				std::fflush(stdout);
+			}
+		}
+
+		ok = std::fflush(stdout) == 0;
+	} else {
+		return usage();
+	}
+
+	if (!ok) {
+		std::fputs("chess-tool: write error\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}